@@ -48,6 +48,8 @@ FetchContent_Declare(
 		tools
 )
 
+option(WEBGPU_ENABLE_SWIFTSHADER "Build Dawn with the SwiftShader fallback adapter" OFF)
+
 FetchContent_GetProperties(dawn)
 if (NOT dawn_POPULATED)
 	FetchContent_Populate(dawn)
@@ -66,7 +68,10 @@ if (NOT dawn_POPULATED)
 	set(DAWN_ENABLE_D3D11 OFF)
 	set(DAWN_ENABLE_D3D12 OFF)
 	set(DAWN_ENABLE_METAL ${USE_METAL})
-	set(DAWN_ENABLE_NULL OFF)
+	# The null backend allows headless batch rendering on machines without a GPU
+	set(DAWN_ENABLE_NULL ON)
+	# SwiftShader (CPU Vulkan) is selected with forceFallbackAdapter, it needs the Vulkan backend
+	set(DAWN_ENABLE_SWIFTSHADER ${WEBGPU_ENABLE_SWIFTSHADER})
 	set(DAWN_ENABLE_DESKTOP_GL OFF)
 	set(DAWN_ENABLE_OPENGLES OFF)
 	set(DAWN_ENABLE_VULKAN ${USE_VULKAN})
@@ -7,26 +7,47 @@ struct VertexInput
     @location(4) uv:        vec2f,
 }
 
+// Vertex buffers with VertexBuffer::Format::Packed, the normal is octahedral encoded and the
+// bitangent follows from the normal, the tangent and its handedness in w
+struct PackedVertexInput
+{
+    @location(0) position:  vec4f,
+    @location(1) normal:    vec2f,
+    @location(2) tangent:   vec4f,
+    @location(4) uv:        vec2f,
+}
+
+// The position is invariant so the depth prepass computes the same depth for the Equal test
 struct VertexOutput
 {
-     @builtin(position) position:           vec4f,
+     @builtin(position) @invariant position: vec4f,
      @location(0)       normal:             vec4f,
      @location(1)       fragPositionWorld:  vec4f,
      @location(2)       uv:                 vec2f,
      @location(3)       tangent:            vec4f,
      @location(4)       bitangent:          vec4f,
+     @location(5) @interpolate(flat) instance: u32,
+     @location(6)       shadowPosition:     vec4f,   // Position in light view space and distance along the view direction
 }
 
+const maxShadowCascades = 4;
+
 struct Frame
 {
-    view:                 mat4x4f,
-    projection:           mat4x4f,
-    shadowViewProjection: mat4x4f,
-    viewPositionWorld:    vec4f,
-    lightPositionWorld:   vec4f,
-    nrPoissonSamples:     u32,
-    hasEnvironmentMap:    u32,
-    mipLevelCount:        u32
+    view:                  mat4x4f,
+    projection:            mat4x4f,
+    shadowView:            mat4x4f,
+    viewPositionWorld:     vec4f,
+    lightPositionWorld:    vec4f,
+    cascadeScales:         array<vec4f, maxShadowCascades>,
+    cascadeOffsets:        array<vec4f, maxShadowCascades>,
+    cascadeSplits:         vec4f,
+    cascadeBias:           vec4f,
+    nrPoissonSamples:      u32,
+    hasEnvironmentMap:     u32,
+    mipLevelCount:         u32,
+    nrShadowCascades:      u32,
+    shadowFilter:          u32      // ShadowFilter, 0 percentage closer filtering and 1 exponential variance
 }
 
 struct Model
@@ -57,7 +78,7 @@ const PI = 3.1415926535897932384f;
 var<uniform> frame: Frame;
 
 @group(0) @binding(1)
-var shadowTexture: texture_depth_2d;
+var shadowTexture: texture_depth_2d_array;
 
 @group(0) @binding(2) 
 var shadowSampler: sampler_comparison;
@@ -66,36 +87,84 @@ var shadowSampler: sampler_comparison;
 var environmentTexture: texture_cube<f32>;
 
 @group(0) @binding(4)
-var poissonTexture: texture_2d<f32>;
+var shadowMoments: texture_2d_array<f32>;
 
-@group(0) @binding(5) 
-var nearestSample: sampler;
+@group(0) @binding(5)
+var momentSampler: sampler;
 
-@group(1) @binding(0)
-var<uniform> model: Model;
-
-@group(1) @binding(1) 
+@group(1) @binding(0) 
 var linearSampler: sampler;
 
-@group(1) @binding(2)
+@group(1) @binding(1)
 var baseColorTexture: texture_2d<f32>;
 
-@group(1) @binding(3)
+@group(1) @binding(2)
 var occlusionTexture: texture_2d<f32>;
 
-@group(1) @binding(4)
+@group(1) @binding(3)
 var normalsTexture: texture_2d<f32>;
 
-@group(1) @binding(5)
+@group(1) @binding(4)
 var emissiveTexture: texture_2d<f32>;
 
-@group(1) @binding(6)
+@group(1) @binding(5)
 var metallicRoughnessTexture: texture_2d<f32>;
 
+@group(2) @binding(0)
+var<storage, read> models: array<Model>;
+
+// Model data of the instance being shaded, set at the start of each entry point.
+var<private> model: Model;
+
+fn octahedralDecode(encoded: vec2f) -> vec3f
+{
+    var n = vec3f(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    let t = max(-n.z, 0.0);
+    n.x += select(t, -t, n.x >= 0.0);
+    n.y += select(t, -t, n.y >= 0.0);
+    return normalize(n);
+}
+
+@vertex
+fn vs_main_packed(in: PackedVertexInput, @builtin(instance_index) instance: u32) -> VertexOutput
+{
+    let normal      = octahedralDecode(in.normal);
+    let tangent     = normalize(in.tangent.xyz);
+    let handedness  = select(1.0, -1.0, in.tangent.w < 0.0);
+
+    var vertex: VertexInput;
+    vertex.position     = in.position;
+    vertex.normal       = vec4f(normal, 0.0);
+    vertex.tangent      = vec4f(tangent, handedness);
+    vertex.bitangent    = vec4f(cross(normal, tangent) * handedness, 0.0);
+    vertex.uv           = in.uv;
+    return transformVertex(vertex, instance);
+}
+
 @vertex
-fn vs_main(in: VertexInput) -> VertexOutput
+fn vs_main(in: VertexInput, @builtin(instance_index) instance: u32) -> VertexOutput
+{
+    return transformVertex(in, instance);
+}
+
+// Depth prepass, positions only and no fragment stage
+struct DepthOutput
+{
+    @builtin(position) @invariant position: vec4f,
+}
+
+@vertex
+fn vs_depth(@location(0) position: vec4f, @builtin(instance_index) instance: u32) -> DepthOutput
+{
+    var out: DepthOutput;
+    out.position = frame.projection * frame.view * models[instance].model * position;
+    return out;
+}
+
+fn transformVertex(in: VertexInput, instance: u32) -> VertexOutput
 {
     var out: VertexOutput;
+    model = models[instance];
 
     let pos: vec4f = frame.projection * frame.view * model.model * in.position;
 
@@ -105,6 +174,8 @@ fn vs_main(in: VertexInput) -> VertexOutput
     out.uv                  = in.uv;
     out.tangent             = in.tangent;
     out.bitangent           = in.bitangent;
+    out.instance            = instance;
+    out.shadowPosition      = vec4f((frame.shadowView * out.fragPositionWorld).xyz, pos.w);
     return out;
 }
 
@@ -118,55 +189,136 @@ fn occlusion(color: vec3f, uv: vec2f, strength: f32) -> vec3f
 
 fn normal(surfaceNormal: vec3f, uv: vec2f, tangent: vec3f, bitangent: vec3f) -> vec3f
 {
-    var result:         vec3f = surfaceNormal;
-    if (model.hasNormalTexture == 1u)
+    // The model comes from the instance of the fragment, so the texture is sampled in uniform control flow and the
+    // flag only selects the result. z follows from the unit length, so two channel (BC5) normal maps work the same
+    // as RGB ones.
+    let xy:             vec2f = textureSample(normalsTexture, linearSampler, uv).xy * 2.0 - 1.0;
+    let tangentNormal:  vec3f = vec3f(xy, sqrt(max(0.0, 1.0 - dot(xy, xy))));
+    let tbn = mat3x3f(normalize(tangent.xyz), normalize(bitangent.xyz), normalize(surfaceNormal.xyz));
+    let mapped:         vec3f = normalize(tbn * tangentNormal);
+    return select(surfaceNormal, mapped, model.hasNormalTexture == 1u);
+}
+
+// Offsets in the unit disc, the first four are the probes of the adaptive filter and spread over the whole disc
+const maxPoissonSamples = 32u;
+const nrShadowProbes    = 4u;
+const poissonDisc = array<vec2f, maxPoissonSamples>(
+    vec2f( 0.6364,  0.6364), vec2f(-0.6364,  0.6364), vec2f(-0.6364, -0.6364), vec2f( 0.6364, -0.6364),
+    vec2f( 0.0089,  0.0124), vec2f( 0.0095,  0.9860), vec2f( 0.9294, -0.0197), vec2f(-0.9816, -0.0231),
+    vec2f( 0.0051, -0.6175), vec2f(-0.5066,  0.1085), vec2f( 0.0470,  0.4911), vec2f( 0.4542, -0.0941),
+    vec2f(-0.3152, -0.3158), vec2f( 0.3213, -0.9343), vec2f(-0.3766, -0.9098), vec2f( 0.4032,  0.2945),
+    vec2f(-0.3796,  0.9083), vec2f(-0.9255,  0.3651), vec2f(-0.7564, -0.2979), vec2f( 0.8712,  0.3427),
+    vec2f( 0.3219, -0.4367), vec2f(-0.3099,  0.4781), vec2f( 0.3580,  0.8176), vec2f( 0.8788, -0.3192),
+    vec2f(-0.0860, -0.9342), vec2f( 0.0466, -0.2951), vec2f(-0.1769,  0.2375), vec2f( 0.6796,  0.0523),
+    vec2f(-0.0909,  0.7308), vec2f(-0.2791, -0.5958), vec2f( 0.6338, -0.3246), vec2f(-0.3143, -0.0493)
+);
+
+// The cascades are orthographic projections of the same light view, so texture coordinates and depth follow from the
+// light view position with a scale and offset per cascade
+fn toShadowMap(position: vec3f, cascade: u32) -> vec3f
+{
+    return position * frame.cascadeScales[cascade].xyz + frame.cascadeOffsets[cascade].xyz;
+}
+
+// The cascade whose slice of the view frustum holds the fragment
+fn shadowCascade(distance: f32) -> u32
+{
+    var cascade = 0u;
+    for (var i = 0u; i + 1u < frame.nrShadowCascades; i++)
     {
-        let tangentNormal:  vec3f = textureSample(normalsTexture, linearSampler, uv).xyz * 2.0 - 1.0;
-        let tbn = mat3x3f(normalize(tangent.xyz), normalize(bitangent.xyz), normalize(surfaceNormal.xyz));
-        result = normalize(tbn * tangentNormal); 
+        cascade += select(0u, 1u, distance > frame.cascadeSplits[i]);
     }
-    return result;
+    return cascade;
+}
+
+fn shadowSample(coord: vec3f, offset: vec2f, cascade: u32) -> f32
+{
+    const filterRadius = 16.0 / 2048.0;
+
+    // The explicit level keeps the samples valid outside uniform control flow, the shadow map has no mip levels
+    return textureSampleCompareLevel(shadowTexture, shadowSampler, coord.xy + offset * filterRadius, cascade, coord.z);
 }
 
-fn toLightSpace(coord: vec4f) -> vec4f
+// Warping exponents of the moments written by shadowmoments.wgsl
+const evsmExponents         = vec2f(5.0, 5.0);
+const evsmVarianceBias      = 0.0001;
+const evsmBleedingReduction = 0.2;
+
+// Upper bound of the fraction of the filter area that is lit, for the mean and mean square of a warped depth
+fn chebyshevUpperBound(moments: vec2f, depth: f32, minVariance: f32) -> f32
 {
-    var result: vec4f = frame.shadowViewProjection * coord;
-    result /= result.w;
-
-    return vec4f(
-        result.xy * vec2f(0.5, -0.5) + vec2f(0.5),
-        result.z,
-        1.0
-    );
+    let variance = max(moments.y - moments.x * moments.x, minVariance);
+    let distance = depth - moments.x;
+    let lit      = variance / (variance + distance * distance);
+
+    // Cuts off the tail of the bound, which shows as light bleeding where shadows overlap
+    let reduced  = clamp((lit - evsmBleedingReduction) / (1.0 - evsmBleedingReduction), 0.0, 1.0);
+    return select(reduced, 1.0, depth <= moments.x);
 }
 
-fn shadow(coord: vec4f) -> f32
+// Exponential variance shadow maps take one trilinear sample of the prefiltered moments. The gradients of the light view
+// position pick the mip level, the sample stays valid outside uniform control flow.
+fn momentShadow(coord: vec3f, cascade: u32, gradX: vec2f, gradY: vec2f) -> f32
 {
-    const dimensions = 32f;
-    const shadowTexelSize = 1.0 / vec2f(2048, 2048);
+    let moments = textureSampleGrad(shadowMoments, momentSampler, coord.xy, cascade, gradX, gradY);
+
+    let warped   = 2.0 * coord.z - 1.0;
+    let positive = exp(evsmExponents.x * warped);
+    let negative = -exp(-evsmExponents.y * warped);
 
-    var shadow: f32 = 0.0;
+    let depthScale  = evsmVarianceBias * evsmExponents * vec2f(positive, negative);
+    let minVariance = depthScale * depthScale;
 
-    for (var i = 0u; i < frame.nrPoissonSamples; i++)
+    let positiveLit = chebyshevUpperBound(moments.xy, positive, minVariance.x);
+    let negativeLit = chebyshevUpperBound(moments.zw, negative, minVariance.y);
+    return min(positiveLit, negativeLit);
+}
+
+// Percentage closer filtering over a poisson disc. A few probes at the edge of the disc go first, when they agree the
+// fragment is fully lit or fully shadowed and only penumbra fragments take the rest of the samples. With
+// ShadowFilter::Evsm the prefiltered moments replace the samples, gradX and gradY are the screen space derivatives of
+// the light view position.
+fn shadow(shadowPosition: vec4f, gradX: vec3f, gradY: vec3f) -> f32
+{
+    // Nothing casts shadows past the last cascade
+    let distance = shadowPosition.w;
+    if (frame.nrShadowCascades == 0u || distance > frame.cascadeSplits[frame.nrShadowCascades - 1u])
     {
-        let poissonOffset : vec2f = (textureSample(poissonTexture, nearestSample, vec2f(f32(i) / f32(frame.nrPoissonSamples), 0.0)).xy - 0.5) * 2.0;
-        let offsetInPixels: vec2f = poissonOffset * dimensions * 0.5;
-        let uvOffset      : vec2f = offsetInPixels * shadowTexelSize;
+        return 1.0;
+    }
 
-        let shadowCoord: vec4f = toLightSpace(coord) + vec4f(uvOffset, 0.0, 0.0);
+    let cascade = shadowCascade(distance);
+    var coord   = toShadowMap(shadowPosition.xyz, cascade);
+    coord.z    -= frame.cascadeBias[cascade];
+    if (any(coord.xy < vec2f(0.0)) || any(coord.xy > vec2f(1.0)))
+    {
+        return 1.0;
+    }
 
-        var shadowValue: f32    = textureSampleCompare(shadowTexture, shadowSampler, shadowCoord.xy, shadowCoord.z - 0.007);
+    if (frame.shadowFilter == 1u)
+    {
+        let scale = frame.cascadeScales[cascade].xy;
+        return momentShadow(coord, cascade, gradX.xy * scale, gradY.xy * scale);
+    }
 
-        if (shadowCoord.x < 0.0 || shadowCoord.x > 1.0 || shadowCoord.y < 0.0 || shadowCoord.y > 1.0)
-        {
-            shadowValue = 1.0;
-        }
+    let nrSamples = clamp(frame.nrPoissonSamples, 1u, maxPoissonSamples);
+    let nrProbes  = min(nrShadowProbes, nrSamples);
 
-        shadow += shadowValue;
+    var lit = 0.0;
+    for (var i = 0u; i < nrProbes; i++)
+    {
+        lit += shadowSample(coord, poissonDisc[i], cascade);
+    }
+    if (lit == 0.0 || lit == f32(nrProbes))
+    {
+        return lit / f32(nrProbes);
     }
-    shadow /= f32(frame.nrPoissonSamples);
 
-    return shadow;
+    for (var i = nrProbes; i < nrSamples; i++)
+    {
+        lit += shadowSample(coord, poissonDisc[i], cascade);
+    }
+    return lit / f32(nrSamples);
 }
 
 // GGX normal distribution function.
@@ -216,6 +368,8 @@ fn reinhard_extended(v: vec3f, max_white: f32) -> vec3f
 @fragment
 fn fs_main(in: VertexOutput) -> @location(0) vec4f 
 {
+    model = models[in.instance];
+
     let albedo: vec3f = model.baseColorFactor.rgb * textureSample(baseColorTexture, linearSampler, in.uv).rgb;
 
     var finalColor: vec3f = albedo;
@@ -279,7 +433,7 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f
     finalColor =  directLighting;
 
     finalColor   = occlusion(finalColor, in.uv, 1.0);
-    let shadow   = shadow(in.fragPositionWorld);
+    let shadow   = shadow(in.shadowPosition, dpdx(in.shadowPosition.xyz), dpdy(in.shadowPosition.xyz));
     finalColor   = finalColor * (0.3 + (0.7 * shadow));
     finalColor  += select(vec3(0.0), textureSample(emissiveTexture, linearSampler, in.uv).rgb, model.hasEmissiveTexture == 1u);
 
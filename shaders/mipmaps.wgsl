@@ -0,0 +1,96 @@
+// Image processing in textures, dispatched by ComputePass: conversion of uploaded pixels to RGBA8 in mip level 0
+// and generation of the other mip levels, one level from the previous one.
+
+// Averages the color channels in linear space, sRGB textures are written through an RGBA8 unorm view
+override srgb: bool = false;
+
+// Conversion, the uploaded pixels are packed in 32-bit words
+@group(0) @binding(0) var<storage, read> pixels: array<u32>;
+@group(0) @binding(1) var level0: texture_storage_2d<rgba8unorm, write>;
+
+// Downsampling
+@group(0) @binding(2) var previousLevel: texture_2d<f32>;
+@group(0) @binding(3) var nextLevel: texture_storage_2d<rgba8unorm, write>;
+
+fn byteAt(index: u32) -> f32
+{
+    let word = pixels[index / 4u];
+    return f32((word >> ((index % 4u) * 8u)) & 0xffu) / 255.0;
+}
+
+@compute @workgroup_size(8, 8)
+fn convert_rgb(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = textureDimensions(level0);
+    if (id.x >= size.x || id.y >= size.y) { return; }
+
+    let start = (id.y * size.x + id.x) * 3u;
+    textureStore(level0, id.xy, vec4f(byteAt(start), byteAt(start + 1u), byteAt(start + 2u), 1.0));
+}
+
+@compute @workgroup_size(8, 8)
+fn convert_rgba16(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = textureDimensions(level0);
+    if (id.x >= size.x || id.y >= size.y) { return; }
+
+    let start = (id.y * size.x + id.x) * 2u;
+    textureStore(level0, id.xy, vec4f(unpack2x16unorm(pixels[start]), unpack2x16unorm(pixels[start + 1u])));
+}
+
+fn toLinear(color: vec3f) -> vec3f
+{
+    return select(pow((color + 0.055) / 1.055, vec3f(2.4)), color / 12.92, color <= vec3f(0.04045));
+}
+
+fn fromLinear(color: vec3f) -> vec3f
+{
+    return select(1.055 * pow(color, vec3f(1.0 / 2.4)) - 0.055, color * 12.92, color <= vec3f(0.0031308));
+}
+
+fn loadLinear(position: vec2u) -> vec4f
+{
+    let texel = textureLoad(previousLevel, position, 0);
+    if (srgb) { return vec4f(toLinear(texel.rgb), texel.a); }
+    return texel;
+}
+
+// Number of source texels of a destination texel when halving size texels, odd sizes use three to cover all of them
+fn tapCount(size: u32) -> u32
+{
+    if (size == 1u) { return 1u; }
+    return select(2u, 3u, size % 2u == 1u);
+}
+
+// Weight of tap of destination texel, odd sizes 2n + 1 spread over n texels with a box filter
+fn tapWeight(size: u32, halfSize: u32, destination: u32, tap: u32) -> f32
+{
+    if (size == 1u) { return 1.0; }
+    if (size % 2u == 0u) { return 0.5; }
+    if (tap == 0u) { return f32(halfSize - destination) / f32(size); }
+    if (tap == 1u) { return f32(halfSize) / f32(size); }
+    return f32(destination + 1u) / f32(size);
+}
+
+@compute @workgroup_size(8, 8)
+fn downsample(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = textureDimensions(nextLevel);
+    if (id.x >= size.x || id.y >= size.y) { return; }
+
+    let previousSize = textureDimensions(previousLevel);
+    let start        = min(2u * id.xy, previousSize - 1u);
+
+    var sum = vec4f(0.0);
+    for (var j = 0u; j < tapCount(previousSize.y); j++)
+    {
+        let weightY = tapWeight(previousSize.y, size.y, id.y, j);
+        for (var i = 0u; i < tapCount(previousSize.x); i++)
+        {
+            sum += weightY * tapWeight(previousSize.x, size.x, id.x, i) * loadLinear(start + vec2u(i, j));
+        }
+    }
+
+    if (srgb) { sum = vec4f(fromLinear(sum.rgb), sum.a); }
+    textureStore(nextLevel, id.xy, sum);
+}
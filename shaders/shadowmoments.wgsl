@@ -0,0 +1,98 @@
+// Prefiltering of shadow maps, dispatched by MomentPass: the depth of a cascade is converted to exponential variance
+// moments at half resolution and blurred with a separable gaussian, after which the mip levels are averaged.
+
+// Warping exponents, the squared moments have to stay within 16-bit floats. colorpass.wgsl uses the same.
+const exponents = vec2f(5.0, 5.0);
+
+const blurRadius = 4;
+const blurWeights = array<f32, 5>(0.2270, 0.1945, 0.1216, 0.0540, 0.0162);
+
+// Horizontal pass, reads the depth layer at twice the resolution of the moments
+@group(0) @binding(0) var depth: texture_depth_2d;
+@group(0) @binding(1) var horizontal: texture_storage_2d<rgba16float, write>;
+
+// Vertical pass
+@group(0) @binding(2) var blurred: texture_2d<f32>;
+@group(0) @binding(3) var moments: texture_storage_2d<rgba16float, write>;
+
+// Mip levels
+@group(0) @binding(4) var previousLevel: texture_2d<f32>;
+@group(0) @binding(5) var nextLevel: texture_storage_2d<rgba16float, write>;
+
+fn toMoments(depth: f32) -> vec4f
+{
+    let warped   = 2.0 * depth - 1.0;
+    let positive = exp(exponents.x * warped);
+    let negative = -exp(-exponents.y * warped);
+    return vec4f(positive, positive * positive, negative, negative * negative);
+}
+
+// The moments of a texel are the average of the moments of the 2x2 depth texels it covers
+fn loadMoments(position: vec2i) -> vec4f
+{
+    let size  = vec2i(textureDimensions(depth)) - 1;
+    let start = 2 * position;
+
+    var sum = vec4f(0.0);
+    for (var j = 0; j < 2; j++)
+    {
+        for (var i = 0; i < 2; i++)
+        {
+            sum += toMoments(textureLoad(depth, clamp(start + vec2i(i, j), vec2i(0), size), 0));
+        }
+    }
+    return sum * 0.25;
+}
+
+@compute @workgroup_size(8, 8)
+fn blur_horizontal(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = vec2i(textureDimensions(horizontal));
+    let position = vec2i(id.xy);
+    if (position.x >= size.x || position.y >= size.y) { return; }
+
+    var sum = vec4f(0.0);
+    for (var i = -blurRadius; i <= blurRadius; i++)
+    {
+        let x = clamp(position.x + i, 0, size.x - 1);
+        sum += blurWeights[abs(i)] * loadMoments(vec2i(x, position.y));
+    }
+    textureStore(horizontal, position, sum);
+}
+
+@compute @workgroup_size(8, 8)
+fn blur_vertical(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = vec2i(textureDimensions(moments));
+    let position = vec2i(id.xy);
+    if (position.x >= size.x || position.y >= size.y) { return; }
+
+    var sum = vec4f(0.0);
+    for (var i = -blurRadius; i <= blurRadius; i++)
+    {
+        let y = clamp(position.y + i, 0, size.y - 1);
+        sum += blurWeights[abs(i)] * textureLoad(blurred, vec2i(position.x, y), 0);
+    }
+    textureStore(moments, position, sum);
+}
+
+// Moments average linearly, so the levels are a box filter of the previous one
+@compute @workgroup_size(8, 8)
+fn downsample(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = textureDimensions(nextLevel);
+    if (id.x >= size.x || id.y >= size.y) { return; }
+
+    let previousSize = textureDimensions(previousLevel) - 1u;
+    let start        = 2u * id.xy;
+
+    var sum = vec4f(0.0);
+    for (var j = 0u; j < 2u; j++)
+    {
+        for (var i = 0u; i < 2u; i++)
+        {
+            sum += textureLoad(previousLevel, min(start + vec2u(i, j), previousSize), 0);
+        }
+    }
+    textureStore(nextLevel, id.xy, sum * 0.25);
+}
@@ -23,24 +23,13 @@ struct Model
 var<uniform> frame: Frame;
 
 @group(1) @binding(0)
-var<uniform> model: Model;
+var<storage, read> models: array<Model>;
 
 @vertex
-fn vs_main(in: VertexInput) -> VertexOutput
+fn vs_main(in: VertexInput, @builtin(instance_index) instance: u32) -> VertexOutput
 {
     var out: VertexOutput;
 
-    out.position = frame.projection * frame.view * model.model * in.position;
+    out.position = frame.projection * frame.view * models[instance].model * in.position;
     return out;
 }
-
-@fragment
-fn fs_main(in: VertexOutput) -> @builtin(frag_depth) f32
-{
-    return 0.0;
-}
-
-// @fragment
-// fn fs_main()
-// {
-// }
\ No newline at end of file
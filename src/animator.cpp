@@ -32,3 +32,8 @@ void Animator::stop()
 {
     isRunning = false;
 }
+
+bool Animator::running() const
+{
+    return isRunning;
+}
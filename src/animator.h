@@ -16,6 +16,8 @@ public:
     void start();
     void stop();
 
+    bool running() const;
+
 private:
     bool isRunning = false;
 
@@ -0,0 +1,220 @@
+#include "batchrender.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "graphics/gpu.h"
+#include "graphics/rendertarget.h"
+#include "scheduler.h"
+#include "viewport.h"
+#include "object.h"
+#include "io/loader.h"
+
+using namespace glm;
+
+struct BatchRenderJob
+{
+    std::string             modelPath;
+    std::string             outputPath;
+    std::optional<vec3>     eye;
+    std::optional<vec3>     target;
+};
+
+std::vector<BatchRenderJob> readJobs(const std::string& filePath)
+{
+    std::vector<BatchRenderJob> jobs;
+
+    std::ifstream stream(filePath);
+    if (!stream.is_open())
+    {
+        std::cerr << "Error: Could not open " << filePath << std::endl;
+        return jobs;
+    }
+
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        std::istringstream tokens(line);
+        BatchRenderJob job;
+        if (!(tokens >> job.modelPath) || job.modelPath[0] == '#') continue;
+
+        if (!(tokens >> job.outputPath))
+        {
+            std::cerr << "Skipping job without output path: " << line << std::endl;
+            continue;
+        }
+
+        vec3 value;
+        if (tokens >> value.x >> value.y >> value.z) job.eye    = value;
+        if (tokens >> value.x >> value.y >> value.z) job.target = value;
+
+        jobs.emplace_back(job);
+    }
+    return jobs;
+}
+
+int runBatchRender(int argc, char** argv)
+{
+    std::string jobsFile;
+    vec2        size = vec2(1024, 768);
+    Gpu::Params gpuParams;
+    int         textureBudget = 0;
+    bool        depthPrepass  = false;
+    int         shadowSamples = 16;
+    ShadowFilter shadowFilter = ShadowFilter::Pcf;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        std::string value    = i + 1 < argc ? argv[i + 1] : "";
+
+        if (argument == "--batch")
+        {
+            jobsFile = value;
+            i++;
+        }
+        else if (argument == "--size")
+        {
+            int width = 0, height = 0;
+            if (sscanf(value.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+                size = vec2(width, height);
+            i++;
+        }
+        else if (argument == "--backend")
+        {
+            if (value == "null")
+                gpuParams.backendType = WGPUBackendType_Null;
+            else if (value == "swiftshader")
+                gpuParams.forceFallbackAdapter = true;
+            i++;
+        }
+        else if (argument == "--full-vertices")
+        {
+            gpuParams.vertexFormat = VertexBuffer::Format::Full;
+        }
+        else if (argument == "--texture-budget")
+        {
+            textureBudget = std::atoi(value.c_str());
+            i++;
+        }
+        else if (argument == "--depth-prepass")
+        {
+            depthPrepass = true;
+        }
+        else if (argument == "--shadow-samples")
+        {
+            shadowSamples = std::atoi(value.c_str());
+            i++;
+        }
+        else if (argument == "--shadow-filter")
+        {
+            if (value == "evsm")
+                shadowFilter = ShadowFilter::Evsm;
+            else if (value == "pcf")
+                shadowFilter = ShadowFilter::Pcf;
+            i++;
+        }
+    }
+
+    std::vector<BatchRenderJob> jobs = readJobs(jobsFile);
+    if (jobs.empty())
+    {
+        std::cerr << "No jobs to render in " << jobsFile << std::endl;
+        return 1;
+    }
+
+    Gpu             gpu(gpuParams);
+    Scheduler       scheduler;
+    OffscreenTarget offscreenTarget(gpu, size);
+
+    // Every job renders a single frame, the textures can't be refined over the next ones
+    TextureStreamer&        textureStreamer = gpu.getResourcePool().getTextureStreamer();
+    TextureStreamer::Params streamerParams  = textureStreamer.getParams();
+    streamerParams.immediate = true;
+    if (textureBudget > 0)
+        streamerParams.budgetBytes = uint64_t(textureBudget) << 20;
+    textureStreamer.setParams(streamerParams);
+    gpu.getUploadManager().setFrameBudget(std::numeric_limits<uint64_t>::max());
+
+    Object          root;
+    Object          sceneParent(root);
+    CameraObject    camera  = CameraObject(root);
+    LightObject     light   = LightObject(camera);
+
+    const float fov = radians(45.0f);
+    camera.setPerspective(fov, 0.1f, 1000.0f);
+    light.lookAt(vec3(1.0, 0.6, 0), vec3(0, 0, 1), vec3(0, 1, 0));
+
+    std::string                 loadedModel;
+    std::unique_ptr<Scene>      scene;
+    std::unique_ptr<Viewport>   viewport;
+    int                         nrFailed = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (const BatchRenderJob& job : jobs)
+    {
+        // Consecutive jobs on the same model reuse the loaded scene and its gpu resources.
+        if (job.modelPath != loadedModel)
+        {
+            viewport    = nullptr;
+            scene       = nullptr;
+            gpu.getResourcePool().clear();
+
+            scene       = loadModelObjects(job.modelPath, sceneParent);
+            viewport    = std::make_unique<Viewport>(scheduler, gpu, offscreenTarget, *scene);
+            viewport->setDepthPrepass(depthPrepass);
+            viewport->setShadowSamples(shadowSamples);
+            viewport->setShadowFilter(shadowFilter);
+            viewport->attachCamera(camera);
+            viewport->attachLight(light);
+            for (auto& renderable : scene->all())
+                viewport->attachRenderable(renderable->getRenderable());
+
+            loadedModel = job.modelPath;
+        }
+
+        Box   box       = scene->getBox();
+        vec3  target    = job.target.value_or(box.center());
+        float radius    = length(box.max - box.min) * 0.5f;
+        vec3  eye       = job.eye.value_or(target + vec3(0, 0, 1.2f * radius / tan(fov * 0.5f)));
+
+        camera.lookAt(eye, target, vec3(0, 1, 0));
+
+        std::string outputPath = job.outputPath;
+        offscreenTarget.setReadbackCallback([outputPath, &nrFailed](const Image& image)
+        {
+            if (!saveImage(outputPath, image))
+                nrFailed++;
+        });
+
+        viewport->render();
+    }
+
+    offscreenTarget.flush();
+
+    auto  time      = std::chrono::steady_clock::now() - startTime;
+    float seconds   = std::chrono::duration_cast<std::chrono::milliseconds>(time).count() / 1000.0f;
+    std::cout << "Rendered " << jobs.size() - nrFailed << " of " << jobs.size() << " jobs in " << seconds << "s ("
+              << jobs.size() / std::max(seconds, 0.001f) << " jobs/s)" << std::endl;
+
+    const TextureStreamer::Stats& textureStats = textureStreamer.getStats();
+    std::cout << "Textures: " << textureStats.textureCount << " resident in " << (textureStats.residentBytes >> 20) << " of "
+              << (textureStats.budgetBytes >> 20) << " MB, " << (textureStats.chainBytes >> 20) << " MB of generated mip chains, "
+              << textureStats.evictionCount << " evictions" << std::endl;
+
+    viewport = nullptr;
+    scene    = nullptr;
+    gpu.getResourcePool().clear();
+
+    return nrFailed == 0 ? 0 : 1;
+}
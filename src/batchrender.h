@@ -0,0 +1,15 @@
+#pragma once
+
+// Renders a list of (model, camera) jobs without a window, as fast as the device allows,
+// and writes every frame to disk. Works on Dawn's null and SwiftShader backends, so it
+// runs on machines without a GPU.
+//
+//   --batch <jobs file> [--size <width>x<height>] [--backend default|null|swiftshader] [--texture-budget <MB>]
+//           [--depth-prepass] [--shadow-samples <1..32>] [--shadow-filter pcf|evsm]
+//
+// Every line of the jobs file is one job, empty lines and lines starting with # are skipped:
+//
+//   <model.glb> <output.png|bmp|tga|hdr> [eyeX eyeY eyeZ [targetX targetY targetZ]]
+//
+// Without an eye position the camera frames the whole model, the target defaults to its center.
+int runBatchRender(int argc, char** argv);
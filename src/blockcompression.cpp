@@ -0,0 +1,705 @@
+#include "blockcompression.h"
+#include "threadpool.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+namespace
+{
+    // The texels of a block as floats, one array per channel
+    struct Block
+    {
+        float channels[4][16];
+
+        vec4 texel(int i) const
+        {
+            return vec4(channels[0][i], channels[1][i], channels[2][i], channels[3][i]);
+        }
+    };
+
+    // Texels outside smaller levels repeat the last row or column
+    Block fetchBlock(const uint8_t* pixels, int width, int height, int blockX, int blockY)
+    {
+        Block block;
+        for (int i = 0; i < 16; i++)
+        {
+            int x = std::min(blockX * 4 + i % 4, width - 1);
+            int y = std::min(blockY * 4 + i / 4, height - 1);
+            const uint8_t* texel = pixels + (size_t(y) * width + x) * 4;
+            for (int c = 0; c < 4; c++)
+                block.channels[c][i] = texel[c];
+        }
+        return block;
+    }
+
+    // Direction of the largest variance of the texels in the first n channels, by power iteration on the covariance
+    template <int N>
+    vec<N, float> principalAxis(const Block& block, const vec<N, float>& mean)
+    {
+        mat<N, N, float> covariance(0.0f);
+        for (int i = 0; i < 16; i++)
+        {
+            vec<N, float> d;
+            for (int c = 0; c < N; c++)
+                d[c] = block.channels[c][i] - mean[c];
+            covariance += outerProduct(d, d);
+        }
+
+        vec<N, float> axis(1.0f);
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            vec<N, float> next = covariance * axis;
+            float         size = length(next);
+            if (size < 1e-6f) break;
+            axis = next / size;
+        }
+        return axis;
+    }
+
+    // Solves the endpoints that minimize the squared error of texels interpolated with weights w (0 is endpoint 0)
+    template <int N>
+    bool leastSquaresEndpoints(const Block& block, const float weights[16], vec<N, float>& e0, vec<N, float>& e1)
+    {
+        float           aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        vec<N, float>   ax(0.0f), bx(0.0f);
+        for (int i = 0; i < 16; i++)
+        {
+            float a = 1.0f - weights[i];
+            float b = weights[i];
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < N; c++)
+            {
+                ax[c] += a * block.channels[c][i];
+                bx[c] += b * block.channels[c][i];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) return false;
+
+        e0 = clamp((ax * bb - bx * ab) / determinant, 0.0f, 255.0f);
+        e1 = clamp((bx * aa - ax * ab) / determinant, 0.0f, 255.0f);
+        return true;
+    }
+
+    // BC1
+
+    uint16_t toRGB565(const vec3& color)
+    {
+        uvec3 q = uvec3(round(clamp(color, 0.0f, 255.0f) * vec3(31.0f, 63.0f, 31.0f) / 255.0f));
+        return uint16_t((q.r << 11) | (q.g << 5) | q.b);
+    }
+
+    ivec3 fromRGB565(uint16_t color)
+    {
+        int r = (color >> 11) & 31;
+        int g = (color >> 5) & 63;
+        int b = color & 31;
+        return ivec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    }
+
+    void bc1Palette(uint16_t c0, uint16_t c1, bool fourColors, ivec4 palette[4])
+    {
+        ivec3 p0 = fromRGB565(c0);
+        ivec3 p1 = fromRGB565(c1);
+        palette[0] = ivec4(p0, 255);
+        palette[1] = ivec4(p1, 255);
+        if (fourColors)
+        {
+            palette[2] = ivec4((2 * p0 + p1 + 1) / 3, 255);
+            palette[3] = ivec4((p0 + 2 * p1 + 1) / 3, 255);
+        }
+        else
+        {
+            palette[2] = ivec4((p0 + p1) / 2, 255);
+            palette[3] = ivec4(0);
+        }
+    }
+
+    // Picks the nearest palette color for every texel, returns the squared error
+    float bc1Indices(const Block& block, uint16_t c0, uint16_t c1, uint32_t& indices)
+    {
+        ivec4 palette[4];
+        bc1Palette(c0, c1, true, palette);
+
+        float error = 0.0f;
+        indices     = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            vec3  texel     = vec3(block.texel(i));
+            float best      = FLT_MAX;
+            int   bestIndex = 0;
+            for (int p = 0; p < 4; p++)
+            {
+                vec3  d         = texel - vec3(palette[p]);
+                float distance  = dot(d, d);
+                if (distance < best)
+                {
+                    best        = distance;
+                    bestIndex   = p;
+                }
+            }
+            error   += best;
+            indices |= uint32_t(bestIndex) << (2 * i);
+        }
+        return error;
+    }
+
+    void encodeBC1(const Block& block, uint8_t* out)
+    {
+        vec3 mean(0.0f);
+        for (int i = 0; i < 16; i++)
+            mean += vec3(block.texel(i)) / 16.0f;
+
+        vec3  axis = principalAxis<3>(block, mean);
+        float low  = FLT_MAX, high = -FLT_MAX;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = dot(vec3(block.texel(i)) - mean, axis);
+            low     = std::min(low, t);
+            high    = std::max(high, t);
+        }
+
+        uint16_t c0         = toRGB565(mean + axis * high);
+        uint16_t c1         = toRGB565(mean + axis * low);
+        uint32_t indices    = 0;
+        float    error      = bc1Indices(block, c0, c1, indices);
+
+        // Refits the endpoints to the chosen indices, the palette weights of endpoint 1 per index
+        const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        for (int iteration = 0; iteration < 2 && error > 0.0f; iteration++)
+        {
+            float texelWeights[16];
+            for (int i = 0; i < 16; i++)
+                texelWeights[i] = weights[(indices >> (2 * i)) & 3];
+
+            vec3 e0, e1;
+            if (!leastSquaresEndpoints<3>(block, texelWeights, e0, e1)) break;
+
+            uint16_t newC0      = toRGB565(e0);
+            uint16_t newC1      = toRGB565(e1);
+            uint32_t newIndices = 0;
+            float    newError   = bc1Indices(block, newC0, newC1, newIndices);
+            if (newError >= error) break;
+
+            c0      = newC0;
+            c1      = newC1;
+            indices = newIndices;
+            error   = newError;
+        }
+
+        // The four color mode needs c0 > c1, swapping the endpoints swaps indices 0 with 1 and 2 with 3
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+            indices ^= 0x55555555;
+        }
+        else if (c0 == c1)
+        {
+            indices = 0;
+        }
+
+        out[0] = uint8_t(c0);
+        out[1] = uint8_t(c0 >> 8);
+        out[2] = uint8_t(c1);
+        out[3] = uint8_t(c1 >> 8);
+        std::memcpy(out + 4, &indices, 4);
+    }
+
+    void decodeBC1(const uint8_t* in, bool alwaysFourColors, uint8_t texels[16][4])
+    {
+        uint16_t c0 = uint16_t(in[0] | (in[1] << 8));
+        uint16_t c1 = uint16_t(in[2] | (in[3] << 8));
+        uint32_t indices;
+        std::memcpy(&indices, in + 4, 4);
+
+        ivec4 palette[4];
+        bc1Palette(c0, c1, alwaysFourColors || c0 > c1, palette);
+        for (int i = 0; i < 16; i++)
+        {
+            ivec4 color = palette[(indices >> (2 * i)) & 3];
+            for (int c = 0; c < 4; c++)
+                texels[i][c] = uint8_t(color[c]);
+        }
+    }
+
+    // BC4, one channel, used for the alpha of BC3 and both channels of BC5
+
+    void encodeBC4(const float values[16], uint8_t* out)
+    {
+        float low  = *std::min_element(values, values + 16);
+        float high = *std::max_element(values, values + 16);
+
+        uint8_t  a0      = uint8_t(std::lround(high));
+        uint8_t  a1      = uint8_t(std::lround(low));
+        uint64_t indices = 0;
+
+        // With a0 > a1 the palette has 8 values: a0, a1 and 6 interpolated ones from a0 towards a1
+        if (a0 > a1)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int step = int(std::lround((values[i] - a1) * 7.0f / (a0 - a1)));
+                step     = std::clamp(step, 0, 7);
+                int code = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+                indices |= uint64_t(code) << (3 * i);
+            }
+        }
+
+        out[0] = a0;
+        out[1] = a1;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = uint8_t(indices >> (8 * i));
+    }
+
+    void decodeBC4(const uint8_t* in, uint8_t values[16])
+    {
+        int a0 = in[0];
+        int a1 = in[1];
+
+        int palette[8] = { a0, a1 };
+        if (a0 > a1)
+        {
+            for (int i = 2; i < 8; i++)
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+        else
+        {
+            for (int i = 2; i < 6; i++)
+                palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++)
+            indices |= uint64_t(in[2 + i]) << (8 * i);
+        for (int i = 0; i < 16; i++)
+            values[i] = uint8_t(palette[(indices >> (3 * i)) & 7]);
+    }
+
+    // BC7
+
+    const int bc7Weights2[4]  = { 0, 21, 43, 64 };
+    const int bc7Weights3[8]  = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    int bc7Interpolate(int e0, int e1, int weight)
+    {
+        return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+    }
+
+    class BitWriter
+    {
+    public:
+        BitWriter(uint8_t* out)
+            : m_out(out)
+        {
+            std::memset(m_out, 0, 16);
+        }
+
+        void write(uint32_t value, int bits)
+        {
+            for (int i = 0; i < bits; i++, m_position++)
+                m_out[m_position >> 3] |= uint8_t(((value >> i) & 1) << (m_position & 7));
+        }
+
+    private:
+        uint8_t*    m_out;
+        int         m_position = 0;
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* in)
+            : m_in(in)
+        {
+        }
+
+        uint32_t read(int bits)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < bits; i++, m_position++)
+                value |= uint32_t((m_in[m_position >> 3] >> (m_position & 7)) & 1) << i;
+            return value;
+        }
+
+    private:
+        const uint8_t*  m_in;
+        int             m_position = 0;
+    };
+
+    struct BC7Mode6
+    {
+        ivec4   endpoints[2];   // 7 bits per channel
+        int     pBits[2];
+        int     indices[16];
+        float   error = FLT_MAX;
+    };
+
+    // Chooses the indices for quantized endpoints, the projection on the line picks the index and its neighbours
+    // are tried as well because the weights aren't evenly spaced
+    void bc7Indices(const Block& block, BC7Mode6& mode)
+    {
+        ivec4 e0 = mode.endpoints[0] * 2 + mode.pBits[0];
+        ivec4 e1 = mode.endpoints[1] * 2 + mode.pBits[1];
+        vec4  direction = vec4(e1 - e0);
+        float lengthSquared = dot(direction, direction);
+
+        mode.error = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            vec4 texel  = block.texel(i);
+            int  guess  = lengthSquared > 0.0f ? int(std::lround(dot(texel - vec4(e0), direction) / lengthSquared * 15.0f)) : 0;
+
+            float best      = FLT_MAX;
+            int   bestIndex = 0;
+            for (int index = std::max(0, guess - 1); index <= std::min(15, guess + 1); index++)
+            {
+                vec4 color;
+                for (int c = 0; c < 4; c++)
+                    color[c] = float(bc7Interpolate(e0[c], e1[c], bc7Weights4[index]));
+
+                vec4  d         = texel - color;
+                float distance  = dot(d, d);
+                if (distance < best)
+                {
+                    best        = distance;
+                    bestIndex   = index;
+                }
+            }
+            mode.indices[i]  = bestIndex;
+            mode.error      += best;
+        }
+    }
+
+    // Quantizes the endpoints with the p-bits that give the lowest error
+    BC7Mode6 bc7Quantize(const Block& block, const vec4& e0, const vec4& e1)
+    {
+        BC7Mode6 best;
+        for (int p = 0; p < 4; p++)
+        {
+            BC7Mode6 mode;
+            mode.pBits[0]       = p & 1;
+            mode.pBits[1]       = p >> 1;
+            mode.endpoints[0]   = clamp(ivec4(round((e0 - float(mode.pBits[0])) / 2.0f)), 0, 127);
+            mode.endpoints[1]   = clamp(ivec4(round((e1 - float(mode.pBits[1])) / 2.0f)), 0, 127);
+            bc7Indices(block, mode);
+            if (mode.error < best.error) best = mode;
+        }
+        return best;
+    }
+
+    void encodeBC7(const Block& block, uint8_t* out)
+    {
+        vec4 mean(0.0f);
+        for (int i = 0; i < 16; i++)
+            mean += block.texel(i) / 16.0f;
+
+        vec4  axis = principalAxis<4>(block, mean);
+        float low  = FLT_MAX, high = -FLT_MAX;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = dot(block.texel(i) - mean, axis);
+            low     = std::min(low, t);
+            high    = std::max(high, t);
+        }
+
+        BC7Mode6 mode = bc7Quantize(block, clamp(mean + axis * low, 0.0f, 255.0f), clamp(mean + axis * high, 0.0f, 255.0f));
+        for (int iteration = 0; iteration < 2 && mode.error > 0.0f; iteration++)
+        {
+            float weights[16];
+            for (int i = 0; i < 16; i++)
+                weights[i] = bc7Weights4[mode.indices[i]] / 64.0f;
+
+            vec4 e0, e1;
+            if (!leastSquaresEndpoints<4>(block, weights, e0, e1)) break;
+
+            BC7Mode6 refined = bc7Quantize(block, e0, e1);
+            if (refined.error >= mode.error) break;
+            mode = refined;
+        }
+
+        // The most significant bit of the first index is implicitly 0
+        if (mode.indices[0] >= 8)
+        {
+            std::swap(mode.endpoints[0], mode.endpoints[1]);
+            std::swap(mode.pBits[0], mode.pBits[1]);
+            for (int i = 0; i < 16; i++)
+                mode.indices[i] = 15 - mode.indices[i];
+        }
+
+        BitWriter writer(out);
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++)
+        {
+            writer.write(mode.endpoints[0][c], 7);
+            writer.write(mode.endpoints[1][c], 7);
+        }
+        writer.write(mode.pBits[0], 1);
+        writer.write(mode.pBits[1], 1);
+        for (int i = 0; i < 16; i++)
+            writer.write(mode.indices[i], i == 0 ? 3 : 4);
+    }
+
+    // Expands an endpoint of bits bits to 8 bits
+    int bc7Expand(int value, int bits)
+    {
+        value <<= 8 - bits;
+        return value | (value >> bits);
+    }
+
+    std::atomic<bool> reportedUndecodable = false;
+
+    void decodeUndecodable(uint8_t texels[16][4])
+    {
+        if (!reportedUndecodable.exchange(true))
+            std::cerr << "Warning: blocks that can't be decoded on the CPU are shown grey" << std::endl;
+
+        for (int i = 0; i < 16; i++)
+        {
+            texels[i][0] = texels[i][1] = texels[i][2] = 128;
+            texels[i][3] = 255;
+        }
+    }
+
+    // Modes 4, 5 and 6, the modes with a single subset
+    void decodeBC7(const uint8_t* in, uint8_t texels[16][4])
+    {
+        int mode = 0;
+        while (mode < 8 && !(in[0] & (1 << mode)))
+            mode++;
+
+        if (mode < 4 || mode > 6)
+        {
+            decodeUndecodable(texels);
+            return;
+        }
+
+        BitReader reader(in);
+        reader.read(mode + 1);
+
+        int     rotation        = mode == 6 ? 0 : int(reader.read(2));
+        int     indexSelection  = mode == 4 ? int(reader.read(1)) : 0;
+        int     colorBits       = mode == 4 ? 5 : 7;
+        int     alphaBits       = mode == 4 ? 6 : mode == 5 ? 8 : 7;
+        ivec4   e0, e1;
+        for (int c = 0; c < 3; c++)
+        {
+            e0[c] = int(reader.read(colorBits));
+            e1[c] = int(reader.read(colorBits));
+        }
+        e0.a = int(reader.read(alphaBits));
+        e1.a = int(reader.read(alphaBits));
+
+        if (mode == 6)
+        {
+            int p0 = int(reader.read(1));
+            int p1 = int(reader.read(1));
+            e0 = e0 * 2 + p0;
+            e1 = e1 * 2 + p1;
+        }
+        else
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                e0[c] = bc7Expand(e0[c], colorBits);
+                e1[c] = bc7Expand(e1[c], colorBits);
+            }
+            e0.a = bc7Expand(e0.a, alphaBits);
+            e1.a = bc7Expand(e1.a, alphaBits);
+        }
+
+        // Mode 6 has one set of indices, modes 4 and 5 a second one for alpha
+        int primaryBits     = mode == 6 ? 4 : 2;
+        int secondaryBits   = mode == 4 ? 3 : 2;
+        int primary[16], secondary[16];
+        for (int i = 0; i < 16; i++)
+            primary[i] = int(reader.read(i == 0 ? primaryBits - 1 : primaryBits));
+        if (mode != 6)
+        {
+            for (int i = 0; i < 16; i++)
+                secondary[i] = int(reader.read(i == 0 ? secondaryBits - 1 : secondaryBits));
+        }
+
+        auto weight = [](int bits, int index)
+        {
+            return bits == 2 ? bc7Weights2[index] : bits == 3 ? bc7Weights3[index] : bc7Weights4[index];
+        };
+
+        for (int i = 0; i < 16; i++)
+        {
+            int colorWeight, alphaWeight;
+            if (mode == 6)
+            {
+                colorWeight = alphaWeight = weight(4, primary[i]);
+            }
+            else if (indexSelection == 0)
+            {
+                colorWeight = weight(primaryBits, primary[i]);
+                alphaWeight = weight(secondaryBits, secondary[i]);
+            }
+            else
+            {
+                colorWeight = weight(secondaryBits, secondary[i]);
+                alphaWeight = weight(primaryBits, primary[i]);
+            }
+
+            ivec4 color;
+            for (int c = 0; c < 3; c++)
+                color[c] = bc7Interpolate(e0[c], e1[c], colorWeight);
+            color.a = bc7Interpolate(e0.a, e1.a, alphaWeight);
+
+            if (rotation > 0)
+                std::swap(color.a, color[rotation - 1]);
+
+            for (int c = 0; c < 4; c++)
+                texels[i][c] = uint8_t(color[c]);
+        }
+    }
+
+    void encodeBlock(const Block& block, Image::Type format, uint8_t* out)
+    {
+        switch (format)
+        {
+            case Image::Type::BC1:
+                encodeBC1(block, out);
+                break;
+            case Image::Type::BC3:
+                encodeBC4(block.channels[3], out);
+                encodeBC1(block, out + 8);
+                break;
+            case Image::Type::BC5:
+                encodeBC4(block.channels[0], out);
+                encodeBC4(block.channels[1], out + 8);
+                break;
+            default:
+                encodeBC7(block, out);
+                break;
+        }
+    }
+
+    void decodeBlock(const uint8_t* in, Image::Type format, uint8_t texels[16][4])
+    {
+        uint8_t values[2][16];
+        switch (format)
+        {
+            case Image::Type::BC1:
+                decodeBC1(in, false, texels);
+                break;
+            case Image::Type::BC3:
+                decodeBC1(in + 8, true, texels);
+                decodeBC4(in, values[0]);
+                for (int i = 0; i < 16; i++)
+                    texels[i][3] = values[0][i];
+                break;
+            case Image::Type::BC5:
+                decodeBC4(in, values[0]);
+                decodeBC4(in + 8, values[1]);
+                for (int i = 0; i < 16; i++)
+                {
+                    texels[i][0] = values[0][i];
+                    texels[i][1] = values[1][i];
+                    texels[i][2] = 0;
+                    texels[i][3] = 255;
+                }
+                break;
+            case Image::Type::BC7:
+                decodeBC7(in, texels);
+                break;
+            default:
+                decodeUndecodable(texels);
+                break;
+        }
+    }
+}
+
+bool canCompress(const Image& image)
+{
+    return image.type == Image::Type::RGBA && image.width % 4 == 0 && image.height % 4 == 0;
+}
+
+Image compressImage(const Image& image, Image::Type format)
+{
+    Image result;
+    result.width            = image.width;
+    result.height           = image.height;
+    result.bytesPerPixel    = 0;
+    result.type             = format;
+    result.mipLevelCount    = image.mipLevelCount;
+    result.pixels           = std::make_shared<std::vector<uint8_t>>(result.mipLevelOffset(result.mipLevelCount));
+
+    for (int level = 0; level < image.mipLevelCount; level++)
+    {
+        const uint8_t*  source      = image.getPixels() + image.mipLevelOffset(level);
+        uint8_t*        destination = result.pixels->data() + result.mipLevelOffset(level);
+        int             width       = image.mipLevelWidth(level);
+        int             height      = image.mipLevelHeight(level);
+        int             blocksWide  = (width + 3) / 4;
+        int             blocksHigh  = (height + 3) / 4;
+        int             blockBytes  = result.blockBytes();
+
+        // Rows of blocks in chunks of about 1024 blocks
+        ThreadPool::shared().parallelFor(size_t(blocksHigh), std::max(1, 1024 / blocksWide), [&](size_t begin, size_t end)
+        {
+            for (size_t y = begin; y < end; y++)
+                for (int x = 0; x < blocksWide; x++)
+                    encodeBlock(fetchBlock(source, width, height, x, int(y)), format, destination + (y * blocksWide + x) * blockBytes);
+        });
+    }
+    return result;
+}
+
+Image decompressImage(const Image& image)
+{
+    Image result;
+    result.width            = image.width;
+    result.height           = image.height;
+    result.bytesPerPixel    = 4;
+    result.type             = Image::Type::RGBA;
+    result.mipLevelCount    = image.mipLevelCount;
+    result.pixels           = std::make_shared<std::vector<uint8_t>>(result.mipLevelOffset(result.mipLevelCount));
+
+    for (int level = 0; level < image.mipLevelCount; level++)
+    {
+        const uint8_t*  source      = image.getPixels() + image.mipLevelOffset(level);
+        uint8_t*        destination = result.pixels->data() + result.mipLevelOffset(level);
+        int             width       = image.mipLevelWidth(level);
+        int             height      = image.mipLevelHeight(level);
+        int             blocksWide  = (width + 3) / 4;
+        int             blocksHigh  = (height + 3) / 4;
+        int             blockBytes  = image.blockBytes();
+
+        ThreadPool::shared().parallelFor(size_t(blocksHigh), std::max(1, 1024 / blocksWide), [&](size_t begin, size_t end)
+        {
+            uint8_t texels[16][4];
+            for (size_t y = begin; y < end; y++)
+            {
+                for (int x = 0; x < blocksWide; x++)
+                {
+                    decodeBlock(source + (y * blocksWide + x) * blockBytes, image.type, texels);
+
+                    // Texels beyond the edges of small levels are dropped
+                    for (int i = 0; i < 16; i++)
+                    {
+                        int texelX = x * 4 + i % 4;
+                        int texelY = int(y) * 4 + i / 4;
+                        if (texelX < width && texelY < height)
+                            std::memcpy(destination + (size_t(texelY) * width + texelX) * 4, texels[i], 4);
+                    }
+                }
+            }
+        });
+    }
+    return result;
+}
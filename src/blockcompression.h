@@ -0,0 +1,20 @@
+#pragma once
+
+#include "image.h"
+
+// Block compressed images store 4x4 texel blocks that the GPU samples directly:
+//  BC1 RGB in 8 bytes, BC3 RGBA in 16 bytes (BC1 color with a separate alpha block), BC5 two channels in 16 bytes
+//  for normal maps, and BC7 RGBA in 16 bytes with a better quality than BC1 and BC3.
+// The encoder writes BC7 in mode 6 only, a single color line with 4-bit indices, which any decoder reads.
+
+// Whether the image, 8-bit RGBA, can be compressed: textures of block compressed formats need sizes that are
+// multiples of the block size
+bool canCompress(const Image& image);
+
+// Compresses every mip level of an 8-bit RGBA image to format, one of the BC types. The blocks are encoded in
+// parallel on the shared thread pool.
+Image compressImage(const Image& image, Image::Type format);
+
+// Decodes every mip level of a BC image to 8-bit RGBA, for adapters without the compressed formats. BC7 blocks
+// with more than one subset, and ETC2 and ASTC images can't be decoded, they become grey.
+Image decompressImage(const Image& image);
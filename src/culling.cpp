@@ -0,0 +1,141 @@
+#include "culling.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#endif
+
+using namespace glm;
+
+Frustum::Frustum(const mat4& viewProjection)
+{
+    // Gribb-Hartmann plane extraction for a 0..1 clip space depth range.
+    mat4 m = transpose(viewProjection);
+    planes[0] = m[3] + m[0];  // left
+    planes[1] = m[3] - m[0];  // right
+    planes[2] = m[3] + m[1];  // bottom
+    planes[3] = m[3] - m[1];  // top
+    planes[4] = m[2];         // near
+    planes[5] = m[3] - m[2];  // far
+
+    for (vec4& plane : planes)
+        plane /= length(vec3(plane));
+}
+
+void Culler::update(const std::vector<const Renderable*>& renderables)
+{
+    m_renderables = renderables;
+    m_bounds.min  = vec3(std::numeric_limits<float>::max());
+    m_bounds.max  = vec3(-std::numeric_limits<float>::max());
+
+    size_t count = renderables.size();
+    for (std::vector<float>* values : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+        values->resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Box& box = renderables[i]->mesh.boundingBox;
+
+        vec3 center = vec3(0.0f);
+        vec3 extent = vec3(1e30f); // Meshes without a valid bounding box are never culled
+
+        if (all(lessThanEqual(box.min, box.max)))
+        {
+            mat4 toRoot = renderables[i]->object->getSpace().toRoot;
+
+            Box worldBox;
+            worldBox.min = vec3(std::numeric_limits<float>::max());
+            worldBox.max = vec3(-std::numeric_limits<float>::max());
+            for (int corner = 0; corner < 8; corner++)
+            {
+                vec3 position(
+                    corner & 1 ? box.max.x : box.min.x,
+                    corner & 2 ? box.max.y : box.min.y,
+                    corner & 4 ? box.max.z : box.min.z);
+                worldBox.expand(vec3(toRoot * vec4(position, 1.0f)));
+            }
+            m_bounds.expand(worldBox.min);
+            m_bounds.expand(worldBox.max);
+
+            center = worldBox.center();
+            extent = (worldBox.max - worldBox.min) * 0.5f;
+        }
+
+        m_centerX[i] = center.x; m_centerY[i] = center.y; m_centerZ[i] = center.z;
+        m_extentX[i] = extent.x; m_extentY[i] = extent.y; m_extentZ[i] = extent.z;
+    }
+}
+
+const Box& Culler::bounds() const
+{
+    return m_bounds;
+}
+
+Culler::Stats Culler::cull(const Frustum& frustum, std::vector<const Renderable*>& result, bool shadowCasters) const
+{
+    size_t count = m_renderables.size();
+    m_inside.assign(count, 1);
+
+    // A box is outside when it is fully behind one of the planes:
+    // dot(n, center) + dot(abs(n), extent) + d < 0
+    size_t i = 0;
+#ifdef CULLING_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&m_centerX[i]);
+        __m128 cy = _mm_loadu_ps(&m_centerY[i]);
+        __m128 cz = _mm_loadu_ps(&m_centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&m_extentX[i]);
+        __m128 ey = _mm_loadu_ps(&m_extentY[i]);
+        __m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const vec4& plane : frustum.planes)
+        {
+            __m128 distance = _mm_set1_ps(plane.w);
+            distance = _mm_add_ps(distance, _mm_mul_ps(cx, _mm_set1_ps(plane.x)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ex, _mm_set1_ps(std::abs(plane.x))));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane.y))));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ez, _mm_set1_ps(std::abs(plane.z))));
+            outside  = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++)
+            m_inside[i + lane] = (mask & (1 << lane)) == 0;
+    }
+#endif
+    for (; i < count; i++)
+    {
+        for (const vec4& plane : frustum.planes)
+        {
+            float distance = plane.w
+                + m_centerX[i] * plane.x + m_centerY[i] * plane.y + m_centerZ[i] * plane.z
+                + m_extentX[i] * std::abs(plane.x) + m_extentY[i] * std::abs(plane.y) + m_extentZ[i] * std::abs(plane.z);
+            if (distance < 0.0f)
+            {
+                m_inside[i] = 0;
+                break;
+            }
+        }
+    }
+
+    Stats stats;
+    for (size_t j = 0; j < count; j++)
+    {
+        if (shadowCasters && !m_renderables[j]->material.castsShadow) continue;
+
+        if (m_inside[j])
+        {
+            result.emplace_back(m_renderables[j]);
+            stats.visible++;
+        }
+        else
+        {
+            stats.culled++;
+        }
+    }
+    return stats;
+}
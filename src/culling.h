@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "renderable.h"
+
+// Planes of a view frustum in world space, pointing inwards: dot(plane.xyz, p) + plane.w >= 0 inside.
+class Frustum
+{
+public:
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    std::array<glm::vec4, 6> planes;
+};
+
+// Tests the world space bounding boxes of renderables against a frustum. The boxes are stored
+// as separate arrays of centers and extents, so four boxes are tested against a plane at once.
+class Culler
+{
+public:
+    struct Stats
+    {
+        size_t visible  = 0;
+        size_t culled   = 0;
+    };
+
+    // Recomputes the world space bounding boxes, call whenever renderables or transforms change.
+    void update(const std::vector<const Renderable*>& renderables);
+
+    // Appends the renderables intersecting the frustum to result, in their original order.
+    // With shadowCasters set, renderables whose material doesn't cast shadows are skipped as well.
+    Stats cull(const Frustum& frustum, std::vector<const Renderable*>& result, bool shadowCasters = false) const;
+
+    // World space box around the renderables with a valid bounding box, as of the last update.
+    const Box& bounds() const;
+
+private:
+    std::vector<const Renderable*> m_renderables;
+    Box                            m_bounds;
+
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_extentX;
+    std::vector<float> m_extentY;
+    std::vector<float> m_extentZ;
+
+    mutable std::vector<uint8_t> m_inside;
+};
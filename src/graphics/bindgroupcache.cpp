@@ -0,0 +1,107 @@
+#include "bindgroupcache.h"
+
+#include <tuple>
+
+#include "graphics/gpu.h"
+
+BindGroupCache::BindGroupCache(Gpu& gpu)
+    : m_gpu(gpu)
+{
+}
+
+BindGroupCache::~BindGroupCache()
+{
+    clear();
+}
+
+WGPUBindGroup BindGroupCache::get(WGPUBindGroupLayout layout, const WGPUBindGroupEntry* entries, size_t entryCount)
+{
+    Key key;
+    key.layout = layout;
+    key.bindings.reserve(entryCount);
+    for (size_t i = 0; i < entryCount; i++)
+    {
+        const WGPUBindGroupEntry& entry = entries[i];
+        key.bindings.emplace_back(Binding {
+            .binding     = entry.binding,
+            .buffer      = entry.buffer,
+            .offset      = entry.offset,
+            .size        = entry.size,
+            .sampler     = entry.sampler,
+            .textureView = entry.textureView
+        });
+    }
+
+    auto it = m_bindGroups.find(key);
+    if (it != m_bindGroups.end())
+        return it->second;
+
+    WGPUBindGroupDescriptor group{};
+    group.nextInChain   = nullptr;
+    group.layout        = layout;
+    group.entryCount    = entryCount;
+    group.entries       = entries;
+
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(m_gpu.m_device, &group);
+    m_bindGroups.emplace(std::move(key), bindGroup);
+    m_nrCreated++;
+
+    return bindGroup;
+}
+
+void BindGroupCache::invalidate(const void* resource)
+{
+    if (resource == nullptr) return;
+
+    for (auto it = m_bindGroups.begin(); it != m_bindGroups.end();)
+    {
+        const Key& key = it->first;
+        bool stale = key.layout == resource;
+        for (const Binding& binding : key.bindings)
+            stale = stale || binding.refersTo(resource);
+
+        if (stale)
+        {
+            wgpuBindGroupRelease(it->second);
+            it = m_bindGroups.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void BindGroupCache::clear()
+{
+    for (auto& [key, bindGroup] : m_bindGroups)
+        wgpuBindGroupRelease(bindGroup);
+
+    m_bindGroups.clear();
+}
+
+size_t BindGroupCache::size() const
+{
+    return m_bindGroups.size();
+}
+
+size_t BindGroupCache::nrCreated() const
+{
+    return m_nrCreated;
+}
+
+bool BindGroupCache::Binding::operator<(const Binding& other) const
+{
+    return std::tie(binding, buffer, offset, size, sampler, textureView) <
+        std::tie(other.binding, other.buffer, other.offset, other.size, other.sampler, other.textureView);
+}
+
+bool BindGroupCache::Binding::refersTo(const void* resource) const
+{
+    return buffer == resource || sampler == resource || textureView == resource;
+}
+
+bool BindGroupCache::Key::operator<(const Key& other) const
+{
+    return std::tie(layout, bindings) < std::tie(other.layout, other.bindings);
+}
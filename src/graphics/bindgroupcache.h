@@ -0,0 +1,65 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <array>
+#include <map>
+#include <vector>
+
+class Gpu;
+
+// Caches bind groups by layout and the buffers, samplers and texture views they bind.
+// The cache owns the bind groups, callers must not release them. Whenever one of the
+// bound resources is released or reallocated, it has to be invalidated so no bind group
+// referring to a stale (and possibly reused) handle is handed out.
+class BindGroupCache
+{
+public:
+    BindGroupCache(Gpu& gpu);
+    ~BindGroupCache();
+
+    WGPUBindGroup get(WGPUBindGroupLayout layout, const WGPUBindGroupEntry* entries, size_t entryCount);
+
+    template <size_t N>
+    WGPUBindGroup get(WGPUBindGroupLayout layout, const std::array<WGPUBindGroupEntry, N>& entries)
+    {
+        return get(layout, entries.data(), entries.size());
+    }
+
+    // Releases every bind group that refers to the resource (buffer, sampler, texture view or layout).
+    void invalidate(const void* resource);
+    void clear();
+
+    size_t size()       const;
+    size_t nrCreated()  const;
+
+private:
+    struct Binding
+    {
+        uint32_t        binding     = 0;
+        const void*     buffer      = nullptr;
+        uint64_t        offset      = 0;
+        uint64_t        size        = 0;
+        const void*     sampler     = nullptr;
+        const void*     textureView = nullptr;
+
+        bool operator<(const Binding& other) const;
+        bool refersTo(const void* resource) const;
+    };
+
+    struct Key
+    {
+        const void*             layout = nullptr;
+        std::vector<Binding>    bindings;
+
+        bool operator<(const Key& other) const;
+    };
+
+    Gpu&                            m_gpu;
+    std::map<Key, WGPUBindGroup>    m_bindGroups;
+    size_t                          m_nrCreated = 0;
+
+    BindGroupCache            (const BindGroupCache&)   = delete;
+    BindGroupCache& operator= (const BindGroupCache&)   = delete;
+
+};
@@ -0,0 +1,282 @@
+#include "computepass.h"
+#include "gpu.h"
+#include "renderpasshelpers.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const uint32_t workgroupSize = 8;
+
+    uint32_t workgroupCount(uint32_t size)
+    {
+        return (size + workgroupSize - 1) / workgroupSize;
+    }
+
+    void fillStorageTextureBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding)
+    {
+        setDefault(entry);
+        entry.binding                       = binding;
+        entry.visibility                    = WGPUShaderStage_Compute;
+        entry.storageTexture.access         = WGPUStorageTextureAccess_WriteOnly;
+        entry.storageTexture.format         = WGPUTextureFormat_RGBA8Unorm;
+        entry.storageTexture.viewDimension  = WGPUTextureViewDimension_2D;
+    }
+}
+
+ComputePass::ComputePass(Gpu& gpu)
+    : m_gpu(gpu)
+{
+    std::string shaderSource = m_gpu.compileShader("./shaders/mipmaps.wgsl");
+
+    WGPUShaderModuleDescriptor shaderDesc{};
+    #ifdef WEBGPU_BACKEND_WGPU
+        shaderDesc.hintCount = 0;
+        shaderDesc.hints = nullptr;
+    #endif
+
+    WGPUShaderModuleWGSLDescriptor shaderCodeDesc{};
+    shaderCodeDesc.chain.next = nullptr;
+    shaderCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+
+    shaderDesc.nextInChain = &shaderCodeDesc.chain;
+    shaderCodeDesc.code = shaderSource.c_str();
+    WGPUShaderModule shaderModule = wgpuDeviceCreateShaderModule(m_gpu.m_device, &shaderDesc);
+
+    createLayouts();
+
+    m_convertRGB        = createPipeline(shaderModule, m_convertLayout,    "convert_rgb",    false);
+    m_convertRGBA16     = createPipeline(shaderModule, m_convertLayout,    "convert_rgba16", false);
+    m_downsampleLinear  = createPipeline(shaderModule, m_downsampleLayout, "downsample",     false);
+    m_downsampleSrgb    = createPipeline(shaderModule, m_downsampleLayout, "downsample",     true);
+
+    wgpuShaderModuleRelease(shaderModule);
+}
+
+ComputePass::~ComputePass()
+{
+    wgpuComputePipelineRelease  (m_convertRGB);
+    wgpuComputePipelineRelease  (m_convertRGBA16);
+    wgpuComputePipelineRelease  (m_downsampleLinear);
+    wgpuComputePipelineRelease  (m_downsampleSrgb);
+    wgpuPipelineLayoutRelease   (m_convertLayout);
+    wgpuPipelineLayoutRelease   (m_downsampleLayout);
+    wgpuBindGroupLayoutRelease  (m_convertGroupLayout);
+    wgpuBindGroupLayoutRelease  (m_downsampleGroupLayout);
+}
+
+void ComputePass::createLayouts()
+{
+    std::array<WGPUBindGroupLayoutEntry, 2> convertEntries{};
+    setDefault(convertEntries[0]);
+    convertEntries[0].binding               = 0;
+    convertEntries[0].visibility            = WGPUShaderStage_Compute;
+    convertEntries[0].buffer.type           = WGPUBufferBindingType_ReadOnlyStorage;
+    convertEntries[0].buffer.minBindingSize = sizeof(uint32_t);
+    fillStorageTextureBindGroupLayoutEntry(convertEntries[1], 1);
+
+    std::array<WGPUBindGroupLayoutEntry, 2> downsampleEntries{};
+    fillTextureBindGroupLayoutEntry(downsampleEntries[0], 2);
+    downsampleEntries[0].visibility         = WGPUShaderStage_Compute;
+    downsampleEntries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+    fillStorageTextureBindGroupLayoutEntry(downsampleEntries[1], 3);
+
+    WGPUBindGroupLayoutDescriptor convertGroupLayout{};
+    convertGroupLayout.label        = "grouplayout - image conversion";
+    convertGroupLayout.entryCount   = convertEntries.size();
+    convertGroupLayout.entries      = convertEntries.data();
+    m_convertGroupLayout = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &convertGroupLayout);
+
+    WGPUBindGroupLayoutDescriptor downsampleGroupLayout{};
+    downsampleGroupLayout.label         = "grouplayout - mip level generation";
+    downsampleGroupLayout.entryCount    = downsampleEntries.size();
+    downsampleGroupLayout.entries       = downsampleEntries.data();
+    m_downsampleGroupLayout = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &downsampleGroupLayout);
+
+    WGPUPipelineLayoutDescriptor layoutDesc{};
+    layoutDesc.bindGroupLayoutCount = 1;
+    layoutDesc.bindGroupLayouts     = &m_convertGroupLayout;
+    m_convertLayout = wgpuDeviceCreatePipelineLayout(m_gpu.m_device, &layoutDesc);
+
+    layoutDesc.bindGroupLayouts     = &m_downsampleGroupLayout;
+    m_downsampleLayout = wgpuDeviceCreatePipelineLayout(m_gpu.m_device, &layoutDesc);
+}
+
+WGPUComputePipeline ComputePass::createPipeline(WGPUShaderModule module, WGPUPipelineLayout layout, const char* entryPoint, bool srgb)
+{
+    WGPUConstantEntry srgbConstant{};
+    srgbConstant.key    = "srgb";
+    srgbConstant.value  = 1.0;
+
+    WGPUComputePipelineDescriptor pipelineDesc{};
+    pipelineDesc.label                  = entryPoint;
+    pipelineDesc.layout                 = layout;
+    pipelineDesc.compute.module         = module;
+    pipelineDesc.compute.entryPoint     = entryPoint;
+    pipelineDesc.compute.constantCount  = srgb ? 1 : 0;
+    pipelineDesc.compute.constants      = srgb ? &srgbConstant : nullptr;
+
+    return wgpuDeviceCreateComputePipeline(m_gpu.m_device, &pipelineDesc);
+}
+
+WGPUTextureView ComputePass::createLevelView(WGPUTexture texture, uint32_t level, uint32_t layer) const
+{
+    WGPUTextureViewDescriptor viewDesc{};
+    viewDesc.format             = WGPUTextureFormat_RGBA8Unorm;
+    viewDesc.dimension          = WGPUTextureViewDimension_2D;
+    viewDesc.baseMipLevel       = level;
+    viewDesc.mipLevelCount      = 1;
+    viewDesc.baseArrayLayer     = layer;
+    viewDesc.arrayLayerCount    = 1;
+    viewDesc.aspect             = WGPUTextureAspect_All;
+    return wgpuTextureCreateView(texture, &viewDesc);
+}
+
+void ComputePass::writeImage(WGPUTexture texture, uint32_t layer, const Image& image)
+{
+    WGPUExtent3D    size    = { uint32_t(image.width), uint32_t(image.height), 1 };
+    UploadManager&  uploads = m_gpu.getUploadManager();
+
+    // RGBA8 pixels go straight to the texture
+    if (image.type == Image::Type::RGBA)
+    {
+        WGPUImageCopyTexture destination {};
+        destination.texture     = texture;
+        destination.mipLevel    = 0;
+        destination.origin      = { 0, 0, layer };
+        destination.aspect      = WGPUTextureAspect_All;
+
+        uploads.writeTexture(destination, image.getPixels(), 4 * size.width, size);
+        return;
+    }
+
+    if (image.type != Image::Type::RGB && image.type != Image::Type::RGBA16)
+    {
+        std::cerr << "Error: ComputePass can only convert RGB and RGBA16 images" << std::endl;
+        return;
+    }
+
+    // Other layouts are uploaded as they are and converted by the shader, buffer writes are in multiples of 4 bytes
+    size_t bytes        = size_t(image.width) * image.height * image.bytesPerPixel;
+    size_t alignedBytes = (bytes + 3) & ~size_t(3);
+
+    WGPUBufferDescriptor bufferDesc{};
+    bufferDesc.label    = "image conversion pixels";
+    bufferDesc.usage    = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage;
+    bufferDesc.size     = alignedBytes;
+    WGPUBuffer pixels = wgpuDeviceCreateBuffer(m_gpu.m_device, &bufferDesc);
+
+    uploads.writeBuffer(pixels, 0, image.getPixels(), bytes & ~size_t(3));
+    if (bytes != alignedBytes)
+    {
+        uint8_t tail[4] = {};
+        std::copy(image.getPixels() + (bytes & ~size_t(3)), image.getPixels() + bytes, tail);
+        uploads.writeBuffer(pixels, alignedBytes - 4, tail, 4);
+    }
+
+    WGPUTextureView level0 = createLevelView(texture, 0, layer);
+
+    std::array<WGPUBindGroupEntry, 2> entries{};
+    entries[0].binding      = 0;
+    entries[0].buffer       = pixels;
+    entries[0].offset       = 0;
+    entries[0].size         = alignedBytes;
+    entries[1].binding      = 1;
+    entries[1].textureView  = level0;
+
+    WGPUBindGroupDescriptor groupDesc{};
+    groupDesc.layout        = m_convertGroupLayout;
+    groupDesc.entryCount    = entries.size();
+    groupDesc.entries       = entries.data();
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(m_gpu.m_device, &groupDesc);
+
+    WGPUCommandEncoder      encoder     = m_gpu.createCommandEncoder();
+    WGPUComputePassDescriptor passDesc{};
+    passDesc.label = "image conversion";
+    WGPUComputePassEncoder  computePass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+
+    wgpuComputePassEncoderSetPipeline           (computePass, image.type == Image::Type::RGB ? m_convertRGB : m_convertRGBA16);
+    wgpuComputePassEncoderSetBindGroup          (computePass, 0, bindGroup, 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups    (computePass, workgroupCount(size.width), workgroupCount(size.height), 1);
+    wgpuComputePassEncoderEnd                   (computePass);
+    wgpuComputePassEncoderRelease               (computePass);
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor{};
+    cmdBufferDescriptor.label = "image conversion";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+    wgpuCommandEncoderRelease(encoder);
+
+    // The staged pixels are copied before the conversion reads them
+    uploads.flush();
+    wgpuQueueSubmit(m_gpu.m_queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+
+    // The submitted work keeps the resources alive
+    wgpuBindGroupRelease    (bindGroup);
+    wgpuTextureViewRelease  (level0);
+    wgpuBufferRelease       (pixels);
+}
+
+void ComputePass::generateMipMaps(WGPUTexture texture, bool srgb)
+{
+    uint32_t levels = wgpuTextureGetMipLevelCount(texture);
+    uint32_t layers = wgpuTextureGetDepthOrArrayLayers(texture);
+    if (levels < 2) return;
+
+    WGPUCommandEncoder      encoder     = m_gpu.createCommandEncoder();
+    WGPUComputePassDescriptor passDesc{};
+    passDesc.label = "mip level generation";
+    WGPUComputePassEncoder  computePass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+    wgpuComputePassEncoderSetPipeline(computePass, srgb ? m_downsampleSrgb : m_downsampleLinear);
+
+    // Every level reads the previous one, the dispatches are ordered within the pass
+    std::vector<WGPUTextureView>    views;
+    std::vector<WGPUBindGroup>      bindGroups;
+    for (uint32_t layer = 0; layer < layers; layer++)
+    {
+        for (uint32_t level = 1; level < levels; level++)
+        {
+            views.push_back(createLevelView(texture, level - 1, layer));
+            views.push_back(createLevelView(texture, level, layer));
+
+            std::array<WGPUBindGroupEntry, 2> entries{};
+            entries[0].binding      = 2;
+            entries[0].textureView  = views[views.size() - 2];
+            entries[1].binding      = 3;
+            entries[1].textureView  = views[views.size() - 1];
+
+            WGPUBindGroupDescriptor groupDesc{};
+            groupDesc.layout        = m_downsampleGroupLayout;
+            groupDesc.entryCount    = entries.size();
+            groupDesc.entries       = entries.data();
+            bindGroups.push_back(wgpuDeviceCreateBindGroup(m_gpu.m_device, &groupDesc));
+
+            uint32_t width  = std::max(1u, wgpuTextureGetWidth(texture)  >> level);
+            uint32_t height = std::max(1u, wgpuTextureGetHeight(texture) >> level);
+
+            wgpuComputePassEncoderSetBindGroup          (computePass, 0, bindGroups.back(), 0, nullptr);
+            wgpuComputePassEncoderDispatchWorkgroups    (computePass, workgroupCount(width), workgroupCount(height), 1);
+        }
+    }
+
+    wgpuComputePassEncoderEnd       (computePass);
+    wgpuComputePassEncoderRelease   (computePass);
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor{};
+    cmdBufferDescriptor.label = "mip level generation";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+    wgpuCommandEncoderRelease(encoder);
+
+    // The levels are generated from uploads that may still be recorded
+    m_gpu.getUploadManager().flush();
+    wgpuQueueSubmit(m_gpu.m_queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+
+    for (WGPUBindGroup bindGroup: bindGroups)
+        wgpuBindGroupRelease(bindGroup);
+    for (WGPUTextureView view: views)
+        wgpuTextureViewRelease(view);
+}
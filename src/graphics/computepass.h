@@ -0,0 +1,44 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "image.h"
+
+class Gpu;
+
+// Processes images in textures with the compute shaders of mipmaps.wgsl. Only mip level 0 is uploaded, RGB and
+// 16-bit RGBA pixels are converted to RGBA8 and the other levels are generated from it on the GPU. Textures have
+// to be RGBA8 unorm with storage binding usage, sRGB textures are processed through an RGBA8 unorm view.
+class ComputePass
+{
+public:
+    ComputePass(Gpu& gpu);
+    ~ComputePass();
+
+    // Writes image to mip level 0 of layer
+    void writeImage(WGPUTexture texture, uint32_t layer, const Image& image);
+
+    // Fills the other mip levels of all layers from level 0, srgb averages the color channels in linear space
+    void generateMipMaps(WGPUTexture texture, bool srgb);
+
+private:
+    Gpu&                    m_gpu;
+
+    WGPUBindGroupLayout     m_convertGroupLayout        = nullptr;
+    WGPUBindGroupLayout     m_downsampleGroupLayout     = nullptr;
+    WGPUPipelineLayout      m_convertLayout             = nullptr;
+    WGPUPipelineLayout      m_downsampleLayout          = nullptr;
+
+    WGPUComputePipeline     m_convertRGB                = nullptr;
+    WGPUComputePipeline     m_convertRGBA16             = nullptr;
+    WGPUComputePipeline     m_downsampleLinear          = nullptr;
+    WGPUComputePipeline     m_downsampleSrgb            = nullptr;
+
+    void                createLayouts   ();
+    WGPUComputePipeline createPipeline  (WGPUShaderModule module, WGPUPipelineLayout layout, const char* entryPoint, bool srgb);
+
+    WGPUTextureView     createLevelView (WGPUTexture texture, uint32_t level, uint32_t layer) const;
+
+    ComputePass             (const ComputePass&) = delete;
+    ComputePass& operator=  (const ComputePass&) = delete;
+};
@@ -0,0 +1,75 @@
+#include "drawlist.h"
+
+#include "graphics/vertexbuffer.h"
+
+void DrawList::clear()
+{
+    m_batchIndices  .clear();
+    m_items         .clear();
+    m_batches       .clear();
+    m_instances     .clear();
+}
+
+void DrawList::add(const Renderable* renderable, VertexBuffer* vertexBuffer, WGPUBindGroup material, int lod)
+{
+    if (vertexBuffer->getMesh().indices().empty()) return; // Nothing to draw
+
+    auto [it, inserted] = m_batchIndices.emplace(Key(vertexBuffer, material, lod), m_batches.size());
+    if (inserted)
+    {
+        const VertexBuffer::IndexRange& range = vertexBuffer->lod(lod);
+        m_batches.emplace_back(Batch
+        {
+            .vertexBuffer   = vertexBuffer,
+            .material       = material,
+            .firstIndex     = range.firstIndex,
+            .indexCount     = range.indexCount
+        });
+    }
+
+    m_batches[it->second].instanceCount++;
+    m_items.emplace_back(it->second, renderable);
+}
+
+void DrawList::build()
+{
+    uint32_t firstInstance = 0;
+    for (Batch& batch : m_batches)
+    {
+        batch.firstInstance = firstInstance;
+        firstInstance      += batch.instanceCount;
+    }
+
+    std::vector<uint32_t> nextInstance(m_batches.size());
+    for (size_t i = 0; i < m_batches.size(); i++)
+        nextInstance[i] = m_batches[i].firstInstance;
+
+    m_instances.resize(m_items.size());
+    for (const auto& [batchIndex, renderable] : m_items)
+        m_instances[nextInstance[batchIndex]++] = renderable;
+}
+
+const std::vector<DrawList::Batch>& DrawList::batches() const
+{
+    return m_batches;
+}
+
+const std::vector<const Renderable*>& DrawList::instances() const
+{
+    return m_instances;
+}
+
+void DrawList::appendSignature(std::vector<uint64_t>& signature) const
+{
+    signature.reserve(signature.size() + m_batches.size() * 7);
+    for (const Batch& batch : m_batches)
+    {
+        signature.push_back(reinterpret_cast<uint64_t>(batch.vertexBuffer->m_vertexBuffer));
+        signature.push_back(reinterpret_cast<uint64_t>(batch.vertexBuffer->m_indexBuffer));
+        signature.push_back(batch.firstIndex);
+        signature.push_back(batch.indexCount);
+        signature.push_back(reinterpret_cast<uint64_t>(batch.material));
+        signature.push_back(batch.firstInstance);
+        signature.push_back(batch.instanceCount);
+    }
+}
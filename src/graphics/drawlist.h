@@ -0,0 +1,49 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "renderable.h"
+
+class VertexBuffer;
+
+// Groups renderables that share a vertex buffer, level of detail and material into batches, so
+// each batch can be drawn with a single instanced draw call. The instances of a batch are stored
+// contiguously, firstInstance is the index of the first one in instances().
+class DrawList
+{
+public:
+    struct Batch
+    {
+        VertexBuffer*   vertexBuffer    = nullptr;
+        WGPUBindGroup   material        = nullptr;
+        uint32_t        firstIndex      = 0;
+        uint32_t        indexCount      = 0;
+        uint32_t        firstInstance   = 0;
+        uint32_t        instanceCount   = 0;
+    };
+
+    void clear();
+    void add(const Renderable* renderable, VertexBuffer* vertexBuffer, WGPUBindGroup material = nullptr, int lod = 0);
+
+    // Orders the added renderables by batch, in the order in which the batches were first added.
+    void build();
+
+    const std::vector<Batch>&               batches()   const;
+    const std::vector<const Renderable*>&   instances() const;
+
+    // Appends everything that ends up in the recorded draw calls of the batches, so a
+    // recorded draw stream can be reused as long as the signature stays the same.
+    void appendSignature(std::vector<uint64_t>& signature) const;
+
+private:
+    using Key = std::tuple<VertexBuffer*, WGPUBindGroup, int>;
+
+    std::map<Key, size_t>                               m_batchIndices;
+    std::vector<std::pair<size_t, const Renderable*>>   m_items;
+
+    std::vector<Batch>                                  m_batches;
+    std::vector<const Renderable*>                      m_instances;
+};
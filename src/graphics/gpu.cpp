@@ -2,17 +2,27 @@
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <algorithm>
 #include <fstream>
 
 #include "wgpu-utils.h"
 #include "mesh.h"
+#include "uniformsdata.h"
 
 Gpu::Gpu()
-    : m_resourcePool(std::make_unique<ResourcePool>(*this))
+    : Gpu(Params())
+{
+}
+
+Gpu::Gpu(const Params& params)
+    : m_vertexFormat    (params.vertexFormat)
+    , m_resourcePool    (std::make_unique<ResourcePool>(*this))
+    , m_bindGroupCache  (std::make_unique<BindGroupCache>(*this))
+    , m_uploadManager   (std::make_unique<UploadManager>(*this))
 {
     m_instance = createInstance();
     std::cout << "WGPU instance: " << m_instance << std::endl;
-    m_adapter = createAdapter();
+    m_adapter = createAdapter(params);
     std::cout << "Found adapter: " << m_adapter << std::endl;
     wgpuInstanceRelease(m_instance);
 
@@ -28,13 +38,17 @@ Gpu::Gpu()
 
     m_linearSampler = createLinearSampler(m_device);
     m_depthSampler  = createDepthSampler(m_device);
-    m_nearestSampler = createNearestSampler(m_device);
+    m_momentSampler = createMomentSampler(m_device);
 }
 
 Gpu::~Gpu()
 {
-    m_resourcePool = nullptr;
+    m_resourcePool   = nullptr;
+    m_bindGroupCache = nullptr;
+    m_computePass    = nullptr;
+    m_uploadManager  = nullptr;
     wgpuSamplerRelease(m_linearSampler);
+    wgpuSamplerRelease(m_momentSampler);
     wgpuQueueRelease(m_queue);
     wgpuAdapterRelease(m_adapter);
     wgpuDeviceRelease(m_device);
@@ -45,6 +59,23 @@ ResourcePool& Gpu::getResourcePool()
     return *m_resourcePool;
 }
 
+BindGroupCache& Gpu::getBindGroupCache()
+{
+    return *m_bindGroupCache;
+}
+
+UploadManager& Gpu::getUploadManager()
+{
+    return *m_uploadManager;
+}
+
+ComputePass& Gpu::getComputePass()
+{
+    if (!m_computePass)
+        m_computePass = std::make_unique<ComputePass>(*this);
+    return *m_computePass;
+}
+
 std::string Gpu::compileShader(const std::string& filepath)
 {
     std::string result;
@@ -80,6 +111,7 @@ uint32_t Gpu::uniformStride(uint32_t uniformSize) const
 void Gpu::beginRenderJob()
 {
     m_currentCommandEncoder = createCommandEncoder();
+    m_uploadManager->beginFrame();
 }
 
 void Gpu::submitRenderJob()
@@ -89,15 +121,25 @@ void Gpu::submitRenderJob()
     cmdBufferDescriptor.label       = "Command buffer";
     WGPUCommandBuffer command = wgpuCommandEncoderFinish(m_currentCommandEncoder, &cmdBufferDescriptor);
     wgpuCommandEncoderRelease(m_currentCommandEncoder);
+
+    // The uploads recorded while the frame was drawn go first
+    m_uploadManager->flush();
     wgpuQueueSubmit(m_queue, 1, &command);
     wgpuCommandBufferRelease(command);
 
+    processEvents();
+    m_currentCommandEncoder = nullptr;
+}
+
+void Gpu::processEvents()
+{
     #if defined(WEBGPU_BACKEND_DAWN)
         wgpuDeviceTick(m_device);
     #elif defined(WEBGPU_BACKEND_WGPU)
-        wgpuDevicePoll(device, false, nullptr);
+        wgpuDevicePoll(m_device, false, nullptr);
+    #elif defined(__EMSCRIPTEN__)
+        emscripten_sleep(0);
     #endif
-    m_currentCommandEncoder = nullptr;
 }
 
 WGPUInstance Gpu::getInstance()
@@ -140,23 +182,24 @@ WGPUSampler Gpu::createDepthSampler(WGPUDevice device)
     return sampler;
 }
 
-WGPUSampler Gpu::createNearestSampler(WGPUDevice device)
+WGPUSampler Gpu::createMomentSampler(WGPUDevice device)
 {
+    // Shadow moments are filtered like colors, but don't repeat past the edge of a cascade
     WGPUSamplerDescriptor samplerDesc{};
     samplerDesc.nextInChain = nullptr;
-    samplerDesc.label = "nearestSampler";
-    samplerDesc.addressModeU = WGPUAddressMode_Repeat;
-    samplerDesc.addressModeV = WGPUAddressMode_Repeat;
-    samplerDesc.addressModeW = WGPUAddressMode_Repeat;
-    samplerDesc.magFilter = WGPUFilterMode_Nearest;
-    samplerDesc.minFilter = WGPUFilterMode_Nearest;
-    samplerDesc.mipmapFilter = WGPUMipmapFilterMode_Nearest;
+    samplerDesc.label = "shadow moment sampler";
+    samplerDesc.addressModeU = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
+    samplerDesc.magFilter = WGPUFilterMode_Linear;
+    samplerDesc.minFilter = WGPUFilterMode_Linear;
+    samplerDesc.mipmapFilter = WGPUMipmapFilterMode_Linear;
     samplerDesc.compare = WGPUCompareFunction_Undefined;
     samplerDesc.lodMinClamp = 0;
     samplerDesc.lodMaxClamp = FLT_MAX;
     samplerDesc.maxAnisotropy = 1;
-    WGPUSampler linearSampler = wgpuDeviceCreateSampler(m_device, &samplerDesc);
-    return linearSampler;
+    WGPUSampler sampler = wgpuDeviceCreateSampler(m_device, &samplerDesc);
+    return sampler;
 }
 
 void Gpu::enumerateDeviceFeatures(WGPUDevice device)
@@ -193,6 +236,16 @@ void Gpu::enumerateDeviceFeatures(WGPUDevice device)
     }
 }
 
+bool Gpu::hasFeature(WGPUFeatureName feature) const
+{
+    return std::find(m_features.begin(), m_features.end(), feature) != m_features.end();
+}
+
+uint32_t Gpu::maxTextureDimension() const
+{
+    return m_requiredLimits.limits.maxTextureDimension2D;
+}
+
 WGPUCommandEncoder Gpu::createCommandEncoder()
 {
     WGPUCommandEncoderDescriptor encoderDesc;
@@ -206,10 +259,19 @@ WGPUDevice Gpu::createDevice(WGPUAdapter adapter)
 {
     m_requiredLimits = getRequiredLimits(adapter);
 
+    // Compressed texture formats are used when available, images are decompressed otherwise
+    m_features.clear();
+    for (WGPUFeatureName feature : { WGPUFeatureName_TextureCompressionBC, WGPUFeatureName_TextureCompressionETC2, WGPUFeatureName_TextureCompressionASTC })
+    {
+        if (wgpuAdapterHasFeature(adapter, feature))
+            m_features.push_back(feature);
+    }
+
     WGPUDeviceDescriptor deviceDesc = {};
     deviceDesc.nextInChain = nullptr;
     deviceDesc.label = "Video device";
-    deviceDesc.requiredFeatureCount = 0; // we do not require any specific feature
+    deviceDesc.requiredFeatureCount = m_features.size();
+    deviceDesc.requiredFeatures = m_features.data();
     deviceDesc.requiredLimits = &m_requiredLimits; // we do not require any specific limit
     deviceDesc.defaultQueue.nextInChain = nullptr;
     deviceDesc.defaultQueue.label = "Default queue";
@@ -391,11 +453,13 @@ WGPUAdapter Gpu::requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOpt
     return userData.adapter;
 }
 
-WGPUAdapter Gpu::createAdapter()
+WGPUAdapter Gpu::createAdapter(const Params& params)
 {
     WGPURequestAdapterOptions adapterOpts = {};
-    adapterOpts.nextInChain     = nullptr;
-    adapterOpts.powerPreference = WGPUPowerPreference_HighPerformance;
+    adapterOpts.nextInChain             = nullptr;
+    adapterOpts.powerPreference         = WGPUPowerPreference_HighPerformance;
+    adapterOpts.backendType             = params.backendType;
+    adapterOpts.forceFallbackAdapter    = params.forceFallbackAdapter;
     WGPUAdapter adapter         = requestAdapterSync(m_instance, &adapterOpts);
     return adapter;
 }
@@ -448,14 +512,16 @@ WGPURequiredLimits Gpu::getRequiredLimits(WGPUAdapter adapter) const
     requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
     requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
 
-    requiredLimits.limits.maxBindGroups                     = 2;
+    requiredLimits.limits.maxBindGroups                     = 3;
     requiredLimits.limits.maxUniformBuffersPerShaderStage   = 1;
-    requiredLimits.limits.maxUniformBufferBindingSize       = sizeof(float) * 53;
-    requiredLimits.limits.maxDynamicUniformBuffersPerPipelineLayout = 2;
-
-    requiredLimits.limits.maxTextureDimension1D = 2048;
-    requiredLimits.limits.maxTextureDimension2D = 2048;
-    requiredLimits.limits.maxTextureArrayLayers = 1;
+    requiredLimits.limits.maxUniformBufferBindingSize       = sizeof(FrameData);
+    requiredLimits.limits.maxStorageBuffersPerShaderStage   = 1;
+    requiredLimits.limits.maxStorageBufferBindingSize       = supportedLimits.limits.maxStorageBufferBindingSize;
+
+    // Streamed textures start at the first mip level that fits, larger sources aren't rejected
+    requiredLimits.limits.maxTextureDimension1D = supportedLimits.limits.maxTextureDimension1D;
+    requiredLimits.limits.maxTextureDimension2D = supportedLimits.limits.maxTextureDimension2D;
+    requiredLimits.limits.maxTextureArrayLayers = std::max(6, maxShadowCascades);     // Cubemaps and shadow cascades
     requiredLimits.limits.maxSamplersPerShaderStage = 1;
 
     return requiredLimits;
@@ -2,46 +2,92 @@
 
 #include <webgpu/webgpu.h>
 #include <string>
+#include <vector>
 
 #include "resourcepool.h"
+#include "bindgroupcache.h"
+#include "computepass.h"
+#include "uploadmanager.h"
 
 class Gpu
 {
 friend class WindowTarget;
+friend class OffscreenTarget;
 friend class RenderPass;
 friend class ShadowPass;
 friend class VertexBuffer;
 friend class Texture;
+friend class BindGroupCache;
+friend class RenderBundle;
+friend class ComputePass;
+friend class MomentPass;
+friend class UploadManager;
 template <typename T>
 friend class Uniforms;
+template <typename T>
+friend class StorageBuffer;
 
 public:
+    struct Params
+    {
+        // Dawn's null backend or a forced fallback (SwiftShader) adapter allow running without a GPU.
+        WGPUBackendType backendType             = WGPUBackendType_Undefined;
+        bool            forceFallbackAdapter    = false;
+
+        // Vertex buffers store quantized vertices, the full layout remains as a fallback
+        VertexBuffer::Format vertexFormat       = VertexBuffer::Format::Packed;
+    };
+
     Gpu();
+    Gpu(const Params& params);
     ~Gpu();
 
-    ResourcePool& getResourcePool();
+    ResourcePool&   getResourcePool();
+    BindGroupCache& getBindGroupCache();
+
+    // Image conversion and mip generation on the GPU, created on first use
+    ComputePass&    getComputePass();
+
+    // Staged uploads to buffers and textures, submitted before the commands of a render job
+    UploadManager&  getUploadManager();
 
     std::string compileShader(const std::string& file);
 
     uint32_t uniformStride(uint32_t uniformSize) const;
 
+    // Whether the device was created with the feature, for example one of the compressed texture formats
+    bool hasFeature(WGPUFeatureName feature) const;
+
+    // Largest width and height of 2D textures on the device
+    uint32_t maxTextureDimension() const;
+
     void beginRenderJob();
     void submitRenderJob();
 
+    // Lets the device process pending work and invoke callbacks, for example of buffer mappings.
+    void processEvents();
+
 private:
     WGPUInstance        m_instance;
     WGPUDevice          m_device;
     WGPUAdapter         m_adapter;
     WGPUQueue           m_queue;
     WGPURequiredLimits  m_requiredLimits{};
+
+    std::vector<WGPUFeatureName> m_features;
+
+    VertexBuffer::Format m_vertexFormat;
     
     WGPUSampler         m_linearSampler;
-    WGPUSampler         m_nearestSampler;
+    WGPUSampler         m_momentSampler;
     WGPUSampler         m_depthSampler;
 
     WGPUCommandEncoder m_currentCommandEncoder = nullptr;
 
-    std::unique_ptr<ResourcePool> m_resourcePool;
+    std::unique_ptr<ResourcePool>   m_resourcePool;
+    std::unique_ptr<BindGroupCache> m_bindGroupCache;
+    std::unique_ptr<ComputePass>    m_computePass;
+    std::unique_ptr<UploadManager>  m_uploadManager;
 
     WGPUCommandEncoder createCommandEncoder();
 
@@ -50,7 +96,7 @@ private:
     
     WGPUSampler createLinearSampler(WGPUDevice device);
     WGPUSampler createDepthSampler(WGPUDevice device);
-    WGPUSampler createNearestSampler(WGPUDevice device);
+    WGPUSampler createMomentSampler(WGPUDevice device);
     
     void        enumerateDeviceFeatures     (WGPUDevice device);
     void        enumerateAdapterProperties  (WGPUAdapter adapter);
@@ -59,7 +105,7 @@ private:
 
     WGPUDevice      requestDeviceSync   (WGPUAdapter adapter, WGPUDeviceDescriptor const *descriptor);
     WGPUAdapter     requestAdapterSync  (WGPUInstance instance, WGPURequestAdapterOptions const *options);
-    WGPUAdapter     createAdapter();
+    WGPUAdapter     createAdapter(const Params& params);
     WGPUInstance    createInstance();
 
     WGPURequiredLimits getRequiredLimits(WGPUAdapter adapter) const;
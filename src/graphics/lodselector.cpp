@@ -0,0 +1,70 @@
+#include "lodselector.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace glm;
+
+LodSelector::LodSelector(float tolerance, float hysteresis)
+    : m_tolerance   (tolerance)
+    , m_hysteresis  (hysteresis)
+{
+}
+
+void LodSelector::begin(const mat4& view, const mat4& projection, float viewportHeight)
+{
+    m_view              = view;
+    m_projection        = projection;
+    m_viewportHeight    = viewportHeight;
+
+    std::swap(m_previousLevels, m_levels);
+    m_levels.clear();
+}
+
+int LodSelector::select(const Renderable& renderable)
+{
+    const Mesh& mesh = renderable.mesh;
+    if (mesh.lods().empty()) return 0;
+
+    float projectedRadius = this->projectedRadius(renderable);
+    if (std::isinf(projectedRadius)) return 0;
+
+    float radius = length(mesh.boundingBox.max - mesh.boundingBox.min) * 0.5f;
+
+    auto previous   = m_previousLevels.find(&renderable);
+    int  lastLevel  = previous != m_previousLevels.end() ? previous->second : INT_MAX;
+
+    int level = 0;
+    for (int i = 1; i <= int(mesh.lods().size()); i++)
+    {
+        float errorPixels   = mesh.lods()[i - 1].error / radius * projectedRadius;
+        float limit         = i <= lastLevel ? m_tolerance : m_tolerance * (1.0f - m_hysteresis);
+        if (errorPixels > limit) break;
+        level = i;
+    }
+
+    m_levels[&renderable] = level;
+    return level;
+}
+
+float LodSelector::projectedRadius(const Renderable& renderable) const
+{
+    const Box& box = renderable.mesh.boundingBox;
+    if (!all(lessThanEqual(box.min, box.max))) return INFINITY;
+
+    float radius = length(box.max - box.min) * 0.5f;
+    if (radius <= 0.0f) return INFINITY;
+
+    const mat4& toRoot      = renderable.object->getSpace().toRoot;
+    float       scale       = std::max({ length(vec3(toRoot[0])), length(vec3(toRoot[1])), length(vec3(toRoot[2])) });
+    vec4        clipCenter  = m_projection * m_view * toRoot * vec4(box.center(), 1.0f);
+
+    // With a perspective projection w is the distance along the view direction, orthographic projections keep it 1
+    // and have no camera to be too close to
+    bool  perspective   = m_projection[3][3] == 0.0f;
+    float distance      = clipCenter.w;
+    if (perspective && distance <= radius * scale) return INFINITY;
+
+    return radius * scale * m_projection[1][1] * 0.5f * m_viewportHeight / distance;
+}
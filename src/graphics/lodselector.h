@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+
+#include "renderable.h"
+
+// Picks the level of detail of renderables from the size of their bounding sphere on screen: the coarsest level
+// whose simplification error stays below tolerance pixels. A renderable only moves to a coarser level than the one
+// it had in the previous frame when the error is below tolerance * (1 - hysteresis), so it doesn't alternate
+// between two levels around the threshold.
+class LodSelector
+{
+public:
+    LodSelector(float tolerance, float hysteresis = 0.25f);
+
+    // Starts a frame rendered with view and projection to a target of viewportHeight pixels
+    void begin(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+
+    // Returns the level for renderable, 0 is the full mesh
+    int select(const Renderable& renderable);
+
+    // Radius in pixels of the bounding sphere of renderable on screen, infinite when it is too close to tell
+    float projectedRadius(const Renderable& renderable) const;
+
+private:
+    float       m_tolerance;
+    float       m_hysteresis;
+
+    glm::mat4   m_view              = glm::mat4(1.0f);
+    glm::mat4   m_projection        = glm::mat4(1.0f);
+    float       m_viewportHeight    = 1.0f;
+
+    // Levels selected in the previous and the current frame, renderables that weren't drawn are forgotten
+    std::unordered_map<const Renderable*, int> m_previousLevels;
+    std::unordered_map<const Renderable*, int> m_levels;
+};
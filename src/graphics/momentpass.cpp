@@ -0,0 +1,205 @@
+#include "momentpass.h"
+#include "gpu.h"
+#include "renderpasshelpers.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace
+{
+    const uint32_t workgroupSize = 8;
+
+    uint32_t workgroupCount(uint32_t size)
+    {
+        return (size + workgroupSize - 1) / workgroupSize;
+    }
+
+    void fillStorageTextureBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding)
+    {
+        setDefault(entry);
+        entry.binding                       = binding;
+        entry.visibility                    = WGPUShaderStage_Compute;
+        entry.storageTexture.access         = WGPUStorageTextureAccess_WriteOnly;
+        entry.storageTexture.format         = WGPUTextureFormat_RGBA16Float;
+        entry.storageTexture.viewDimension  = WGPUTextureViewDimension_2D;
+    }
+}
+
+MomentPass::MomentPass(Gpu& gpu)
+    : m_gpu         (gpu)
+    , m_horizontal  (gpu, Texture::Params{ .format = Texture::Format::RGBA16F, .usage = Texture::Usage::StorageAndBinding })
+{
+    std::string shaderSource = m_gpu.compileShader("./shaders/shadowmoments.wgsl");
+
+    WGPUShaderModuleDescriptor shaderDesc{};
+    #ifdef WEBGPU_BACKEND_WGPU
+        shaderDesc.hintCount = 0;
+        shaderDesc.hints = nullptr;
+    #endif
+
+    WGPUShaderModuleWGSLDescriptor shaderCodeDesc{};
+    shaderCodeDesc.chain.next = nullptr;
+    shaderCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+
+    shaderDesc.nextInChain = &shaderCodeDesc.chain;
+    shaderCodeDesc.code = shaderSource.c_str();
+    WGPUShaderModule shaderModule = wgpuDeviceCreateShaderModule(m_gpu.m_device, &shaderDesc);
+
+    createLayouts();
+
+    m_blurHorizontal    = createPipeline(shaderModule, m_horizontalLayout, "blur_horizontal");
+    m_blurVertical      = createPipeline(shaderModule, m_verticalLayout,   "blur_vertical");
+    m_downsample        = createPipeline(shaderModule, m_downsampleLayout, "downsample");
+
+    wgpuShaderModuleRelease(shaderModule);
+}
+
+MomentPass::~MomentPass()
+{
+    wgpuComputePipelineRelease  (m_blurHorizontal);
+    wgpuComputePipelineRelease  (m_blurVertical);
+    wgpuComputePipelineRelease  (m_downsample);
+    wgpuPipelineLayoutRelease   (m_horizontalLayout);
+    wgpuPipelineLayoutRelease   (m_verticalLayout);
+    wgpuPipelineLayoutRelease   (m_downsampleLayout);
+    wgpuBindGroupLayoutRelease  (m_horizontalGroupLayout);
+    wgpuBindGroupLayoutRelease  (m_verticalGroupLayout);
+    wgpuBindGroupLayoutRelease  (m_downsampleGroupLayout);
+}
+
+void MomentPass::createLayouts()
+{
+    std::array<WGPUBindGroupLayoutEntry, 2> horizontalEntries{};
+    fillDepthTextureBindGroupLayoutEntry(horizontalEntries[0], 0);
+    horizontalEntries[0].visibility         = WGPUShaderStage_Compute;
+    fillStorageTextureBindGroupLayoutEntry(horizontalEntries[1], 1);
+
+    // The moments are read with textureLoad, like the levels of ComputePass
+    std::array<WGPUBindGroupLayoutEntry, 2> verticalEntries{};
+    fillTextureBindGroupLayoutEntry(verticalEntries[0], 2);
+    verticalEntries[0].visibility           = WGPUShaderStage_Compute;
+    verticalEntries[0].texture.sampleType   = WGPUTextureSampleType_UnfilterableFloat;
+    fillStorageTextureBindGroupLayoutEntry(verticalEntries[1], 3);
+
+    std::array<WGPUBindGroupLayoutEntry, 2> downsampleEntries{};
+    fillTextureBindGroupLayoutEntry(downsampleEntries[0], 4);
+    downsampleEntries[0].visibility         = WGPUShaderStage_Compute;
+    downsampleEntries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+    fillStorageTextureBindGroupLayoutEntry(downsampleEntries[1], 5);
+
+    WGPUBindGroupLayoutDescriptor groupLayout{};
+    groupLayout.label       = "grouplayout - horizontal moment blur";
+    groupLayout.entryCount  = horizontalEntries.size();
+    groupLayout.entries     = horizontalEntries.data();
+    m_horizontalGroupLayout = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayout);
+
+    groupLayout.label       = "grouplayout - vertical moment blur";
+    groupLayout.entryCount  = verticalEntries.size();
+    groupLayout.entries     = verticalEntries.data();
+    m_verticalGroupLayout   = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayout);
+
+    groupLayout.label       = "grouplayout - moment mip levels";
+    groupLayout.entryCount  = downsampleEntries.size();
+    groupLayout.entries     = downsampleEntries.data();
+    m_downsampleGroupLayout = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayout);
+
+    WGPUPipelineLayoutDescriptor layoutDesc{};
+    layoutDesc.bindGroupLayoutCount = 1;
+    layoutDesc.bindGroupLayouts     = &m_horizontalGroupLayout;
+    m_horizontalLayout = wgpuDeviceCreatePipelineLayout(m_gpu.m_device, &layoutDesc);
+
+    layoutDesc.bindGroupLayouts     = &m_verticalGroupLayout;
+    m_verticalLayout = wgpuDeviceCreatePipelineLayout(m_gpu.m_device, &layoutDesc);
+
+    layoutDesc.bindGroupLayouts     = &m_downsampleGroupLayout;
+    m_downsampleLayout = wgpuDeviceCreatePipelineLayout(m_gpu.m_device, &layoutDesc);
+}
+
+WGPUComputePipeline MomentPass::createPipeline(WGPUShaderModule module, WGPUPipelineLayout layout, const char* entryPoint)
+{
+    WGPUComputePipelineDescriptor pipelineDesc{};
+    pipelineDesc.label                  = entryPoint;
+    pipelineDesc.layout                 = layout;
+    pipelineDesc.compute.module         = module;
+    pipelineDesc.compute.entryPoint     = entryPoint;
+
+    return wgpuDeviceCreateComputePipeline(m_gpu.m_device, &pipelineDesc);
+}
+
+WGPUTextureView MomentPass::createLevelView(WGPUTexture texture, uint32_t level, uint32_t layer) const
+{
+    WGPUTextureViewDescriptor viewDesc{};
+    viewDesc.format             = WGPUTextureFormat_RGBA16Float;
+    viewDesc.dimension          = WGPUTextureViewDimension_2D;
+    viewDesc.baseMipLevel       = level;
+    viewDesc.mipLevelCount      = 1;
+    viewDesc.baseArrayLayer     = layer;
+    viewDesc.arrayLayerCount    = 1;
+    viewDesc.aspect             = WGPUTextureAspect_All;
+    return wgpuTextureCreateView(texture, &viewDesc);
+}
+
+WGPUBindGroup MomentPass::createBindGroup(WGPUBindGroupLayout layout, uint32_t binding, WGPUTextureView source, WGPUTextureView destination) const
+{
+    std::array<WGPUBindGroupEntry, 2> entries{};
+    entries[0].binding      = binding;
+    entries[0].textureView  = source;
+    entries[1].binding      = binding + 1;
+    entries[1].textureView  = destination;
+
+    WGPUBindGroupDescriptor groupDesc{};
+    groupDesc.layout        = layout;
+    groupDesc.entryCount    = entries.size();
+    groupDesc.entries       = entries.data();
+    return wgpuDeviceCreateBindGroup(m_gpu.m_device, &groupDesc);
+}
+
+void MomentPass::record(WGPUCommandEncoder encoder, WGPUTextureView depthLayer, WGPUTexture moments, uint32_t layer)
+{
+    uint32_t width  = wgpuTextureGetWidth(moments);
+    uint32_t height = wgpuTextureGetHeight(moments);
+    uint32_t levels = wgpuTextureGetMipLevelCount(moments);
+    m_horizontal.setSize(glm::vec2(width, height));
+
+    WGPUComputePassDescriptor passDesc{};
+    passDesc.label = "shadow moments";
+    WGPUComputePassEncoder computePass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+
+    // Every dispatch reads what the previous one wrote, they are ordered within the pass
+    std::vector<WGPUTextureView>    views;
+    std::vector<WGPUBindGroup>      bindGroups;
+    for (uint32_t level = 0; level < levels; level++)
+        views.push_back(createLevelView(moments, level, layer));
+
+    bindGroups.push_back(createBindGroup(m_horizontalGroupLayout, 0, depthLayer, m_horizontal.getTextureView()));
+    wgpuComputePassEncoderSetPipeline           (computePass, m_blurHorizontal);
+    wgpuComputePassEncoderSetBindGroup          (computePass, 0, bindGroups.back(), 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups    (computePass, workgroupCount(width), workgroupCount(height), 1);
+
+    bindGroups.push_back(createBindGroup(m_verticalGroupLayout, 2, m_horizontal.getTextureView(), views[0]));
+    wgpuComputePassEncoderSetPipeline           (computePass, m_blurVertical);
+    wgpuComputePassEncoderSetBindGroup          (computePass, 0, bindGroups.back(), 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups    (computePass, workgroupCount(width), workgroupCount(height), 1);
+
+    wgpuComputePassEncoderSetPipeline(computePass, m_downsample);
+    for (uint32_t level = 1; level < levels; level++)
+    {
+        bindGroups.push_back(createBindGroup(m_downsampleGroupLayout, 4, views[level - 1], views[level]));
+
+        uint32_t levelWidth  = std::max(1u, width  >> level);
+        uint32_t levelHeight = std::max(1u, height >> level);
+
+        wgpuComputePassEncoderSetBindGroup          (computePass, 0, bindGroups.back(), 0, nullptr);
+        wgpuComputePassEncoderDispatchWorkgroups    (computePass, workgroupCount(levelWidth), workgroupCount(levelHeight), 1);
+    }
+
+    wgpuComputePassEncoderEnd       (computePass);
+    wgpuComputePassEncoderRelease   (computePass);
+
+    // The recorded commands keep the resources alive
+    for (WGPUBindGroup bindGroup: bindGroups)
+        wgpuBindGroupRelease(bindGroup);
+    for (WGPUTextureView view: views)
+        wgpuTextureViewRelease(view);
+}
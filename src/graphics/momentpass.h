@@ -0,0 +1,50 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "texture.h"
+
+class Gpu;
+
+// Prefilters shadow maps with the compute shaders of shadowmoments.wgsl. A depth layer is converted to exponential
+// variance moments at half its resolution, blurred with a separable gaussian and averaged into the mip levels, so
+// soft shadows take a single filtered sample however wide the penumbra is.
+class MomentPass
+{
+public:
+    MomentPass(Gpu& gpu);
+    ~MomentPass();
+
+    // Mip levels of moment textures, the coarsest ones blur more than shadows get wide
+    static const uint32_t mipLevelCount = 6;
+
+    // Records the filtering of depthLayer into layer of moments, an RGBA16 float array texture with storage binding
+    // usage of half the size of the depth
+    void record(WGPUCommandEncoder encoder, WGPUTextureView depthLayer, WGPUTexture moments, uint32_t layer);
+
+private:
+    Gpu&                    m_gpu;
+
+    // Horizontally blurred moments, read by the vertical blur
+    Texture                 m_horizontal;
+
+    WGPUBindGroupLayout     m_horizontalGroupLayout     = nullptr;
+    WGPUBindGroupLayout     m_verticalGroupLayout       = nullptr;
+    WGPUBindGroupLayout     m_downsampleGroupLayout     = nullptr;
+    WGPUPipelineLayout      m_horizontalLayout          = nullptr;
+    WGPUPipelineLayout      m_verticalLayout            = nullptr;
+    WGPUPipelineLayout      m_downsampleLayout          = nullptr;
+
+    WGPUComputePipeline     m_blurHorizontal            = nullptr;
+    WGPUComputePipeline     m_blurVertical              = nullptr;
+    WGPUComputePipeline     m_downsample                = nullptr;
+
+    void                createLayouts   ();
+    WGPUComputePipeline createPipeline  (WGPUShaderModule module, WGPUPipelineLayout layout, const char* entryPoint);
+
+    WGPUTextureView     createLevelView (WGPUTexture texture, uint32_t level, uint32_t layer) const;
+    WGPUBindGroup       createBindGroup (WGPUBindGroupLayout layout, uint32_t binding, WGPUTextureView source, WGPUTextureView destination) const;
+
+    MomentPass              (const MomentPass&) = delete;
+    MomentPass& operator=   (const MomentPass&) = delete;
+};
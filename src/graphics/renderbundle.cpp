@@ -0,0 +1,56 @@
+#include "renderbundle.h"
+
+#include "graphics/gpu.h"
+
+RenderBundle::RenderBundle(Gpu& gpu)
+    : m_gpu(gpu)
+{
+}
+
+RenderBundle::~RenderBundle()
+{
+    release();
+}
+
+bool RenderBundle::matches(const Signature& signature) const
+{
+    return m_bundle != nullptr && m_signature == signature;
+}
+
+WGPURenderBundleEncoder RenderBundle::begin(const WGPURenderBundleEncoderDescriptor& descriptor, Signature&& signature)
+{
+    release();
+    m_signature = std::move(signature);
+    return wgpuDeviceCreateRenderBundleEncoder(m_gpu.m_device, &descriptor);
+}
+
+void RenderBundle::end(WGPURenderBundleEncoder encoder)
+{
+    WGPURenderBundleDescriptor descriptor{};
+    descriptor.nextInChain  = nullptr;
+    descriptor.label        = "render bundle";
+
+    m_bundle = wgpuRenderBundleEncoderFinish(encoder, &descriptor);
+    wgpuRenderBundleEncoderRelease(encoder);
+    m_nrRecorded++;
+}
+
+void RenderBundle::execute(WGPURenderPassEncoder renderPass) const
+{
+    if (m_bundle != nullptr)
+        wgpuRenderPassEncoderExecuteBundles(renderPass, 1, &m_bundle);
+}
+
+void RenderBundle::release()
+{
+    if (m_bundle != nullptr)
+        wgpuRenderBundleRelease(m_bundle);
+
+    m_bundle = nullptr;
+    m_signature.clear();
+}
+
+size_t RenderBundle::nrRecorded() const
+{
+    return m_nrRecorded;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+#include <cstdint>
+#include <vector>
+
+class Gpu;
+
+// A recorded draw stream that is replayed every frame until the stream changes.
+// The stream is identified by a signature, any value that would alter the recorded
+// commands (pipeline, bind groups, buffers, draw ranges) has to be part of it.
+class RenderBundle
+{
+public:
+    using Signature = std::vector<uint64_t>;
+
+    RenderBundle(Gpu& gpu);
+    ~RenderBundle();
+
+    bool matches(const Signature& signature) const;
+
+    // Starts recording a new bundle for the given signature, finish with end().
+    WGPURenderBundleEncoder begin   (const WGPURenderBundleEncoderDescriptor& descriptor, Signature&& signature);
+    void                    end     (WGPURenderBundleEncoder encoder);
+
+    void execute(WGPURenderPassEncoder renderPass) const;
+    void release();
+
+    size_t nrRecorded() const;
+
+private:
+    Gpu&                m_gpu;
+    WGPURenderBundle    m_bundle    = nullptr;
+    Signature           m_signature;
+    size_t              m_nrRecorded = 0;
+
+    RenderBundle            (const RenderBundle&)   = delete;
+    RenderBundle& operator= (const RenderBundle&)   = delete;
+
+};
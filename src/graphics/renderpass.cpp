@@ -1,4 +1,5 @@
 #include "renderpass.h"
+#include <algorithm>
 #include <iostream>
 #include "renderpasshelpers.h"
 
@@ -9,9 +10,10 @@ RenderPass::RenderPass(Gpu &gpu, RenderTarget &renderTarget, DepthTarget& shadow
     , m_renderTarget  (renderTarget)
     , m_shadowTarget  (shadowTarget)
     , m_optionalTexture(gpu, Texture::Params{ .format = Texture::Format::RGBA, .usage = Texture::Usage::CopySrcTextureBinding })
-    , m_poissonTexture(gpu, Texture::Params{ .format = Texture::Format::RG, .usage = Texture::Usage::CopySrcTextureBinding })
     , m_uniformsFrame (gpu)
-    , m_uniformsModel (gpu)
+    , m_storageModels (gpu)
+    , m_renderBundle  (gpu)
+    , m_lodSelector   (1.0f)
 {
     createPipeline();
 
@@ -21,10 +23,6 @@ RenderPass::RenderPass(Gpu &gpu, RenderTarget &renderTarget, DepthTarget& shadow
     emptyImage.bytesPerPixel = 4;
     emptyImage.type = Image::Type::RGBA;
     m_optionalTexture.setImage(emptyImage);
-
-    Image poissonImage;
-    m_nrPoissonSamples = poissonImage.makePoissonDisc(32, 32, 3);
-    m_poissonTexture.setImage(poissonImage);
 }
 
 RenderPass::~RenderPass()
@@ -32,9 +30,43 @@ RenderPass::~RenderPass()
     wgpuPipelineLayoutRelease(m_layout);
 
     for (WGPUBindGroupLayout& layout : m_bindGroupLayouts)
+    {
+        m_gpu.getBindGroupCache().invalidate(layout);
         wgpuBindGroupLayoutRelease(layout);
+    }
 
     wgpuRenderPipelineRelease(m_pipeline);
+    wgpuRenderPipelineRelease(m_pipelineAfterPrepass);
+    wgpuRenderPipelineRelease(m_depthPipeline);
+}
+
+static ModelData toModelData(const Renderable& renderable)
+{
+    return ModelData
+    {
+        .model                          = renderable.object->getSpace().toRoot,
+        .modelInverseTranspose          = transpose(renderable.object->getSpace().fromRoot),
+        .baseColorFactor                = vec4(renderable.material.albedo, 1.0),
+        .hasBaseColorTexture            = renderable.material.baseColorTexture.has_value() ? 1u : 0u,
+        .hasOcclusionTexture            = renderable.material.occlusion.has_value() ? 1u : 0u,
+        .hasNormalTexture               = renderable.material.normalMap.has_value() ? 1u : 0u,
+        .hasEmissiveTexture             = renderable.material.emissive.has_value() ? 1u : 0u,
+        .hasMetallicRoughnessTexture    = renderable.material.metallicRoughness.has_value() ? 1u : 0u
+    };
+}
+
+static void requestTextures(TextureStreamer& streamer, const Material& material, float projectedPixels)
+{
+    auto request = [&](const std::optional<Image>& image, bool srgb)
+    {
+        if (image.has_value())
+            streamer.request(image.value(), srgb, projectedPixels);
+    };
+    request(material.baseColorTexture,    true);
+    request(material.occlusion,           false);
+    request(material.normalMap,           false);
+    request(material.emissive,            true);
+    request(material.metallicRoughness,   false);
 }
 
 void RenderPass::drawCommands(WGPURenderPassEncoder renderPass, const std::vector<const Renderable*>& renderables)
@@ -48,79 +80,132 @@ void RenderPass::drawCommands(WGPURenderPassEncoder renderPass, const std::vecto
 
     m_uniformsFrame.setSize(1);
     m_uniformsFrame.writeChanges(0, m_frameData);
-    m_uniformsModel.setSize(renderables.size());
 
-    const auto bindGroupFrame = createFrameBindings(environmentMapTexture);
-    wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bindGroupFrame, 0, nullptr);
+    m_lodSelector.begin(m_params.view, m_params.projection, m_renderTarget.getSize().y);
 
-    int index = 0;
+    // The texture levels follow from the size of the renderables on screen, before the material bindings are made
+    TextureStreamer& textureStreamer = m_gpu.getResourcePool().getTextureStreamer();
+    for (const Renderable* renderable : renderables)
+        requestTextures(textureStreamer, renderable->material, 2.0f * m_lodSelector.projectedRadius(*renderable));
+    textureStreamer.update();
+
+    m_drawList.clear();
     for (const Renderable* renderable : renderables)
     {
-        ModelData data
-        {
-            .model                          = renderable->object->getSpace().toRoot,
-            .modelInverseTranspose          = transpose(renderable->object->getSpace().fromRoot),
-            .hasBaseColorTexture            = renderable->material.baseColorTexture.has_value() ? 1u : 0u,
-            .hasOcclusionTexture            = renderable->material.occlusion.has_value() ? 1u : 0u,
-            .hasNormalTexture               = renderable->material.normalMap.has_value() ? 1u : 0u,
-            .hasEmissiveTexture             = renderable->material.emissive.has_value() ? 1u : 0u,
-            .hasMetallicRoughnessTexture    = renderable->material.metallicRoughness.has_value() ? 1u : 0u,
-            .baseColorFactor                = vec4(renderable->material.albedo, 1.0)
-        };
-        m_uniformsModel.writeChanges(index, data);
-
-        Texture* baseColorTexture           = nullptr;
-        Texture* occlusionTexture           = nullptr;
-        Texture* normalsTexture             = nullptr;
-        Texture* emissiveTexture            = nullptr;
-        Texture* metallicRoughnessTexture   = nullptr;
-
-        if (renderable->material.baseColorTexture.has_value())
-        {
-            const Image& image = renderable->material.baseColorTexture.value();
-            baseColorTexture = &m_gpu.getResourcePool().get(&image, true);
-        }
+        // Meshes whose upload doesn't fit in this frame appear in a next one
+        if (VertexBuffer* vertexBuffer = m_gpu.getResourcePool().get(renderable))
+            m_drawList.add(renderable, vertexBuffer, getMaterialBindings(renderable->material), m_lodSelector.select(*renderable));
+    }
+    m_drawList.build();
 
-        if (renderable->material.occlusion.has_value())
-        {
-            const Image& image = renderable->material.occlusion.value();
-            occlusionTexture = &m_gpu.getResourcePool().get(&image);
-        }
+    m_storageModels.setSize(m_drawList.instances().size());
 
-        if (renderable->material.normalMap.has_value())
-        {
-            const Image& image = renderable->material.normalMap.value();
-            normalsTexture = &m_gpu.getResourcePool().get(&image);
-        }
+    int index = 0;
+    for (const Renderable* renderable : m_drawList.instances())
+        m_storageModels.set(index++, toModelData(*renderable));
 
-        if (renderable->material.emissive.has_value())
-        {
-            const Image& image = renderable->material.emissive.value();
-            emissiveTexture = &m_gpu.getResourcePool().get(&image, true);
-        }
+    m_storageModels.upload();
+
+    const WGPUBindGroup frameBindings = getFrameBindings(environmentMapTexture);
+    const WGPUBindGroup modelBindings = getModelBindings();
+
+    if (m_params.useRenderBundles)
+    {
+        recordRenderBundle(frameBindings, modelBindings);
+        m_renderBundle.execute(renderPass);
+        return;
+    }
+
+    m_renderBundle.release();
+
+    // The pipelines share their layout, the bind groups stay set when the pipeline changes
+    wgpuRenderPassEncoderSetBindGroup(renderPass, 0, frameBindings, 0, nullptr);
+    wgpuRenderPassEncoderSetBindGroup(renderPass, 2, modelBindings, 0, nullptr);
 
-        if (renderable->material.metallicRoughness.has_value())
+    if (m_params.depthPrepass)
+    {
+        wgpuRenderPassEncoderSetPipeline(renderPass, m_depthPipeline);
+        for (const DrawList::Batch& batch : m_drawList.batches())
         {
-            const Image& image = renderable->material.metallicRoughness.value();
-            metallicRoughnessTexture = &m_gpu.getResourcePool().get(&image);
+            const VertexBuffer& vertexBuffer = *batch.vertexBuffer;
+
+            wgpuRenderPassEncoderSetBindGroup   (renderPass, 1, batch.material, 0, nullptr);
+            wgpuRenderPassEncoderSetIndexBuffer (renderPass, vertexBuffer.m_indexBuffer, vertexBuffer.m_indexFormat, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
+            wgpuRenderPassEncoderSetVertexBuffer(renderPass,  0, vertexBuffer.m_positionBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_positionBuffer));
+            wgpuRenderPassEncoderDrawIndexed    (renderPass, batch.indexCount, batch.instanceCount, batch.firstIndex, 0, batch.firstInstance);
         }
+    }
+
+    wgpuRenderPassEncoderSetPipeline(renderPass, m_params.depthPrepass ? m_pipelineAfterPrepass : m_pipeline);
+
+    for (const DrawList::Batch& batch : m_drawList.batches())
+    {
+        const VertexBuffer& vertexBuffer = *batch.vertexBuffer;
+
+        wgpuRenderPassEncoderSetBindGroup   (renderPass, 1, batch.material, 0, nullptr);
+        wgpuRenderPassEncoderSetIndexBuffer (renderPass, vertexBuffer.m_indexBuffer, vertexBuffer.m_indexFormat, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
+        wgpuRenderPassEncoderSetVertexBuffer(renderPass,  0, vertexBuffer.m_vertexBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_vertexBuffer));
+        wgpuRenderPassEncoderDrawIndexed    (renderPass, batch.indexCount, batch.instanceCount, batch.firstIndex, 0, batch.firstInstance);
+    }
+}
+
+void RenderPass::recordRenderBundle(WGPUBindGroup frameBindings, WGPUBindGroup modelBindings)
+{
+    const WGPURenderPipeline pipeline = m_params.depthPrepass ? m_pipelineAfterPrepass : m_pipeline;
 
-        const auto bindGroupModel = createModelBindings(renderable, baseColorTexture, occlusionTexture, normalsTexture, emissiveTexture, metallicRoughnessTexture);
+    RenderBundle::Signature signature
+    {
+        reinterpret_cast<uint64_t>(pipeline),
+        reinterpret_cast<uint64_t>(frameBindings),
+        reinterpret_cast<uint64_t>(modelBindings)
+    };
+    m_drawList.appendSignature(signature);
 
-        uint32_t dataOffset = index * m_gpu.uniformStride(sizeof(ModelData));
+    // Only the contents of the uniform and storage buffers changed, replay the last recording.
+    if (m_renderBundle.matches(signature)) return;
 
-        VertexBuffer& vertexBuffer = m_gpu.getResourcePool().get(renderable);
+    WGPURenderBundleEncoderDescriptor descriptor{};
+    descriptor.label                = "color pass bundle";
+    descriptor.colorFormatCount     = 1;
+    descriptor.colorFormats         = &m_renderTarget.m_surfaceFormat;
+    descriptor.depthStencilFormat   = m_depthStencilState.format;
+    descriptor.sampleCount          = 4;
+    descriptor.depthReadOnly        = false;
+    descriptor.stencilReadOnly      = true;
 
-        wgpuRenderPassEncoderSetBindGroup(renderPass, 1, bindGroupModel, 1, &dataOffset);
+    WGPURenderBundleEncoder encoder = m_renderBundle.begin(descriptor, std::move(signature));
 
-        wgpuRenderPassEncoderSetIndexBuffer (renderPass, vertexBuffer.m_indexBuffer, WGPUIndexFormat_Uint32, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
-        wgpuRenderPassEncoderSetVertexBuffer(renderPass,  0, vertexBuffer.m_vertexBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_vertexBuffer));
-        wgpuRenderPassEncoderDrawIndexed    (renderPass, vertexBuffer.m_mesh->indices().size() * 3, 1, 0, 0, 0);
-        index++;
+    wgpuRenderBundleEncoderSetBindGroup(encoder, 0, frameBindings, 0, nullptr);
+    wgpuRenderBundleEncoderSetBindGroup(encoder, 2, modelBindings, 0, nullptr);
+
+    // The prepass is part of the bundle, it is recorded with the same batches
+    if (m_params.depthPrepass)
+    {
+        wgpuRenderBundleEncoderSetPipeline(encoder, m_depthPipeline);
+        for (const DrawList::Batch& batch : m_drawList.batches())
+        {
+            const VertexBuffer& vertexBuffer = *batch.vertexBuffer;
+
+            wgpuRenderBundleEncoderSetBindGroup   (encoder, 1, batch.material, 0, nullptr);
+            wgpuRenderBundleEncoderSetIndexBuffer (encoder, vertexBuffer.m_indexBuffer, vertexBuffer.m_indexFormat, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
+            wgpuRenderBundleEncoderSetVertexBuffer(encoder,  0, vertexBuffer.m_positionBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_positionBuffer));
+            wgpuRenderBundleEncoderDrawIndexed    (encoder, batch.indexCount, batch.instanceCount, batch.firstIndex, 0, batch.firstInstance);
+        }
+    }
+
+    wgpuRenderBundleEncoderSetPipeline(encoder, pipeline);
 
-        wgpuBindGroupRelease(bindGroupModel);
+    for (const DrawList::Batch& batch : m_drawList.batches())
+    {
+        const VertexBuffer& vertexBuffer = *batch.vertexBuffer;
+
+        wgpuRenderBundleEncoderSetBindGroup   (encoder, 1, batch.material, 0, nullptr);
+        wgpuRenderBundleEncoderSetIndexBuffer (encoder, vertexBuffer.m_indexBuffer, vertexBuffer.m_indexFormat, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
+        wgpuRenderBundleEncoderSetVertexBuffer(encoder,  0, vertexBuffer.m_vertexBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_vertexBuffer));
+        wgpuRenderBundleEncoderDrawIndexed    (encoder, batch.indexCount, batch.instanceCount, batch.firstIndex, 0, batch.firstInstance);
     }
-    wgpuBindGroupRelease(bindGroupFrame);
+
+    m_renderBundle.end(encoder);
 }
 
 void RenderPass::renderPre(const RenderParams& params)
@@ -130,9 +215,26 @@ void RenderPass::renderPre(const RenderParams& params)
     m_frameData.projection           = params.projection;
     m_frameData.viewPositionWorld    = inverse(params.view)[3];
     m_frameData.lightPositionWorld   = params.lightPosWorld;
-    m_frameData.shadowViewProjection = params.shadowViewProjection;
     m_frameData.hasEnvironmentMap    = params.environmentMap != nullptr ? 1 : 0;
-    m_frameData.nrPoissonSamples     = m_nrPoissonSamples;
+    m_frameData.nrPoissonSamples     = uint32_t(std::clamp(params.shadowSamples, 1, 32));
+    m_frameData.shadowFilter         = uint32_t(params.shadowFilter);
+    m_frameData.nrShadowCascades     = uint32_t(std::min<size_t>(params.shadowCascades.size(), maxShadowCascades));
+    if (m_frameData.nrShadowCascades > 0)
+        m_frameData.shadowView = params.shadowCascades[0].view;
+
+    for (uint32_t i = 0; i < m_frameData.nrShadowCascades; i++)
+    {
+        // The filter reaches over a few texels, the bias follows the texel size of the cascade
+        const float biasTexels = 4.0f;
+        const ShadowCascade& cascade = params.shadowCascades[i];
+        const mat4& projection = cascade.projection;
+
+        // Orthographic projections only scale and move, y of texture coordinates points down
+        m_frameData.cascadeScales[i]    = vec4(0.5f * projection[0][0], -0.5f * projection[1][1], projection[2][2], 0.0f);
+        m_frameData.cascadeOffsets[i]   = vec4(0.5f * projection[3][0] + 0.5f, -0.5f * projection[3][1] + 0.5f, projection[3][2], 0.0f);
+        m_frameData.cascadeSplits[i]    = cascade.splitDistance;
+        m_frameData.cascadeBias[i]      = biasTexels * cascade.texelSize / cascade.depthRange;
+    }
 }
 
 void RenderPass::render(const std::vector<const Renderable*>& renderables)
@@ -183,7 +285,6 @@ void RenderPass::render(const std::vector<const Renderable*>& renderables)
 
     glm::vec2 size = m_renderTarget.getSize();
     wgpuRenderPassEncoderSetViewport(renderPass, 0, 0, size.x, size.y, 0.0, 1.0);
-    wgpuRenderPassEncoderSetPipeline(renderPass, m_pipeline);
 
     drawCommands(renderPass, renderables);
 
@@ -222,12 +323,12 @@ void RenderPass::createPipeline()
 
     pipelineDesc.depthStencil = &m_depthStencilState;
 
-    VertexBuffer::Layout vertexLayout {};
+    VertexBuffer::Layout vertexLayout(m_gpu.m_vertexFormat);
     pipelineDesc.vertex.bufferCount = 1;
     pipelineDesc.vertex.buffers = &vertexLayout.layout;
  
     pipelineDesc.vertex.module = shaderModule;
-    pipelineDesc.vertex.entryPoint = "vs_main";
+    pipelineDesc.vertex.entryPoint = m_gpu.m_vertexFormat == VertexBuffer::Format::Packed ? "vs_main_packed" : "vs_main";
     pipelineDesc.vertex.constantCount = 0;
     pipelineDesc.vertex.constants = nullptr;
 
@@ -267,6 +368,24 @@ void RenderPass::createPipeline()
 
     m_pipeline = wgpuDeviceCreateRenderPipeline(m_gpu.m_device, &pipelineDesc);
 
+    // After a depth prepass only the nearest surface passes, depth is already written
+    WGPUDepthStencilState depthEqualState = m_depthStencilState;
+    depthEqualState.depthCompare        = WGPUCompareFunction_Equal;
+    depthEqualState.depthWriteEnabled   = false;
+
+    pipelineDesc.label          = "color pass pipeline after depth prepass";
+    pipelineDesc.depthStencil   = &depthEqualState;
+    m_pipelineAfterPrepass = wgpuDeviceCreateRenderPipeline(m_gpu.m_device, &pipelineDesc);
+
+    // The depth prepass reads the position stream and has no fragment stage
+    VertexBuffer::PositionLayout positionLayout;
+    pipelineDesc.label              = "depth prepass pipeline";
+    pipelineDesc.depthStencil       = &m_depthStencilState;
+    pipelineDesc.vertex.buffers     = &positionLayout.layout;
+    pipelineDesc.vertex.entryPoint  = "vs_depth";
+    pipelineDesc.fragment           = nullptr;
+    m_depthPipeline = wgpuDeviceCreateRenderPipeline(m_gpu.m_device, &pipelineDesc);
+
     wgpuShaderModuleRelease(shaderModule);
 }
 
@@ -274,20 +393,23 @@ void RenderPass::createLayout(WGPURenderPipelineDescriptor& pipeline)
 {
     std::array<WGPUBindGroupLayoutEntry, 6> frameEntries{};
     fillUniformsBindGroupLayoutEntry            (frameEntries[0], 0, sizeof(FrameData), false);
-    fillDepthTextureBindGroupLayoutEntry        (frameEntries[1], 1);
+    fillDepthTextureArrayBindGroupLayoutEntry   (frameEntries[1], 1);
     fillSamplerComparisonBindGroupLayoutEntry   (frameEntries[2], 2);
     fillTextureCubeBindGroupLayoutEntry         (frameEntries[3], 3);
     fillTextureBindGroupLayoutEntry             (frameEntries[4], 4);
     fillSamplerBindGroupLayoutEntry             (frameEntries[5], 5);
+    frameEntries[4].texture.viewDimension = WGPUTextureViewDimension_2DArray;
+
+    std::array<WGPUBindGroupLayoutEntry, 6> materialEntries{};
+    fillSamplerBindGroupLayoutEntry  (materialEntries[0], 0);
+    fillTextureBindGroupLayoutEntry  (materialEntries[1], 1);
+    fillTextureBindGroupLayoutEntry  (materialEntries[2], 2);
+    fillTextureBindGroupLayoutEntry  (materialEntries[3], 3);
+    fillTextureBindGroupLayoutEntry  (materialEntries[4], 4);
+    fillTextureBindGroupLayoutEntry  (materialEntries[5], 5);
 
-    std::array<WGPUBindGroupLayoutEntry, 7> modelEntries{};
-    fillUniformsBindGroupLayoutEntry (modelEntries[0], 0, sizeof(ModelData), true);
-    fillSamplerBindGroupLayoutEntry  (modelEntries[1], 1);
-    fillTextureBindGroupLayoutEntry  (modelEntries[2], 2);
-    fillTextureBindGroupLayoutEntry  (modelEntries[3], 3);
-    fillTextureBindGroupLayoutEntry  (modelEntries[4], 4);
-    fillTextureBindGroupLayoutEntry  (modelEntries[5], 5);
-    fillTextureBindGroupLayoutEntry  (modelEntries[6], 6);
+    std::array<WGPUBindGroupLayoutEntry, 1> modelEntries{};
+    fillStorageBindGroupLayoutEntry  (modelEntries[0], 0, sizeof(ModelData));
 
     WGPUBindGroupLayoutDescriptor groupLayoutFrame{};
     groupLayoutFrame.label = "grouplayout0 - per frame data";
@@ -296,12 +418,19 @@ void RenderPass::createLayout(WGPURenderPipelineDescriptor& pipeline)
     groupLayoutFrame.entries = frameEntries.data();
     m_bindGroupLayouts[0] = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayoutFrame);
 
+    WGPUBindGroupLayoutDescriptor groupLayoutMaterial{};
+    groupLayoutMaterial.label = "grouplayout1 - per material data";
+    groupLayoutMaterial.nextInChain = nullptr;
+    groupLayoutMaterial.entryCount = materialEntries.size();
+    groupLayoutMaterial.entries = materialEntries.data();
+    m_bindGroupLayouts[1] = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayoutMaterial);
+
     WGPUBindGroupLayoutDescriptor groupLayoutModel{};
-    groupLayoutModel.label = "grouplayout1 - per model data";
+    groupLayoutModel.label = "grouplayout2 - per model data";
     groupLayoutModel.nextInChain = nullptr;
     groupLayoutModel.entryCount = modelEntries.size();
     groupLayoutModel.entries = modelEntries.data();
-    m_bindGroupLayouts[1] = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayoutModel);
+    m_bindGroupLayouts[2] = wgpuDeviceCreateBindGroupLayout(m_gpu.m_device, &groupLayoutModel);
 
     WGPUPipelineLayoutDescriptor layoutDesc{};
     layoutDesc.nextInChain          = nullptr;
@@ -312,7 +441,7 @@ void RenderPass::createLayout(WGPURenderPipelineDescriptor& pipeline)
     pipeline.layout = m_layout;
 }
 
-WGPUBindGroup RenderPass::createFrameBindings(const Texture* environmentMap) const
+WGPUBindGroup RenderPass::getFrameBindings(const Texture* environmentMap) const
 { 
     std::array<WGPUBindGroupEntry, 6> frameBindings{};
     WGPUBindGroupEntry& entry0 = frameBindings[0];
@@ -334,62 +463,65 @@ WGPUBindGroup RenderPass::createFrameBindings(const Texture* environmentMap) con
     entryCubemap.binding = 3;
     entryCubemap.textureView = environmentMap != nullptr ? environmentMap->getTextureView(): m_optionalTexture.getTextureView();
 
-    WGPUBindGroupEntry& entryPoisson = frameBindings[4];
-    entryPoisson.binding = 4;
-    entryPoisson.textureView = m_poissonTexture.getTextureView();
+    WGPUBindGroupEntry& entryShadowMoments = frameBindings[4];
+    entryShadowMoments.binding = 4;
+    entryShadowMoments.textureView = m_shadowTarget.m_momentTexture.getTextureView();
 
-    WGPUBindGroupEntry& entryNearestSampler = frameBindings[5];
-    entryNearestSampler.binding = 5;
-    entryNearestSampler.sampler = m_gpu.m_nearestSampler;
+    WGPUBindGroupEntry& entryMomentSampler = frameBindings[5];
+    entryMomentSampler.binding = 5;
+    entryMomentSampler.sampler = m_gpu.m_momentSampler;
 
-    const WGPUBindGroupDescriptor group {
-        .layout        = m_bindGroupLayouts[0],
-        .entryCount    = frameBindings.size(),
-        .entries       = frameBindings.data()
-    };
-    return wgpuDeviceCreateBindGroup(m_gpu.m_device, &group);
+    return m_gpu.getBindGroupCache().get(m_bindGroupLayouts[0], frameBindings);
 }
 
-WGPUBindGroup RenderPass::createModelBindings(const Renderable* renderable, Texture* baseColorTexture, Texture* occlusionTexture, Texture* normalsTexture, Texture* emissiveTexture, Texture* metallicRoughnessTexture)
+WGPUBindGroup RenderPass::getMaterialBindings(const Material& material) const
 { 
-    std::array<WGPUBindGroupEntry, 7> bindings{};
-    
-    WGPUBindGroupEntry& entry1 = bindings[0];
-    entry1.nextInChain = nullptr;
-    entry1.binding = 0; 
-    entry1.buffer = m_uniformsModel.m_buffer;
-    entry1.offset = 0;
-    entry1.size = sizeof(ModelData);
-
-    WGPUBindGroupEntry& entrySampler = bindings[1];
-    entrySampler.binding = 1;
+    ResourcePool& pool = m_gpu.getResourcePool();
+
+    auto textureView = [&](const std::optional<Image>& image, bool srgb)
+    {
+        return image.has_value() ? pool.get(&image.value(), srgb).getTextureView() : m_optionalTexture.getTextureView();
+    };
+
+    std::array<WGPUBindGroupEntry, 6> bindings{};
+
+    WGPUBindGroupEntry& entrySampler = bindings[0];
+    entrySampler.binding = 0;
     entrySampler.sampler = m_gpu.m_linearSampler;
 
-    WGPUBindGroupEntry& entryBaseColorTexture = bindings[2];
-    entryBaseColorTexture.binding = 2;
-    entryBaseColorTexture.textureView = baseColorTexture != nullptr ? baseColorTexture->getTextureView() : m_optionalTexture.getTextureView();
+    WGPUBindGroupEntry& entryBaseColorTexture = bindings[1];
+    entryBaseColorTexture.binding = 1;
+    entryBaseColorTexture.textureView = textureView(material.baseColorTexture, true);
 
-    WGPUBindGroupEntry& entryOcclusionTexture = bindings[3];
-    entryOcclusionTexture.binding = 3;
-    entryOcclusionTexture.textureView = occlusionTexture != nullptr ? occlusionTexture->getTextureView() : m_optionalTexture.getTextureView();
+    WGPUBindGroupEntry& entryOcclusionTexture = bindings[2];
+    entryOcclusionTexture.binding = 2;
+    entryOcclusionTexture.textureView = textureView(material.occlusion, false);
 
-    WGPUBindGroupEntry& entryNormalsTexture = bindings[4];
-    entryNormalsTexture.binding = 4;
-    entryNormalsTexture.textureView = normalsTexture != nullptr ? normalsTexture->getTextureView() : m_optionalTexture.getTextureView();
+    WGPUBindGroupEntry& entryNormalsTexture = bindings[3];
+    entryNormalsTexture.binding = 3;
+    entryNormalsTexture.textureView = textureView(material.normalMap, false);
 
-    WGPUBindGroupEntry& entryEmissiveTexture = bindings[5];
-    entryEmissiveTexture.binding = 5;
-    entryEmissiveTexture.textureView = emissiveTexture != nullptr ? emissiveTexture->getTextureView(): m_optionalTexture.getTextureView();
+    WGPUBindGroupEntry& entryEmissiveTexture = bindings[4];
+    entryEmissiveTexture.binding = 4;
+    entryEmissiveTexture.textureView = textureView(material.emissive, true);
 
-    WGPUBindGroupEntry& entryTexture = bindings[6];
-    entryTexture.binding = 6;
-    entryTexture.textureView = metallicRoughnessTexture != nullptr ? metallicRoughnessTexture->getTextureView() : m_optionalTexture.getTextureView();
+    WGPUBindGroupEntry& entryTexture = bindings[5];
+    entryTexture.binding = 5;
+    entryTexture.textureView = textureView(material.metallicRoughness, false);
+
+    return m_gpu.getBindGroupCache().get(m_bindGroupLayouts[1], bindings);
+}
 
-    WGPUBindGroupDescriptor group{};
-    group.nextInChain   = nullptr;
-    group.layout        = m_bindGroupLayouts[1];
-    group.entryCount    = bindings.size();
-    group.entries       = bindings.data();
+WGPUBindGroup RenderPass::getModelBindings() const
+{ 
+    std::array<WGPUBindGroupEntry, 1> bindings{};
+    
+    WGPUBindGroupEntry& entry0 = bindings[0];
+    entry0.nextInChain = nullptr;
+    entry0.binding = 0; 
+    entry0.buffer = m_storageModels.m_buffer;
+    entry0.offset = 0;
+    entry0.size = m_storageModels.byteSize();
 
-    return wgpuDeviceCreateBindGroup(m_gpu.m_device, &group);
+    return m_gpu.getBindGroupCache().get(m_bindGroupLayouts[2], bindings);
 }
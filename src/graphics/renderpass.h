@@ -8,6 +8,10 @@
 #include "rendertarget.h"
 #include "vertexbuffer.h"
 #include "uniforms.h"
+#include "storagebuffer.h"
+#include "drawlist.h"
+#include "renderbundle.h"
+#include "lodselector.h"
 #include "renderable.h"
 #include "uniformsdata.h"
 
@@ -21,10 +25,15 @@ public:
     {
         glm::mat4 view;
         glm::mat4 projection;
-        glm::mat4 shadowViewProjection;
-        glm::mat4 worldToLight;
         glm::vec4 lightPosWorld;
+        std::vector<ShadowCascade> shadowCascades;
+        int       shadowSamples = 16;     // Shadow filter samples of penumbra fragments, up to 32
+        ShadowFilter shadowFilter = ShadowFilter::Pcf;
         Cubemap*  environmentMap;
+        bool      useRenderBundles = true;
+
+        // Draws the depth of all renderables first, so the fragment shader runs once per visible pixel
+        bool      depthPrepass = false;
     };
 
     void renderPre  (const RenderParams& params);
@@ -37,26 +46,33 @@ private:
     RenderParams        m_params;
 
     Texture m_optionalTexture;
-    Texture m_poissonTexture;
-
-    int m_nrPoissonSamples = 0;
 
     FrameData              m_frameData;
     Uniforms<FrameData>    m_uniformsFrame;
 
-    ModelData              m_modelData;
-    Uniforms<ModelData>    m_uniformsModel;
+    StorageBuffer<ModelData>    m_storageModels;
+    DrawList                    m_drawList;
+    RenderBundle                m_renderBundle;
+    LodSelector                 m_lodSelector;
 
     WGPUPipelineLayout      m_layout {};
-    std::array<WGPUBindGroupLayout, 2> m_bindGroupLayouts {};
+
+    // Bind groups per update frequency: 0 - per frame, 1 - per material, 2 - per object (indexed by instance)
+    std::array<WGPUBindGroupLayout, 3> m_bindGroupLayouts {};
 
     WGPUDepthStencilState   m_depthStencilState {};
     WGPURenderPipeline      m_pipeline {};
+    WGPURenderPipeline      m_pipelineAfterPrepass {};  // Shades the pixels whose depth is equal to the prepass depth
+    WGPURenderPipeline      m_depthPipeline {};
 
     void createPipeline();
     void createLayout(WGPURenderPipelineDescriptor& pipeline);
-    WGPUBindGroup createFrameBindings(const Texture* cubeMapTexture) const;
-    WGPUBindGroup createModelBindings(const Renderable* renderable, Texture* baseColorTexture, Texture* occlusionTexture, Texture* normalsTexture, Texture* emissiveTexture, Texture* metallicRoughnessTexture);
 
-    void drawCommands(WGPURenderPassEncoder renderPass, const std::vector<const Renderable*>& renderables);
+    // Bind groups are owned by the bind group cache of the gpu, they must not be released.
+    WGPUBindGroup getFrameBindings    (const Texture* cubeMapTexture) const;
+    WGPUBindGroup getMaterialBindings (const Material& material) const;
+    WGPUBindGroup getModelBindings    () const;
+
+    void drawCommands       (WGPURenderPassEncoder renderPass, const std::vector<const Renderable*>& renderables);
+    void recordRenderBundle (WGPUBindGroup frameBindings, WGPUBindGroup modelBindings);
 };
@@ -30,6 +30,16 @@ void fillDepthTextureBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int b
     entry.texture.multisampled  = false;
 }
 
+void fillDepthTextureArrayBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding)
+{
+    setDefault(entry);
+    entry.binding               = binding;
+    entry.visibility            = WGPUShaderStage_Fragment;
+    entry.texture.sampleType    = WGPUTextureSampleType_Depth;
+    entry.texture.viewDimension = WGPUTextureViewDimension_2DArray;
+    entry.texture.multisampled  = false;
+}
+
 void fillSamplerBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding)
 {
     setDefault(entry);
@@ -49,13 +59,23 @@ void fillSamplerComparisonBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry,
 void fillUniformsBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding, int size, bool dynamicOffset)
 {
     setDefault(entry);
-    entry.binding = 0;
+    entry.binding = binding;
     entry.visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment;
     entry.buffer.type = WGPUBufferBindingType_Uniform;
     entry.buffer.minBindingSize = size;
     entry.buffer.hasDynamicOffset = dynamicOffset;
 }
 
+void fillStorageBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding, int elementSize)
+{
+    setDefault(entry);
+    entry.binding = binding;
+    entry.visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment;
+    entry.buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    entry.buffer.minBindingSize = elementSize;
+    entry.buffer.hasDynamicOffset = false;
+}
+
 void setDefault(WGPUBindGroupLayoutEntry &bindingLayout) 
 {
     bindingLayout.buffer.nextInChain = nullptr;
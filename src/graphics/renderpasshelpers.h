@@ -6,11 +6,13 @@ void fillTextureBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int bindin
 void fillTextureCubeBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding);
 
 void fillDepthTextureBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding);
+void fillDepthTextureArrayBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding);
 
 void fillSamplerBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding);
 void fillSamplerComparisonBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding);
 
 void fillUniformsBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding, int size, bool dynamicOffset);
+void fillStorageBindGroupLayoutEntry(WGPUBindGroupLayoutEntry& entry, int binding, int elementSize);
 
 void setDefault(WGPUBindGroupLayoutEntry &bindingLayout);
 void setDefault(WGPUStencilFaceState &stencilFaceState);
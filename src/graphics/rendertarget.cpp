@@ -1,11 +1,13 @@
 #include "rendertarget.h"
 #include <iostream>
+#include <cstring>
 
 using namespace glm;
 
-WindowTarget::WindowTarget(Gpu& gpu)
+WindowTarget::WindowTarget(Gpu& gpu, PresentMode presentMode, int maxFramesInFlight)
     : m_depthTexture(gpu, Texture::Params {.usage = Texture::Usage::RenderAttachment, .sampleCount = 4, .format = Texture::Format::Depth24Plus })
     , m_msaaTexture (gpu, Texture::Params {.usage = Texture::Usage::RenderAttachment, .sampleCount = 4, .format = Texture::Format::BGRA  })
+    , m_gpu         (gpu)
 {
     int windowFlags = SDL_WINDOW_RESIZABLE;
     window  = SDL_CreateWindow("WebGPU renderer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, windowFlags);
@@ -20,6 +22,12 @@ WindowTarget::WindowTarget(Gpu& gpu)
         std::cout << "Surface format supported: " << capabilities.formats[i] << std::endl;
     }
 
+    for (int i = 0; i < capabilities.presentModeCount; i++)
+    {
+        std::cout << "Present mode supported: " << capabilities.presentModes[i] << std::endl;
+        m_supportedPresentModes.push_back(capabilities.presentModes[i]);
+    }
+
     m_surfaceFormat = WGPUTextureFormat::WGPUTextureFormat_BGRA8UnormSrgb;
 
     surfaceConfig.nextInChain      = nullptr;
@@ -33,31 +41,94 @@ WindowTarget::WindowTarget(Gpu& gpu)
     surfaceConfig.presentMode      = WGPUPresentMode_Fifo;
     surfaceConfig.alphaMode        = WGPUCompositeAlphaMode_Auto;
 
-    wgpuSurfaceConfigure(surface, &surfaceConfig);
+    setPresentMode(presentMode);
+    setMaxFramesInFlight(maxFramesInFlight);
+    configure();
 }
 
 WindowTarget::~WindowTarget()
 {
+    // Callbacks of frames in flight refer to this target.
+    while (m_framesCompleted < m_framesSubmitted)
+        m_gpu.processEvents();
+
     wgpuSurfaceUnconfigure(surface);
     surface = nullptr;
     window  = nullptr;
 }
 
-void WindowTarget::beginRender()
+void WindowTarget::setPresentMode(PresentMode presentMode)
+{
+    WGPUPresentMode mode = WGPUPresentMode_Fifo;
+    switch (presentMode)
+    {
+        case PresentMode::Fifo:         mode = WGPUPresentMode_Fifo;        break;
+        case PresentMode::Mailbox:      mode = WGPUPresentMode_Mailbox;     break;
+        case PresentMode::Immediate:    mode = WGPUPresentMode_Immediate;   break;
+    }
+
+    if (std::find(m_supportedPresentModes.begin(), m_supportedPresentModes.end(), mode) == m_supportedPresentModes.end())
+    {
+        std::cout << "Present mode " << mode << " not supported, using fifo" << std::endl;
+        mode = WGPUPresentMode_Fifo;
+    }
+
+    if (surfaceConfig.presentMode != mode)
+    {
+        surfaceConfig.presentMode = mode;
+        m_configured = false;
+    }
+}
+
+void WindowTarget::setMaxFramesInFlight(int maxFramesInFlight)
+{
+    m_maxFramesInFlight = std::max(maxFramesInFlight, 1);
+}
+
+void WindowTarget::resize()
+{
+    m_configured = false;
+}
+
+void WindowTarget::configure()
 {
     glm::vec2 size = getSize();
-    surfaceConfig.width = size.x;
+    surfaceConfig.width  = size.x;
     surfaceConfig.height = size.y;
     wgpuSurfaceConfigure(surface, &surfaceConfig);
 
     m_msaaTexture.setSize(size);
     m_depthTexture.setSize(size);
+    m_configured = true;
+}
+
+void WindowTarget::beginRender()
+{
+    // Limit the latency by not running ahead of the gpu more than the maximum frames in flight.
+    while (m_framesSubmitted - m_framesCompleted >= uint64_t(m_maxFramesInFlight))
+        m_gpu.processEvents();
+
+    if (!m_configured)
+        configure();
 }
 
 void WindowTarget::endRender()
 {
-    wgpuTextureViewRelease(targetView);
-    wgpuSurfacePresent(surface);
+    if (targetView != nullptr)
+    {
+        wgpuTextureViewRelease(targetView);
+        wgpuSurfacePresent(surface);
+        targetView = nullptr;
+    }
+
+    m_framesSubmitted++;
+    wgpuQueueOnSubmittedWorkDone(m_gpu.m_queue, onSubmittedWorkDone, this);
+}
+
+void WindowTarget::onSubmittedWorkDone(WGPUQueueWorkDoneStatus status, void* userData)
+{
+    WindowTarget& target = *reinterpret_cast<WindowTarget*>(userData);
+    target.m_framesCompleted++;
 }
 
 glm::vec2 WindowTarget::getSize() const
@@ -72,7 +143,12 @@ WGPUTextureView WindowTarget::getNextTextureView()
     WGPUSurfaceTexture surfaceTexture;
     wgpuSurfaceGetCurrentTexture(surface, &surfaceTexture);
     if (surfaceTexture.status != WGPUSurfaceGetCurrentTextureStatus_Success)
+    {
+        // The surface no longer matches the window, configure it again for the next frame.
+        if (surfaceTexture.status == WGPUSurfaceGetCurrentTextureStatus_Outdated || surfaceTexture.status == WGPUSurfaceGetCurrentTextureStatus_Lost)
+            m_configured = false;
         return nullptr;
+    }
 
     WGPUTextureViewDescriptor viewDescriptor {};
     viewDescriptor.nextInChain = nullptr;
@@ -105,16 +181,17 @@ WGPUTextureView WindowTarget::getMsaaTextureView()
 }
 
 DepthTarget::DepthTarget(Gpu& gpu)
-    : m_depthTexture(gpu, Texture::Params{ .format = Texture::Format::Depth32, .sampleCount = 1, .usage = Texture::Usage::RenderAndBinding })
+    : m_depthTexture(gpu, Texture::Params{ .format = Texture::Format::Depth32, .sampleCount = 1, .usage = Texture::Usage::RenderAndBindingCopyDst })
+    , m_momentTexture(gpu, Texture::Params{ .format = Texture::Format::RGBA16F, .usage = Texture::Usage::StorageAndBinding })
 {
 }
 
 DepthTarget::~DepthTarget() = default;
 
-void DepthTarget::setSize(glm::vec2 size)
+void DepthTarget::setSize(glm::vec2 size, uint32_t layers)
 {
     m_size = size;
-    m_depthTexture.setSize(size);
+    m_depthTexture.setSize(glm::vec3(size, layers));
 }
 
 void DepthTarget::beginRender()
@@ -148,3 +225,169 @@ WGPUTextureView DepthTarget::getMsaaTextureView()
     assert(false); // Only depth texture is supported.
     return nullptr;
 }
+
+OffscreenTarget::OffscreenTarget(Gpu& gpu, glm::vec2 size, int nrReadbackBuffers)
+    : m_depthTexture    (gpu, Texture::Params {.usage = Texture::Usage::RenderAttachment, .sampleCount = 4, .format = Texture::Format::Depth24Plus })
+    , m_msaaTexture     (gpu, Texture::Params {.usage = Texture::Usage::RenderAttachment, .sampleCount = 4, .format = Texture::Format::RGBAsrgb })
+    , m_resolveTexture  (gpu, Texture::Params {.usage = Texture::Usage::RenderAttachmentCopySrc, .sampleCount = 1, .format = Texture::Format::RGBAsrgb })
+    , m_gpu             (gpu)
+    , m_size            (size)
+{
+    m_surfaceFormat = WGPUTextureFormat_RGBA8UnormSrgb;
+
+    for (int i = 0; i < std::max(nrReadbackBuffers, 1); i++)
+        m_readbacks.emplace_back(std::make_unique<Readback>());
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+    flush();
+
+    for (auto& readback : m_readbacks)
+    {
+        if (readback->buffer != nullptr)
+        {
+            wgpuBufferDestroy(readback->buffer);
+            wgpuBufferRelease(readback->buffer);
+        }
+    }
+}
+
+void OffscreenTarget::setSize(glm::vec2 size)
+{
+    m_size = size;
+}
+
+void OffscreenTarget::setReadbackCallback(ReadbackCallback callback)
+{
+    m_readbackCallback = std::move(callback);
+}
+
+void OffscreenTarget::flush()
+{
+    for (auto& readback : m_readbacks)
+        wait(*readback);
+}
+
+void OffscreenTarget::beginRender()
+{
+    m_msaaTexture   .setSize(m_size);
+    m_depthTexture  .setSize(m_size);
+    m_resolveTexture.setSize(m_size);
+}
+
+void OffscreenTarget::endRender()
+{
+    Readback& readback = *m_readbacks[m_nextReadback];
+    m_nextReadback = (m_nextReadback + 1) % m_readbacks.size();
+
+    // All buffers of the ring are in flight, wait for the oldest one.
+    wait(readback);
+
+    uvec2 size = uvec2(m_size);
+    readback.size           = size;
+    readback.bytesPerRow    = (size.x * 4 + 255) & ~255; // Copies require rows aligned to 256 bytes
+    readback.callback       = m_readbackCallback;
+
+    uint64_t bufferSize = uint64_t(readback.bytesPerRow) * size.y;
+    if (readback.buffer == nullptr || readback.bufferSize != bufferSize)
+    {
+        if (readback.buffer != nullptr)
+        {
+            wgpuBufferDestroy(readback.buffer);
+            wgpuBufferRelease(readback.buffer);
+        }
+
+        WGPUBufferDescriptor bufferDesc{};
+        bufferDesc.label            = "readback buffer";
+        bufferDesc.size             = bufferSize;
+        bufferDesc.usage            = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead;
+        bufferDesc.mappedAtCreation = false;
+        readback.buffer     = wgpuDeviceCreateBuffer(m_gpu.m_device, &bufferDesc);
+        readback.bufferSize = bufferSize;
+    }
+
+    WGPUCommandEncoderDescriptor encoderDesc{};
+    encoderDesc.label = "readback encoder";
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(m_gpu.m_device, &encoderDesc);
+
+    WGPUImageCopyTexture source{};
+    source.texture  = m_resolveTexture.m_texture;
+    source.mipLevel = 0;
+    source.origin   = { 0, 0, 0 };
+    source.aspect   = WGPUTextureAspect_All;
+
+    WGPUImageCopyBuffer destination{};
+    destination.buffer              = readback.buffer;
+    destination.layout.offset       = 0;
+    destination.layout.bytesPerRow  = readback.bytesPerRow;
+    destination.layout.rowsPerImage = size.y;
+
+    WGPUExtent3D copySize = { size.x, size.y, 1 };
+    wgpuCommandEncoderCopyTextureToBuffer(encoder, &source, &destination, &copySize);
+
+    WGPUCommandBufferDescriptor commandDesc{};
+    commandDesc.label = "readback commands";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &commandDesc);
+    wgpuCommandEncoderRelease(encoder);
+    wgpuQueueSubmit(m_gpu.m_queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+
+    readback.pending = true;
+    wgpuBufferMapAsync(readback.buffer, WGPUMapMode_Read, 0, bufferSize, onBufferMapped, &readback);
+}
+
+void OffscreenTarget::wait(Readback& readback)
+{
+    while (readback.pending)
+        m_gpu.processEvents();
+}
+
+void OffscreenTarget::onBufferMapped(WGPUBufferMapAsyncStatus status, void* userData)
+{
+    Readback& readback = *reinterpret_cast<Readback*>(userData);
+    readback.pending = false;
+
+    if (status != WGPUBufferMapAsyncStatus_Success)
+    {
+        std::cerr << "Could not map readback buffer: " << status << std::endl;
+        return;
+    }
+
+    const uint8_t* mapped = static_cast<const uint8_t*>(wgpuBufferGetConstMappedRange(readback.buffer, 0, readback.bufferSize));
+
+    Image image(size_t(readback.size.x) * readback.size.y * 4);
+    image.width         = readback.size.x;
+    image.height        = readback.size.y;
+    image.bytesPerPixel = 4;
+    image.type          = Image::Type::RGBA;
+
+    size_t rowBytes = size_t(readback.size.x) * 4;
+    for (uint32_t y = 0; y < readback.size.y; y++)
+        std::memcpy(image.pixels->data() + y * rowBytes, mapped + size_t(y) * readback.bytesPerRow, rowBytes);
+
+    wgpuBufferUnmap(readback.buffer);
+
+    if (readback.callback)
+        readback.callback(image);
+}
+
+glm::vec2 OffscreenTarget::getSize() const
+{
+    return m_size;
+}
+
+WGPUTextureView OffscreenTarget::getNextTextureView()
+{
+    return m_resolveTexture.getTextureView();
+}
+
+WGPUTextureView OffscreenTarget::getDepthTextureView()
+{
+    return m_depthTexture.getTextureView();
+}
+
+WGPUTextureView OffscreenTarget::getMsaaTextureView()
+{
+    return m_msaaTexture.getTextureView();
+}
@@ -7,7 +7,10 @@
 #include <SDL2/SDL.h>
 
 #include <glm/glm.hpp>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "gpu.h"
 #include "texture.h"
@@ -23,6 +26,8 @@ public:
 
     virtual glm::vec2   getSize() const = 0;
 
+    virtual void resize() {}
+
     virtual WGPUTextureView getNextTextureView() = 0;
     virtual WGPUTextureView getDepthTextureView() = 0;
     virtual WGPUTextureView getMsaaTextureView() = 0;
@@ -35,9 +40,23 @@ protected:
 class WindowTarget: public RenderTarget
 {
 public:
-    WindowTarget(Gpu& gpu);
+    enum class PresentMode
+    {
+        Fifo,       // Vsync, always supported
+        Mailbox,    // Vsync, newer frames replace queued ones
+        Immediate   // No vsync, may tear
+    };
+
+    WindowTarget(Gpu& gpu, PresentMode presentMode = PresentMode::Fifo, int maxFramesInFlight = 2);
     virtual ~WindowTarget();
 
+    // Falls back to Fifo when the surface doesn't support the mode.
+    void setPresentMode         (PresentMode presentMode);
+    void setMaxFramesInFlight   (int maxFramesInFlight);
+
+    // Reconfigures the surface before the next frame, call when the window size changed.
+    void resize() override;
+
     void        beginRender()   override;
     void        endRender()     override;
     glm::vec2   getSize() const override;
@@ -50,11 +69,23 @@ public:
     Texture m_msaaTexture;
 
 private:
+    Gpu&            m_gpu;
     SDL_Window*     window      = nullptr;
     WGPUSurface     surface     = nullptr;
     WGPUTextureView targetView  = nullptr;
     WGPUSurfaceConfiguration surfaceConfig = {};
 
+    std::vector<WGPUPresentMode> m_supportedPresentModes;
+
+    bool        m_configured            = false;
+    int         m_maxFramesInFlight     = 2;
+    uint64_t    m_framesSubmitted       = 0;
+    uint64_t    m_framesCompleted       = 0;
+
+    void configure();
+
+    static void onSubmittedWorkDone(WGPUQueueWorkDoneStatus status, void* userData);
+
 };
 
 class DepthTarget: public RenderTarget
@@ -65,7 +96,7 @@ public:
     DepthTarget(Gpu& gpu);
     virtual ~DepthTarget();
 
-    void setSize(glm::vec2 size);
+    void setSize(glm::vec2 size, uint32_t layers = 1);
 
     void        beginRender()   override;
     void        endRender()     override;
@@ -77,8 +108,70 @@ public:
 
     Texture m_depthTexture;
 
+    // Blurred exponential moments of the depth with mip levels, written by the shadow pass with ShadowFilter::Evsm
+    Texture m_momentTexture;
+
 private:
     glm::vec2 m_size = glm::vec2(0, 0);
     WGPUTextureView depthTextureView  = nullptr;
 
-};
\ No newline at end of file
+};
+
+// Renders into owned textures instead of a window, so rendering works without a display.
+// Every frame is copied into one of a ring of mappable buffers, reading back frame N overlaps
+// with rendering frame N + 1. Read back frames are handed to the readback callback.
+class OffscreenTarget: public RenderTarget
+{
+public:
+    using ReadbackCallback = std::function<void(const Image& image)>;
+
+    OffscreenTarget(Gpu& gpu, glm::vec2 size, int nrReadbackBuffers = 3);
+    virtual ~OffscreenTarget();
+
+    void setSize(glm::vec2 size);
+
+    // Receives the frames rendered after this call, once their readback completed.
+    void setReadbackCallback(ReadbackCallback callback);
+
+    // Blocks until all pending readbacks have completed.
+    void flush();
+
+    void        beginRender()   override;
+    void        endRender()     override;
+    glm::vec2   getSize() const override;
+
+    WGPUTextureView getNextTextureView() override;
+    WGPUTextureView getDepthTextureView() override;
+    WGPUTextureView getMsaaTextureView() override;
+
+    Texture m_depthTexture;
+    Texture m_msaaTexture;
+    Texture m_resolveTexture;
+
+private:
+    struct Readback
+    {
+        WGPUBuffer          buffer      = nullptr;
+        uint64_t            bufferSize  = 0;
+        glm::uvec2          size        = glm::uvec2(0, 0);
+        uint32_t            bytesPerRow = 0;
+        bool                pending     = false;
+        ReadbackCallback    callback;
+    };
+
+    Gpu&        m_gpu;
+    glm::vec2   m_size;
+
+    // Readbacks are passed as user data to the map callbacks, their addresses must be stable.
+    std::vector<std::unique_ptr<Readback>>  m_readbacks;
+    size_t                                  m_nextReadback = 0;
+    ReadbackCallback                        m_readbackCallback;
+
+    void wait(Readback& readback);
+
+    static void onBufferMapped(WGPUBufferMapAsyncStatus status, void* userData);
+
+    OffscreenTarget            (const OffscreenTarget&)   = delete;
+    OffscreenTarget& operator= (const OffscreenTarget&)   = delete;
+
+};
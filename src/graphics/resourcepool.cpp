@@ -6,7 +6,8 @@
 #include "graphics/gpu.h"
 
 ResourcePool::ResourcePool(Gpu& gpu)
-    : m_gpu(gpu)
+    : m_gpu             (gpu)
+    , m_textureStreamer (gpu)
 {
 
 }
@@ -17,34 +18,22 @@ ResourcePool::~ResourcePool()
 
 Texture& ResourcePool::get(const Image* image, bool srgb)
 {
-    auto it = m_poolTextures.find(image->getPixels());
-    if (it == m_poolTextures.end()) 
-    {
-        Texture::Params params
-        {
-            .format = srgb ? Texture::Format::RGBAsrgb : Texture::Format::RGBA,
-            .sampleCount = 1,
-            .usage = Texture::Usage::CopySrcTextureBinding
-        };
-        auto [newIt, inserted] = m_poolTextures.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(image->getPixels()),
-            std::forward_as_tuple(m_gpu, params)
-        );
+    return m_textureStreamer.get(*image, srgb);
+}
 
-        if (inserted) {
-            newIt->second.setImage(*image);
-        }
-        it = newIt;
-    }
-    return it->second;
+TextureStreamer& ResourcePool::getTextureStreamer()
+{
+    return m_textureStreamer;
 }
 
-VertexBuffer &ResourcePool::get(const Renderable *renderable)
+VertexBuffer* ResourcePool::get(const Renderable *renderable)
 {
     auto it = poolVertexBuffers.find(&renderable->mesh.vertices());
     if (it == poolVertexBuffers.end()) 
     {
+        if (!m_gpu.getUploadManager().reserve(VertexBuffer::uploadBytes(m_gpu, renderable->mesh)))
+            return nullptr;
+
         auto [newIt, inserted] = poolVertexBuffers.emplace(
             std::piecewise_construct,
             std::forward_as_tuple(&renderable->mesh.vertices()),
@@ -56,7 +45,7 @@ VertexBuffer &ResourcePool::get(const Renderable *renderable)
         }
         it = newIt;
     }
-    return it->second;
+    return &it->second;
 }
 
 Texture& ResourcePool::get(const Cubemap* cubemap)
@@ -83,3 +72,10 @@ Texture& ResourcePool::get(const Cubemap* cubemap)
     }
     return it->second;
 }
+
+void ResourcePool::clear()
+{
+    poolVertexBuffers   .clear();
+    m_textureStreamer   .clear();
+    m_poolCubemaps      .clear();
+}
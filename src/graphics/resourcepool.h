@@ -6,6 +6,7 @@
 
 #include "graphics/vertexbuffer.h"
 #include "graphics/texture.h"
+#include "graphics/texturestreamer.h"
 //#include "renderer/cubemaptexture.h"
 
 #include <map>
@@ -19,16 +20,24 @@ public:
     ResourcePool(Gpu& gpu);
     ~ResourcePool();
 
+    // Textures of images are streamed, they have the levels resident that the texture streamer made resident
     Texture&        get(const Image* image, bool srgb = false);
-    VertexBuffer&   get(const Renderable* renderable);
+
+    // Vertex buffers of new meshes are created when their upload fits in the budget of the frame, nullptr otherwise
+    VertexBuffer*   get(const Renderable* renderable);
     Texture&        get(const Cubemap* cubemap);
 
+    TextureStreamer& getTextureStreamer();
+
+    // Releases all resources, needed when the meshes and images they were created from are destroyed.
+    void clear();
+
 private:
     Gpu& m_gpu;
 
     std::map<const std::vector<Vertex>*, VertexBuffer>  poolVertexBuffers;
-    std::map<const uint8_t*, Texture>                   m_poolTextures;
     std::map<const Cubemap*, Texture>                   m_poolCubemaps;
+    TextureStreamer                                     m_textureStreamer;
 
     ResourcePool            (const ResourcePool&)   = delete;
     ResourcePool& operator= (const ResourcePool&)   = delete;
@@ -1,38 +1,148 @@
 #include "shadowpass.h"
 #include "renderpasshelpers.h"
 
+#include <cassert>
+
+namespace
+{
+    const glm::vec2 shadowMapSize = glm::vec2(2048, 2048);
+
+    // Casters whose transform didn't change for this many shadow frames go into the static cache. Animated objects
+    // stay dynamic, instead of invalidating the cache every frame.
+    const uint64_t staticFrames = 16;
+}
+
+ShadowPass::Casters::Casters(Gpu& gpu)
+    : storageModels (gpu)
+    , renderBundle  (gpu)
+{
+}
+
+ShadowPass::Cascade::Cascade(Gpu& gpu)
+    : staticCasters (gpu)
+    , dynamicCasters(gpu)
+    , lodSelector   (4.0f)
+{
+}
+
 ShadowPass::ShadowPass(Gpu & gpu, DepthTarget & target)
     : m_gpu           (gpu)
     , m_renderTarget  (target)
     , m_uniformsFrame (gpu)
-    , m_uniformsModel (gpu)
+    , m_momentPass    (gpu)
+    , m_staticDepth   (gpu, Texture::Params{ .format = Texture::Format::Depth32, .usage = Texture::Usage::RenderAttachmentCopySrc, .sampleCount = 1 })
 {
+    m_renderTarget.setSize(shadowMapSize, maxShadowCascades);
+    m_renderTarget.m_momentTexture.setSize(glm::vec3(1, 1, maxShadowCascades), 1);
+    m_uniformsFrame.setSize(maxShadowCascades);
     createPipeline();
 }
 
 ShadowPass::~ShadowPass()
 {
-    // TODO: if nothing is rendered, this throws an exception
-    for (WGPUBindGroup& group : m_bindGroups)
-        wgpuBindGroupRelease(group);
-
     wgpuPipelineLayoutRelease(m_layout);
 
     for (WGPUBindGroupLayout& layout : m_bindGroupLayouts)
+    {
+        m_gpu.getBindGroupCache().invalidate(layout);
         wgpuBindGroupLayoutRelease(layout);
+    }
 
     wgpuRenderPipelineRelease(m_pipeline);
 }
 
-void ShadowPass::render(const std::vector<const Renderable*>& renderables)
+void ShadowPass::render(const std::vector<std::vector<const Renderable*>>& casters)
+{
+    assert(casters.size() == m_cascades.size());
+
+    m_frame++;
+    for (uint32_t i = 0; i < m_cascades.size(); i++)
+    {
+        renderCascade(i, casters[i]);
+
+        Cascade& cascade = *m_cascades[i];
+        if (m_filter == ShadowFilter::Evsm && !cascade.momentsValid)
+        {
+            Texture& moments = m_renderTarget.m_momentTexture;
+            m_momentPass.record(m_gpu.m_currentCommandEncoder, m_renderTarget.m_depthTexture.getLayerView(i), moments.m_texture, i);
+            cascade.momentsValid = true;
+        }
+    }
+
+    std::erase_if(m_casterStates, [this](const auto& entry) { return entry.second.lastSeenFrame != m_frame; });
+}
+
+void ShadowPass::renderCascade(uint32_t index, const std::vector<const Renderable*>& renderables)
+{
+    Cascade& cascade = *m_cascades[index];
+    m_uniformsFrame.writeChanges(index, cascade.frameData);
+
+    // The static casters are drawn again when they or the projection changed
+    std::vector<const Renderable*> previousStatic = std::move(cascade.staticCasters.renderables);
+    splitCasters(renderables, cascade);
+    if (cascade.staticCasters.renderables != previousStatic || cascade.frameData != cascade.staticFrameData)
+    {
+        cascade.staticFrameData     = cascade.frameData;
+        cascade.staticDepthValid    = false;
+        cascade.shadowMapStatic     = false;
+    }
+
+    WGPUTextureView target = m_renderTarget.m_depthTexture.getLayerView(index);
+    if (cascade.dynamicCasters.renderables.empty())
+    {
+        if (cascade.shadowMapStatic) return;
+
+        cascade.shadowMapStatic = renderCasters(index, cascade.staticCasters, target, true);
+        cascade.momentsValid    = false;
+        return;
+    }
+
+    if (!cascade.staticDepthValid)
+    {
+        m_staticDepth.setSize(glm::vec3(shadowMapSize, maxShadowCascades));
+        cascade.staticDepthValid = renderCasters(index, cascade.staticCasters, m_staticDepth.getLayerView(index), true);
+    }
+
+    copyStaticDepth(index);
+    renderCasters(index, cascade.dynamicCasters, target, false);
+    cascade.shadowMapStatic = false;
+    cascade.momentsValid    = false;
+}
+
+void ShadowPass::splitCasters(const std::vector<const Renderable*>& renderables, Cascade& cascade)
+{
+    cascade.staticCasters.renderables.clear();
+    cascade.dynamicCasters.renderables.clear();
+
+    for (const Renderable* renderable : renderables)
+    {
+        // Casters start static, their first move makes them dynamic
+        uint64_t    version = renderable->object->transformVersion();
+        auto        found   = m_casterStates.find(renderable);
+        if (found == m_casterStates.end())
+            found = m_casterStates.emplace(renderable, CasterState { .transformVersion = version }).first;
+
+        CasterState& state = found->second;
+        state.lastSeenFrame = m_frame;
+        if (state.transformVersion != version)
+        {
+            state.transformVersion  = version;
+            state.changedFrame      = m_frame;
+        }
+
+        bool moving = state.changedFrame != 0 && m_frame - state.changedFrame < staticFrames;
+        (moving ? cascade.dynamicCasters : cascade.staticCasters).renderables.push_back(renderable);
+    }
+}
+
+bool ShadowPass::renderCasters(uint32_t index, Casters& casters, WGPUTextureView target, bool clear)
 {
-    m_renderTarget.setSize({ 2048, 2048 } );
     WGPUCommandEncoder& encoder = m_gpu.m_currentCommandEncoder;
 
     WGPURenderPassDepthStencilAttachment depthStencilAttachment{};
-    depthStencilAttachment.view             =  m_renderTarget.getDepthTextureView();
+    depthStencilAttachment.view             = target;
     depthStencilAttachment.depthClearValue  = 1.0f;
-    depthStencilAttachment.depthLoadOp      = WGPULoadOp_Clear;
+    depthStencilAttachment.depthLoadOp      = clear ? WGPULoadOp_Clear : WGPULoadOp_Load;
     depthStencilAttachment.depthStoreOp     = WGPUStoreOp_Store;
     depthStencilAttachment.depthReadOnly    = false;
     depthStencilAttachment.stencilClearValue = 0;
@@ -58,12 +168,29 @@ void ShadowPass::render(const std::vector<const Renderable*>& renderables)
 
     glm::vec2 size = m_renderTarget.getSize();
     wgpuRenderPassEncoderSetViewport(renderPass, 0, 0, size.x, size.y, 0.0, 1.0);
-    wgpuRenderPassEncoderSetPipeline(renderPass, m_pipeline);
 
-    drawCommands(renderPass, renderables);
+    bool complete = drawCommands(renderPass, index, casters);
 
     wgpuRenderPassEncoderEnd    (renderPass);
     wgpuRenderPassEncoderRelease(renderPass);
+    return complete;
+}
+
+void ShadowPass::copyStaticDepth(uint32_t index)
+{
+    WGPUImageCopyTexture source {};
+    source.texture      = m_staticDepth.m_texture;
+    source.aspect       = WGPUTextureAspect_DepthOnly;
+    source.origin.z     = index;
+
+    WGPUImageCopyTexture destination {};
+    destination.texture = m_renderTarget.m_depthTexture.m_texture;
+    destination.aspect  = WGPUTextureAspect_DepthOnly;
+    destination.origin.z = index;
+
+    // Depth textures are copied a whole layer at a time
+    WGPUExtent3D copySize = { uint32_t(shadowMapSize.x), uint32_t(shadowMapSize.y), 1 };
+    wgpuCommandEncoderCopyTextureToTexture(m_gpu.m_currentCommandEncoder, &source, &destination, &copySize);
 }
 
 void ShadowPass::createPipeline()
@@ -97,7 +224,9 @@ void ShadowPass::createPipeline()
 
     pipelineDesc.depthStencil = &m_depthStencilState;
 
-    VertexBuffer::Layout vertexLayout {};
+    // Depth only: the positions are the only vertex input and there is no fragment stage, so nothing keeps the
+    // hardware from testing depth before rasterization
+    VertexBuffer::PositionLayout vertexLayout;
     pipelineDesc.vertex.bufferCount     = 1;
     pipelineDesc.vertex.buffers         = &vertexLayout.layout;
     pipelineDesc.vertex.module          = shaderModule;
@@ -125,7 +254,7 @@ void ShadowPass::createLayout(WGPURenderPipelineDescriptor& pipeline)
     fillUniformsBindGroupLayoutEntry(entryFrameUniforms, 0, sizeof(FrameDataShadow), false);
     
     WGPUBindGroupLayoutEntry entryModelUniforms{};
-    fillUniformsBindGroupLayoutEntry(entryModelUniforms, 0, sizeof(ModelDataShadow), true);
+    fillStorageBindGroupLayoutEntry(entryModelUniforms, 0, sizeof(ModelDataShadow));
     
     WGPUBindGroupLayoutDescriptor groupLayoutFrame{};
     groupLayoutFrame.label = "grouplayoutFrame - per frame data";
@@ -147,75 +276,153 @@ void ShadowPass::createLayout(WGPURenderPipelineDescriptor& pipeline)
     pipeline.layout = m_layout;
 }
 
-void ShadowPass::createBindings()
+WGPUBindGroup ShadowPass::getFrameBindings(uint32_t cascade) const
 {
-    for (WGPUBindGroup& group : m_bindGroups) if (group != nullptr)
-        wgpuBindGroupRelease(group);
-
     WGPUBindGroupEntry entry0{};
     entry0.nextInChain = nullptr;
     entry0.binding = 0; 
     entry0.buffer = m_uniformsFrame.m_buffer;
-    entry0.offset = 0;
+    entry0.offset = m_gpu.uniformStride(sizeof(FrameDataShadow)) * cascade;
     entry0.size = sizeof(FrameDataShadow);
-    
+
+    return m_gpu.getBindGroupCache().get(m_bindGroupLayouts[0], &entry0, 1);
+}
+
+WGPUBindGroup ShadowPass::getModelBindings(const Casters& casters) const
+{
     WGPUBindGroupEntry entry1{};
     entry1.nextInChain = nullptr;
     entry1.binding = 0; 
-    entry1.buffer = m_uniformsModel.m_buffer;
+    entry1.buffer = casters.storageModels.m_buffer;
     entry1.offset = 0;
-    entry1.size = sizeof(ModelDataShadow);
-
-    WGPUBindGroupDescriptor group0{};
-    group0.nextInChain   = nullptr;
-    group0.layout        = m_bindGroupLayouts[0];
-    group0.entryCount    = 1;
-    group0.entries       = &entry0;
+    entry1.size = casters.storageModels.byteSize();
 
-    WGPUBindGroupDescriptor group1{};
-    group1.nextInChain   = nullptr;
-    group1.layout        = m_bindGroupLayouts[1];
-    group1.entryCount    = 1;
-    group1.entries       = &entry1;
-
-    m_bindGroups[0] = wgpuDeviceCreateBindGroup(m_gpu.m_device, &group0);
-    m_bindGroups[1] = wgpuDeviceCreateBindGroup(m_gpu.m_device, &group1);
+    return m_gpu.getBindGroupCache().get(m_bindGroupLayouts[1], &entry1, 1);
 }
 
 void ShadowPass::renderPre(const RenderParams& params)
 {
-    m_frameData.view                = params.view;
-    m_frameData.projection          = params.projection;
+    assert(params.cascades.size() <= maxShadowCascades);
+
+    while (m_cascades.size() < params.cascades.size())
+        m_cascades.push_back(std::make_unique<Cascade>(m_gpu));
+    m_cascades.resize(params.cascades.size());
+
+    for (size_t i = 0; i < params.cascades.size(); i++)
+    {
+        m_cascades[i]->frameData.view       = params.cascades[i].view;
+        m_cascades[i]->frameData.projection = params.cascades[i].projection;
+    }
+    m_useRenderBundles = params.useRenderBundles;
+
+    // The moments take half the resolution of the shadow map, only while they are used
+    if (params.filter != m_filter)
+    {
+        m_filter = params.filter;
+
+        Texture& moments = m_renderTarget.m_momentTexture;
+        if (m_filter == ShadowFilter::Evsm)
+            moments.setSize(glm::vec3(shadowMapSize * 0.5f, maxShadowCascades), MomentPass::mipLevelCount);
+        else
+            moments.setSize(glm::vec3(1, 1, maxShadowCascades), 1);
+
+        for (auto& cascade : m_cascades)
+            cascade->momentsValid = false;
+    }
 }
 
-void ShadowPass::drawCommands(WGPURenderPassEncoder renderPass, const std::vector<const Renderable*>& renderables)
+bool ShadowPass::drawCommands(WGPURenderPassEncoder renderPass, uint32_t index, Casters& casters)
 {
-    m_uniformsFrame.setSize(1);
-    m_uniformsFrame.writeChanges(0, m_frameData);
+    Cascade& cascade = *m_cascades[index];
 
-    m_uniformsModel.setSize(renderables.size());
+    // Shadow texels are blurred by the filtering anyway, so the shadow pass accepts a larger error than the color pass
+    LodSelector& lodSelector = cascade.lodSelector;
+    lodSelector.begin(cascade.frameData.view, cascade.frameData.projection, m_renderTarget.getSize().y);
 
-    int index = 0;
-    for (const Renderable* renderable : renderables)
+    // Only the transform is used, so all renderables sharing a vertex buffer and level of detail end up in one batch.
+    bool complete = true;
+    DrawList& drawList = casters.drawList;
+    drawList.clear();
+    for (const Renderable* renderable : casters.renderables)
     {
-        ModelDataShadow data
-        {
-            .model = renderable->object->getSpace().toRoot,
-        };
-        m_uniformsModel.writeChanges(index, data);
+        // Meshes whose upload doesn't fit in this frame cast shadows in a next one
+        if (VertexBuffer* vertexBuffer = m_gpu.getResourcePool().get(renderable))
+            drawList.add(renderable, vertexBuffer, nullptr, lodSelector.select(*renderable));
+        else
+            complete = false;
+    }
+    drawList.build();
 
-        createBindings(); 
+    casters.storageModels.setSize(drawList.instances().size());
 
-        uint32_t dataOffset = index * m_gpu.uniformStride(sizeof(ModelDataShadow));
+    int instance = 0;
+    for (const Renderable* renderable : drawList.instances())
+        casters.storageModels.set(instance++, ModelDataShadow { .model = renderable->object->getSpace().toRoot });
 
-        VertexBuffer& vertexBuffer = m_gpu.getResourcePool().get(renderable);
+    casters.storageModels.upload();
 
-        wgpuRenderPassEncoderSetBindGroup(renderPass, 0, m_bindGroups[0], 0, nullptr);
-        wgpuRenderPassEncoderSetBindGroup(renderPass, 1, m_bindGroups[1], 1, &dataOffset);
+    const WGPUBindGroup frameBindings = getFrameBindings(index);
+    const WGPUBindGroup modelBindings = getModelBindings(casters);
 
-        wgpuRenderPassEncoderSetIndexBuffer (renderPass, vertexBuffer.m_indexBuffer, WGPUIndexFormat_Uint32, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
-        wgpuRenderPassEncoderSetVertexBuffer(renderPass,  0, vertexBuffer.m_vertexBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_vertexBuffer));
-        wgpuRenderPassEncoderDrawIndexed    (renderPass, vertexBuffer.m_mesh->indices().size() * 3, 1, 0, 0, 0);
-        index++;
+    if (m_useRenderBundles)
+    {
+        recordRenderBundle(casters, frameBindings, modelBindings);
+        casters.renderBundle.execute(renderPass);
+        return complete;
     }
+
+    casters.renderBundle.release();
+
+    wgpuRenderPassEncoderSetPipeline (renderPass, m_pipeline);
+    wgpuRenderPassEncoderSetBindGroup(renderPass, 0, frameBindings, 0, nullptr);
+    wgpuRenderPassEncoderSetBindGroup(renderPass, 1, modelBindings, 0, nullptr);
+
+    for (const DrawList::Batch& batch : drawList.batches())
+    {
+        const VertexBuffer& vertexBuffer = *batch.vertexBuffer;
+
+        wgpuRenderPassEncoderSetIndexBuffer (renderPass, vertexBuffer.m_indexBuffer, vertexBuffer.m_indexFormat, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
+        wgpuRenderPassEncoderSetVertexBuffer(renderPass,  0, vertexBuffer.m_positionBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_positionBuffer));
+        wgpuRenderPassEncoderDrawIndexed    (renderPass, batch.indexCount, batch.instanceCount, batch.firstIndex, 0, batch.firstInstance);
+    }
+    return complete;
+}
+
+void ShadowPass::recordRenderBundle(Casters& casters, WGPUBindGroup frameBindings, WGPUBindGroup modelBindings)
+{
+    RenderBundle::Signature signature
+    {
+        reinterpret_cast<uint64_t>(m_pipeline),
+        reinterpret_cast<uint64_t>(frameBindings),
+        reinterpret_cast<uint64_t>(modelBindings)
+    };
+    casters.drawList.appendSignature(signature);
+
+    if (casters.renderBundle.matches(signature)) return;
+
+    WGPURenderBundleEncoderDescriptor descriptor{};
+    descriptor.label                = "shadow pass bundle";
+    descriptor.colorFormatCount     = 0;
+    descriptor.colorFormats         = nullptr;
+    descriptor.depthStencilFormat   = m_depthStencilState.format;
+    descriptor.sampleCount          = 1;
+    descriptor.depthReadOnly        = false;
+    descriptor.stencilReadOnly      = true;
+
+    WGPURenderBundleEncoder encoder = casters.renderBundle.begin(descriptor, std::move(signature));
+
+    wgpuRenderBundleEncoderSetPipeline (encoder, m_pipeline);
+    wgpuRenderBundleEncoderSetBindGroup(encoder, 0, frameBindings, 0, nullptr);
+    wgpuRenderBundleEncoderSetBindGroup(encoder, 1, modelBindings, 0, nullptr);
+
+    for (const DrawList::Batch& batch : casters.drawList.batches())
+    {
+        const VertexBuffer& vertexBuffer = *batch.vertexBuffer;
+
+        wgpuRenderBundleEncoderSetIndexBuffer (encoder, vertexBuffer.m_indexBuffer, vertexBuffer.m_indexFormat, 0, wgpuBufferGetSize(vertexBuffer.m_indexBuffer));
+        wgpuRenderBundleEncoderSetVertexBuffer(encoder,  0, vertexBuffer.m_positionBuffer, 0, wgpuBufferGetSize(vertexBuffer.m_positionBuffer));
+        wgpuRenderBundleEncoderDrawIndexed    (encoder, batch.indexCount, batch.instanceCount, batch.firstIndex, 0, batch.firstInstance);
+    }
+
+    casters.renderBundle.end(encoder);
 }
@@ -8,10 +8,24 @@
 #include "rendertarget.h"
 #include "vertexbuffer.h"
 #include "uniforms.h"
+#include "storagebuffer.h"
+#include "drawlist.h"
+#include "renderbundle.h"
+#include "lodselector.h"
 #include "renderable.h"
 #include "uniformsdata.h"
 #include "rendertarget.h"
+#include "momentpass.h"
 
+#include <memory>
+#include <unordered_map>
+
+// Renders the depth of shadow casters from the light, into one layer of the shadow map per cascade. Casters whose
+// transform didn't change for a while are static: they are rendered once into a cached depth texture, which is
+// copied into the shadow map every frame before the dynamic casters are drawn over it. The cache of a cascade is
+// rendered again when its projection changes or a caster changes between static and dynamic. Without dynamic
+// casters the shadow map itself is the cache and frames without changes don't draw the cascade at all.
+// With ShadowFilter::Evsm the layers that changed are prefiltered into the moment texture of the target.
 class ShadowPass
 {
 public:
@@ -20,22 +34,70 @@ public:
     
     struct RenderParams
     {
-        glm::mat4 view;
-        glm::mat4 projection;
+        std::vector<ShadowCascade> cascades;
+        ShadowFilter filter     = ShadowFilter::Pcf;
+        bool      useRenderBundles = true;
     };
 
     void renderPre  (const RenderParams& params);
-    void render     (const std::vector<const Renderable*>& renderables);
+
+    // Draws casters[i] into cascade i
+    void render     (const std::vector<std::vector<const Renderable*>>& casters);
 
 private:
+    // The casters drawn by one render pass, with their own model data and recorded draw calls
+    struct Casters
+    {
+        Casters(Gpu& gpu);
+
+        std::vector<const Renderable*>  renderables;
+        StorageBuffer<ModelDataShadow>  storageModels;
+        DrawList                        drawList;
+        RenderBundle                    renderBundle;
+    };
+
+    // A layer of the shadow map and its cache
+    struct Cascade
+    {
+        Cascade(Gpu& gpu);
+
+        FrameDataShadow frameData;
+        Casters         staticCasters;
+        Casters         dynamicCasters;
+        LodSelector     lodSelector;
+
+        // The static casters of the cached layer were drawn with staticFrameData, the layer of the shadow map holds
+        // only them when shadowMapStatic is set
+        FrameDataShadow staticFrameData;
+        bool            staticDepthValid    = false;
+        bool            shadowMapStatic     = false;
+
+        // Whether the layer of the moment texture was filtered from the current layer of the shadow map
+        bool            momentsValid        = false;
+    };
+
+    // When the transform of a caster changed last, in rendered shadow frames. Casters that weren't drawn in the last
+    // frame are dropped, so the map doesn't hold on to renderables that no longer exist.
+    struct CasterState
+    {
+        uint64_t    transformVersion    = 0;
+        uint64_t    changedFrame        = 0;
+        uint64_t    lastSeenFrame       = 0;
+    };
+
     Gpu&                m_gpu;
     DepthTarget&        m_renderTarget;
 
-    FrameDataShadow             m_frameData;
     Uniforms<FrameDataShadow>   m_uniformsFrame;
 
-    ModelDataShadow              m_modelData;
-    Uniforms<ModelDataShadow>    m_uniformsModel;
+    std::vector<std::unique_ptr<Cascade>>   m_cascades;
+    bool                                    m_useRenderBundles = true;
+    ShadowFilter                            m_filter           = ShadowFilter::Pcf;
+    MomentPass                              m_momentPass;
+
+    Texture                                             m_staticDepth;
+    std::unordered_map<const Renderable*, CasterState>  m_casterStates;
+    uint64_t                                            m_frame             = 0;
 
     WGPUPipelineLayout      m_layout {};
     std::array<WGPUBindGroupLayout, 2> m_bindGroupLayouts {};
@@ -43,10 +105,24 @@ private:
     WGPUDepthStencilState   m_depthStencilState {};
     WGPURenderPipeline      m_pipeline {};
 
-    std::array<WGPUBindGroup, 2> m_bindGroups { nullptr, nullptr };
-
     void createPipeline     ();
     void createLayout       (WGPURenderPipelineDescriptor& pipeline);
-    void createBindings     ();
-    void drawCommands       (WGPURenderPassEncoder ShadowPass, const std::vector<const Renderable*>& renderables);
+
+    // Bind groups are owned by the bind group cache of the gpu, they must not be released.
+    WGPUBindGroup getFrameBindings  (uint32_t cascade) const;
+    WGPUBindGroup getModelBindings  (const Casters& casters) const;
+
+    void renderCascade      (uint32_t index, const std::vector<const Renderable*>& renderables);
+
+    // Sorts the renderables into the static and dynamic casters of cascade
+    void splitCasters       (const std::vector<const Renderable*>& renderables, Cascade& cascade);
+
+    // Returns whether all casters were drawn, meshes can wait for the upload budget
+    bool renderCasters      (uint32_t index, Casters& casters, WGPUTextureView target, bool clear);
+    bool drawCommands       (WGPURenderPassEncoder renderPass, uint32_t index, Casters& casters);
+    void recordRenderBundle (Casters& casters, WGPUBindGroup frameBindings, WGPUBindGroup modelBindings);
+    void copyStaticDepth    (uint32_t index);
+
+    ShadowPass              (const ShadowPass&) = delete;
+    ShadowPass& operator=   (const ShadowPass&) = delete;
 };
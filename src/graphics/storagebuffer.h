@@ -0,0 +1,95 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+#include "gpu.h"
+
+// Array of T in a read-only storage buffer, tightly packed so shaders can index it
+// (for example by instance_index). The buffer grows geometrically and is never shrunk,
+// changed elements are collected with set() and uploaded with a single write in upload().
+template <typename T>
+class StorageBuffer
+{
+friend class RenderPass;
+friend class ShadowPass;
+
+public:
+    StorageBuffer(Gpu& gpu)
+        : m_gpu(gpu)
+    {
+    }
+
+    virtual ~StorageBuffer()
+    {
+        if (m_buffer != nullptr)
+        {
+            m_gpu.getBindGroupCache().invalidate(m_buffer);
+            wgpuBufferRelease(m_buffer);
+        }
+        m_buffer = nullptr;
+    }
+
+    // Returns true when the buffer had to be reallocated.
+    bool setSize(size_t newSize)
+    {
+        m_data.resize(newSize);
+        if (newSize <= m_capacity && m_buffer != nullptr)
+            return false;
+
+        if (m_buffer != nullptr)
+        {
+            m_gpu.getBindGroupCache().invalidate(m_buffer);
+            wgpuBufferRelease(m_buffer);
+        }
+
+        // Empty bindings are not allowed, always keep room for at least one element.
+        m_capacity = std::max({ newSize, m_capacity * 2, size_t(1) });
+
+        m_bufferDesc.size               = sizeof(T) * m_capacity;
+        m_bufferDesc.usage              = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage;
+        m_bufferDesc.mappedAtCreation   = false;
+        m_buffer = wgpuDeviceCreateBuffer(m_gpu.m_device, &m_bufferDesc);
+
+        // The new buffer has no contents yet.
+        m_dirtyBegin    = 0;
+        m_dirtyEnd      = newSize;
+        return true;
+    }
+
+    void set(size_t index, const T& data)
+    {
+        assert(index < m_data.size());
+        if (m_data[index] == data && (index < m_dirtyBegin || index >= m_dirtyEnd))
+            return;
+
+        m_data[index]   = data;
+        m_dirtyBegin    = std::min(m_dirtyBegin, index);
+        m_dirtyEnd      = std::max(m_dirtyEnd, index + 1);
+    }
+
+    // Writes the range of elements that changed since the last upload.
+    void upload()
+    {
+        m_dirtyEnd = std::min(m_dirtyEnd, m_data.size());
+        if (m_dirtyBegin < m_dirtyEnd)
+            m_gpu.getUploadManager().writeBuffer(m_buffer, sizeof(T) * m_dirtyBegin, &m_data[m_dirtyBegin], sizeof(T) * (m_dirtyEnd - m_dirtyBegin));
+
+        m_dirtyBegin    = std::numeric_limits<size_t>::max();
+        m_dirtyEnd      = 0;
+    }
+
+    // Binding size, covers the whole capacity so bind groups survive changes in size.
+    uint64_t byteSize() const
+    {
+        return m_bufferDesc.size;
+    }
+
+private:
+    Gpu&                 m_gpu;
+    WGPUBufferDescriptor m_bufferDesc{};
+    std::vector<T>       m_data{};
+    size_t               m_capacity     = 0;
+    size_t               m_dirtyBegin   = std::numeric_limits<size_t>::max();
+    size_t               m_dirtyEnd     = 0;
+
+    WGPUBuffer m_buffer = nullptr;
+};
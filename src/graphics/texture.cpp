@@ -1,8 +1,12 @@
 #include "texture.h"
 #include "graphics/gpu.h"
+#include "graphics/computepass.h"
+#include "threadpool.h"
 
 #include <webgpu/webgpu.h>
 
+#include <array>
+
 using namespace glm;
 
 Texture::Texture(Gpu& gpu, Params params)
@@ -17,8 +21,11 @@ Texture::Texture(Gpu& gpu, Params params)
         case Usage::RenderAttachment:
             wgpuUsage = WGPUTextureUsage_RenderAttachment;
             break;
+        case Usage::RenderAttachmentCopySrc:
+            wgpuUsage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc;
+            break;
         case Usage::CopySrcTextureBinding:
-            wgpuUsage = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
+            wgpuUsage = WGPUTextureUsage_CopySrc | WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
             break;
         case Usage::TextureBinding:
             wgpuUsage = WGPUTextureUsage_TextureBinding;
@@ -26,6 +33,12 @@ Texture::Texture(Gpu& gpu, Params params)
         case Usage::RenderAndBinding:
             wgpuUsage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
             break;
+        case Usage::RenderAndBindingCopyDst:
+            wgpuUsage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+            break;
+        case Usage::StorageAndBinding:
+            wgpuUsage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding;
+            break;
     }
 
     switch (params.format)
@@ -51,6 +64,42 @@ Texture::Texture(Gpu& gpu, Params params)
         case Format::RG:
             wgpuFormat = WGPUTextureFormat_RG8Unorm;
             break;
+        case Format::RGBA16F:
+            wgpuFormat = WGPUTextureFormat_RGBA16Float;
+            break;
+        case Format::BC1:
+            wgpuFormat = WGPUTextureFormat_BC1RGBAUnorm;
+            break;
+        case Format::BC1srgb:
+            wgpuFormat = WGPUTextureFormat_BC1RGBAUnormSrgb;
+            break;
+        case Format::BC3:
+            wgpuFormat = WGPUTextureFormat_BC3RGBAUnorm;
+            break;
+        case Format::BC3srgb:
+            wgpuFormat = WGPUTextureFormat_BC3RGBAUnormSrgb;
+            break;
+        case Format::BC5:
+            wgpuFormat = WGPUTextureFormat_BC5RGUnorm;
+            break;
+        case Format::BC7:
+            wgpuFormat = WGPUTextureFormat_BC7RGBAUnorm;
+            break;
+        case Format::BC7srgb:
+            wgpuFormat = WGPUTextureFormat_BC7RGBAUnormSrgb;
+            break;
+        case Format::ETC2:
+            wgpuFormat = WGPUTextureFormat_ETC2RGBA8Unorm;
+            break;
+        case Format::ETC2srgb:
+            wgpuFormat = WGPUTextureFormat_ETC2RGBA8UnormSrgb;
+            break;
+        case Format::ASTC:
+            wgpuFormat = WGPUTextureFormat_ASTC4x4Unorm;
+            break;
+        case Format::ASTCsrgb:
+            wgpuFormat = WGPUTextureFormat_ASTC4x4UnormSrgb;
+            break;
     }
     m_textureDesc.dimension     = WGPUTextureDimension_2D;
     m_textureDesc.format        = wgpuFormat;
@@ -61,13 +110,30 @@ Texture::Texture(Gpu& gpu, Params params)
 
     m_textureDesc.viewFormatCount   = 0;
     m_textureDesc.viewFormats       = nullptr;
+    m_viewFormat                    = wgpuFormat;
+
+    // Uploaded color textures are written by the compute shaders, which need an RGBA8 unorm storage view. sRGB
+    // textures get that format and are sampled through an sRGB view.
+    bool colorFormat = params.format == Format::RGBA || params.format == Format::RGBAsrgb;
+    if (colorFormat && params.usage == Usage::CopySrcTextureBinding && params.sampleCount == 1)
+    {
+        m_storageBinding                = true;
+        m_textureDesc.usage             = wgpuUsage | WGPUTextureUsage_StorageBinding;
+        m_textureDesc.format            = WGPUTextureFormat_RGBA8Unorm;
+        m_textureDesc.viewFormatCount   = 1;
+        m_textureDesc.viewFormats       = &m_viewFormat;
+    }
 }
 
 Texture::~Texture() 
 {
     if (m_texture != nullptr)
     {
+        m_gpu.getBindGroupCache().invalidate(m_textureView);
         wgpuTextureViewRelease(m_textureView);
+        releaseLayerViews();
+        if (m_uploadFlush > m_gpu.getUploadManager().flushCount())
+            m_gpu.getUploadManager().flush();
         wgpuTextureDestroy(m_texture);
         wgpuTextureRelease(m_texture);
     }
@@ -79,111 +145,135 @@ void Texture::setSize(glm::vec2 size)
     setSize(vec3(size, 1));
 }
 
-void Texture::setSize(vec3 size)
+void Texture::setSize(vec3 size, uint32_t mipLevelCount)
 {
     uvec3 newSize (static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y), static_cast<uint32_t>(size.z));
+    bool  newLevels = mipLevelCount != 0 && mipLevelCount != m_textureDesc.mipLevelCount;
 
-    if (newSize.x != m_textureDesc.size.width || newSize.y != m_textureDesc.size.height || newSize.z != m_textureDesc.size.depthOrArrayLayers)
+    if (newSize.x != m_textureDesc.size.width || newSize.y != m_textureDesc.size.height || newSize.z != m_textureDesc.size.depthOrArrayLayers || newLevels)
     {
         if (m_texture != nullptr)
         {
+            m_gpu.getBindGroupCache().invalidate(m_textureView);
             wgpuTextureViewRelease(m_textureView);
+            releaseLayerViews();
+            if (m_uploadFlush > m_gpu.getUploadManager().flushCount())
+                m_gpu.getUploadManager().flush();
             wgpuTextureDestroy(m_texture);
             wgpuTextureRelease(m_texture);
         }
 
+        if (mipLevelCount != 0)
+            m_textureDesc.mipLevelCount = mipLevelCount;
+
         m_textureDesc.size = WGPUExtent3D { .width = newSize.x, .height = newSize.y, .depthOrArrayLayers = newSize.z};
         m_texture = wgpuDeviceCreateTexture(m_gpu.m_device, &m_textureDesc);
 
         WGPUTextureViewDescriptor textureViewDesc {};
-        textureViewDesc.aspect = (m_params.format == Format::Depth24Plus || m_params.format == Format::Depth32) ? WGPUTextureAspect_DepthOnly : WGPUTextureAspect_All;
+        bool isDepth = m_params.format == Format::Depth24Plus || m_params.format == Format::Depth32;
+        textureViewDesc.aspect = isDepth ? WGPUTextureAspect_DepthOnly : WGPUTextureAspect_All;
         textureViewDesc.baseArrayLayer = 0;
         textureViewDesc.arrayLayerCount = newSize.z;
         textureViewDesc.baseMipLevel = 0;
         textureViewDesc.mipLevelCount = m_textureDesc.mipLevelCount;
-        textureViewDesc.dimension = size.z == 6 ? WGPUTextureViewDimension_Cube : WGPUTextureViewDimension_2D;
-        textureViewDesc.format = m_textureDesc.format;
+        if (newSize.z == 6 && !isDepth)
+            textureViewDesc.dimension = WGPUTextureViewDimension_Cube;
+        else
+            textureViewDesc.dimension = newSize.z > 1 ? WGPUTextureViewDimension_2DArray : WGPUTextureViewDimension_2D;
+        textureViewDesc.format = m_viewFormat;
         m_textureView = wgpuTextureCreateView(m_texture, &textureViewDesc);
     }
 }
 
-uint32_t bit_width(uint32_t m) 
-{
-    if (m == 0) 
-        return 0;
-    else 
-    { 
-        uint32_t w = 0; while (m >>= 1) ++w; return w; 
-    }
-}
-
 void Texture::writeMipMaps(
     WGPUExtent3D    textureSize,
-    int             bytesPerPixel,
     uint32_t        layer,
     uint32_t        maxMipMaps,
-    const uint8_t*  pixelData)
+    const Image&    image)
 {
-    WGPUQueue& queue = m_gpu.m_queue;
+    // Images from a scene pack or a KTX2 file carry their mip chain, others get it generated here. Block compressed
+    // images can't be filtered and keep the levels they have.
+    bool        srgb     = m_params.format == Format::RGBAsrgb;
+    bool        generate = image.mipLevelCount == 1 && maxMipMaps > 1 && !image.isBlockCompressed();
+    const Image levels   = generate ? image.generateMipMaps(maxMipMaps, srgb) : image;
 
-    m_textureDesc.mipLevelCount = std::clamp(bit_width(std::max(textureSize.width, textureSize.height)), uint32_t(1), maxMipMaps);
+    m_textureDesc.mipLevelCount = std::min(uint32_t(levels.mipLevelCount), maxMipMaps);
     setSize(vec3(textureSize.width, textureSize.height, textureSize.depthOrArrayLayers));
 
+    for (uint32_t level = 0; level < m_textureDesc.mipLevelCount; ++level) 
+        writeLevel(levels, level, level, layer);
+}
+
+void Texture::writeLevel(const Image& image, int imageLevel, uint32_t level, uint32_t layer)
+{
+    UploadManager& uploads = m_gpu.getUploadManager();
+
     WGPUImageCopyTexture destination {};
-    destination.texture = m_texture;
-    destination.origin = { 0, 0, layer};
-    destination.aspect = WGPUTextureAspect_All;
+    destination.texture  = m_texture;
+    destination.mipLevel = level;
+    destination.origin   = { 0, 0, layer};
+    destination.aspect   = WGPUTextureAspect_All;
 
-    WGPUExtent3D mipLevelSize = {textureSize.width, textureSize.height, 1};
-    std::vector<unsigned char> previousLevelPixels;
-    WGPUExtent3D previousMipLevelSize;
-    for (uint32_t level = 0; level < m_textureDesc.mipLevelCount; ++level) 
+    WGPUExtent3D mipLevelSize = {uint32_t(image.mipLevelWidth(imageLevel)), uint32_t(image.mipLevelHeight(imageLevel)), 1};
+    uint32_t     bytesPerRow  = image.bytesPerPixel * mipLevelSize.width;
+    uint32_t     blockHeight  = 1;
+
+    // Blocks are copied whole, the copy covers the physical size of levels smaller than a block
+    if (image.isBlockCompressed())
     {
-        std::vector<unsigned char> pixels(bytesPerPixel * mipLevelSize.width * mipLevelSize.height);
-        if (level == 0) 
-        {
-            memcpy(pixels.data(), pixelData, pixels.size());
-        }
-        else 
-        {
-            for (uint32_t y = 0; y < mipLevelSize.height; y++) 
-            {
-                for (uint32_t x = 0; x < mipLevelSize.width; x++) 
-                {
-                    // Get the corresponding 4 pixels from the previous level
-                    unsigned char* p00 = &previousLevelPixels[bytesPerPixel * ((2 * y + 0) * previousMipLevelSize.width + (2 * x + 0))];
-                    unsigned char* p01 = &previousLevelPixels[bytesPerPixel * ((2 * y + 0) * previousMipLevelSize.width + (2 * x + 1))];
-                    unsigned char* p10 = &previousLevelPixels[bytesPerPixel * ((2 * y + 1) * previousMipLevelSize.width + (2 * x + 0))];
-                    unsigned char* p11 = &previousLevelPixels[bytesPerPixel * ((2 * y + 1) * previousMipLevelSize.width + (2 * x + 1))];
-                    // Average
-                    unsigned char* p = &pixels[bytesPerPixel * (y * mipLevelSize.width + x)];
-                    p[0] = (p00[0] + p01[0] + p10[0] + p11[0]) / 4;
-                    p[1] = (p00[1] + p01[1] + p10[1] + p11[1]) / 4;
-                    p[2] = (p00[2] + p01[2] + p10[2] + p11[2]) / 4;
-                    p[3] = (p00[3] + p01[3] + p10[3] + p11[3]) / 4;
-                }
-            }
-        }
+        mipLevelSize.width  = (mipLevelSize.width + 3) / 4 * 4;
+        mipLevelSize.height = (mipLevelSize.height + 3) / 4 * 4;
+        bytesPerRow         = mipLevelSize.width / 4 * image.blockBytes();
+        blockHeight         = 4;
+    }
+    uploads.writeTexture(destination, image.getPixels() + image.mipLevelOffset(imageLevel), bytesPerRow, mipLevelSize, blockHeight);
+    m_uploadFlush = uploads.flushCount() + 1;
+}
+
+void Texture::copyLevels(const Texture& source, uint32_t sourceLevel, uint32_t level, uint32_t levelCount)
+{
+    WGPUCommandEncoder encoder = m_gpu.createCommandEncoder();
 
-        destination.mipLevel = level;
+    WGPUImageCopyTexture from {};
+    from.texture = source.m_texture;
+    from.aspect  = WGPUTextureAspect_All;
 
-        WGPUTextureDataLayout source{};
-        source.bytesPerRow = bytesPerPixel * mipLevelSize.width;
-        source.rowsPerImage = mipLevelSize.height;
-        wgpuQueueWriteTexture(queue, &destination, pixels.data(), pixels.size(), &source, &mipLevelSize);
+    WGPUImageCopyTexture to {};
+    to.texture   = m_texture;
+    to.aspect    = WGPUTextureAspect_All;
+
+    // Block compressed levels smaller than a block are copied at their physical size, like the uploads
+    bool blocks = m_params.format >= Format::BC1;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        from.mipLevel = sourceLevel + i;
+        to.mipLevel   = level + i;
 
-        previousLevelPixels = std::move(pixels);
-        previousMipLevelSize = mipLevelSize;
-        mipLevelSize.width /= 2;
-        mipLevelSize.height /= 2;
+        WGPUExtent3D size = {std::max(1u, m_textureDesc.size.width >> to.mipLevel), std::max(1u, m_textureDesc.size.height >> to.mipLevel), 1};
+        if (blocks)
+        {
+            size.width  = (size.width + 3) / 4 * 4;
+            size.height = (size.height + 3) / 4 * 4;
+        }
+        wgpuCommandEncoderCopyTextureToTexture(encoder, &from, &to, &size);
     }
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor{};
+    cmdBufferDescriptor.label = "texture level copy";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
+    wgpuCommandEncoderRelease(encoder);
+
+    // The source levels may have been written by uploads that are still recorded
+    m_gpu.getUploadManager().flush();
+    wgpuQueueSubmit(m_gpu.m_queue, 1, &command);
+    wgpuCommandBufferRelease(command);
 }
 
-void Texture::setImage(const Image& image)
+void Texture::setImage(const Image& image, uint32_t maxMipLevels)
 {
     if (image.type == Image::Type::R8) 
     {
-        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 1, 0, 1, image.pixels->data());
+        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 0, 1, image);
     }
 
     if (image.type == Image::Type::RG8)
@@ -191,35 +281,79 @@ void Texture::setImage(const Image& image)
         assert(image.bytesPerPixel == 2 && "Image::Type::RG8 requires 2 bytes per pixel");
         assert(m_textureDesc.format == WGPUTextureFormat_RG8Unorm && "Texture::Format::RG requires WGPUTextureFormat_RG8Unorm");
 
-        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 2, 0, 1, image.pixels->data());
+        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 0, 1, image);
     }
 
-    if (image.type == Image::Type::RGB)
+    if (writesOnGpu(image))
     {
-        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, image.bytesPerPixel, 0, 10, image.pixels->data());
+        // Only level 0 is uploaded, the conversion and the other levels are done by compute shaders
+        m_textureDesc.mipLevelCount = image.mipChainLength(maxMipLevels);
+        setSize(vec3(image.width, image.height, 1));
+
+        ComputePass& computePass = m_gpu.getComputePass();
+        computePass.writeImage      (m_texture, 0, image);
+        computePass.generateMipMaps (m_texture, m_params.format == Format::RGBAsrgb);
+        m_uploadFlush = m_gpu.getUploadManager().flushCount() + 1;
+        return;
+    }
+
+    if (image.type == Image::Type::RGB || image.type == Image::Type::RGBA16)
+    {
+        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 0, maxMipLevels, image.toRGBA());
     }
 
     if (image.type == Image::Type::RGBA)
     {
-        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 4, 0, 10, image.pixels->data());
+        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 0, maxMipLevels, image);
+    }
+
+    if (image.isBlockCompressed())
+    {
+        writeMipMaps({uint32_t(image.width), uint32_t(image.height), 1}, 0, maxMipLevels, image);
     }
 }
 
 void Texture::setCubemap(const Cubemap& cubemap)
 {
-    for (uint32_t i = 0; i < 6; ++i)
+    bool onGpu = true;
+    for (int i = 0; i < 6; i++)
+        onGpu = onGpu && writesOnGpu(cubemap.faces(i));
+
+    if (onGpu)
     {
-        const Image& image = cubemap.faces(i);
-        if (image.bytesPerPixel == 4)
-        {
-            writeMipMaps({uint32_t(image.width), uint32_t(image.height), 6}, image.bytesPerPixel, i, 10, image.pixels->data());
-        }
-        else
+        const Image& face = cubemap.faces(0);
+        m_textureDesc.mipLevelCount = face.mipChainLength(10);
+        setSize(vec3(face.width, face.height, 6));
+
+        ComputePass& computePass = m_gpu.getComputePass();
+        for (uint32_t i = 0; i < 6; ++i)
+            computePass.writeImage(m_texture, i, cubemap.faces(i));
+        computePass.generateMipMaps(m_texture, m_params.format == Format::RGBAsrgb);
+        m_uploadFlush = m_gpu.getUploadManager().flushCount() + 1;
+        return;
+    }
+
+    // The mip chains of the faces are generated in parallel, the uploads stay on this thread
+    std::array<Image, 6> faces;
+    bool srgb = m_params.format == Format::RGBAsrgb;
+    ThreadPool::shared().parallelFor(6, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
         {
-            const Image rgbaImage = image.toRGBA();
-            writeMipMaps({uint32_t(rgbaImage.width), uint32_t(rgbaImage.height), 6}, rgbaImage.bytesPerPixel, i, 10, rgbaImage.pixels->data());
+            const Image& image  = cubemap.faces(i);
+            const Image  rgba   = image.type == Image::Type::RGBA ? image : image.toRGBA();
+            faces[i] = rgba.mipLevelCount > 1 ? rgba : rgba.generateMipMaps(10, srgb);
         }
-    }
+    });
+
+    for (uint32_t i = 0; i < 6; ++i)
+        writeMipMaps({uint32_t(faces[i].width), uint32_t(faces[i].height), 6}, i, 10, faces[i]);
+}
+
+bool Texture::writesOnGpu(const Image& image) const
+{
+    bool convertible = image.type == Image::Type::RGBA || image.type == Image::Type::RGB || image.type == Image::Type::RGBA16;
+    return m_storageBinding && convertible && image.mipLevelCount == 1;
 }
 
 uint32_t Texture::mipLevelCount() const
@@ -231,3 +365,36 @@ const WGPUTextureView& Texture::getTextureView() const
 {
     return m_textureView;
 }
+
+WGPUTextureView Texture::getLayerView(uint32_t layer)
+{
+    if (m_layerViews.size() != m_textureDesc.size.depthOrArrayLayers)
+        m_layerViews.resize(m_textureDesc.size.depthOrArrayLayers, nullptr);
+
+    if (m_layerViews[layer] == nullptr)
+    {
+        WGPUTextureViewDescriptor textureViewDesc {};
+        textureViewDesc.aspect = (m_params.format == Format::Depth24Plus || m_params.format == Format::Depth32) ? WGPUTextureAspect_DepthOnly : WGPUTextureAspect_All;
+        textureViewDesc.baseArrayLayer = layer;
+        textureViewDesc.arrayLayerCount = 1;
+        textureViewDesc.baseMipLevel = 0;
+        textureViewDesc.mipLevelCount = m_textureDesc.mipLevelCount;
+        textureViewDesc.dimension = WGPUTextureViewDimension_2D;
+        textureViewDesc.format = m_viewFormat;
+        m_layerViews[layer] = wgpuTextureCreateView(m_texture, &textureViewDesc);
+    }
+    return m_layerViews[layer];
+}
+
+void Texture::releaseLayerViews()
+{
+    for (WGPUTextureView view : m_layerViews)
+    {
+        if (view != nullptr)
+        {
+            m_gpu.getBindGroupCache().invalidate(view);
+            wgpuTextureViewRelease(view);
+        }
+    }
+    m_layerViews.clear();
+}
@@ -2,6 +2,7 @@
 
 #include <webgpu/webgpu.h>
 #include <glm/glm.hpp>
+#include <vector>
 #include "image.h"
 #include "cubemap.h"
 
@@ -9,6 +10,9 @@ class Gpu;
 
 class Texture
 {
+friend class OffscreenTarget;
+friend class ShadowPass;
+
 public:
 
     enum class Format
@@ -19,15 +23,32 @@ public:
         RGBA,
         BGRA,
         R,
-        RG
+        RG,
+        RGBA16F,
+
+        // Block compressed, sampled directly from the blocks of a compressed image
+        BC1,
+        BC1srgb,
+        BC3,
+        BC3srgb,
+        BC5,
+        BC7,
+        BC7srgb,
+        ETC2,
+        ETC2srgb,
+        ASTC,
+        ASTCsrgb
     };
 
     enum class Usage
     {
         RenderAttachment,
+        RenderAttachmentCopySrc,
         TextureBinding,
         CopySrcTextureBinding,
-        RenderAndBinding
+        RenderAndBinding,
+        RenderAndBindingCopyDst,
+        StorageAndBinding
     };
 
     struct Params
@@ -41,27 +62,50 @@ public:
     ~Texture();
 
     void setSize(glm::vec2 size);
-    void setSize(glm::vec3 size);
 
-    void setImage(const Image& image);
+    // A mipLevelCount of 0 keeps the current number of levels
+    void setSize(glm::vec3 size, uint32_t mipLevelCount = 0);
+
+    // Textures with generated levels keep at most maxMipLevels of them
+    void setImage(const Image& image, uint32_t maxMipLevels = 10);
     void setCubemap(const Cubemap& cubemap);
 
+    // Uploads level imageLevel of image, which has the format of the texture, to level of the texture
+    void writeLevel(const Image& image, int imageLevel, uint32_t level, uint32_t layer = 0);
+
+    // Copies levelCount levels of source, from sourceLevel on, to the levels of the texture from level on. Both have
+    // the format and the sizes of the levels in common, and source has Usage::CopySrcTextureBinding.
+    void copyLevels(const Texture& source, uint32_t sourceLevel, uint32_t level, uint32_t levelCount);
+
     uint32_t mipLevelCount() const;
 
     const WGPUTextureView& getTextureView() const;
 
+    // A 2D view of a single array layer, to render into
+    WGPUTextureView getLayerView(uint32_t layer);
+
 private:
     Gpu&                    m_gpu;
     Params                  m_params;
-    WGPUTextureDescriptor   m_textureDesc   = {};
-    WGPUTexture             m_texture       = nullptr;
-    WGPUTextureView         m_textureView   = nullptr;
+    WGPUTextureDescriptor   m_textureDesc       = {};
+    WGPUTexture             m_texture           = nullptr;
+    WGPUTextureView         m_textureView       = nullptr;
+    WGPUTextureFormat       m_viewFormat        = WGPUTextureFormat_Undefined;
+    bool                    m_storageBinding    = false;
+    std::vector<WGPUTextureView> m_layerViews;
+
+    // The upload flush that submits the last write to the texture, it can't be destroyed before
+    uint64_t                m_uploadFlush       = 0;
 
     void writeMipMaps(
         WGPUExtent3D    textureSize,
-        int bytesPerPixel,
-        uint32_t layer,
-        uint32_t maxMipMaps,
-        const unsigned char* pixelData);
+        uint32_t        layer,
+        uint32_t        maxMipMaps,
+        const Image&    image);
+
+    // Whether image is written by the compute pass rather than uploaded with its mip chain
+    bool writesOnGpu(const Image& image) const;
+
+    void releaseLayerViews();
 
 };
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "texturestreamer.h"
+
+#include "graphics/gpu.h"
+#include "blockcompression.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Enough levels for the complete chain of any texture size
+    const int maxMipLevels = 16;
+
+    // The texture format and the device feature it needs for a block compressed image
+    std::pair<Texture::Format, WGPUFeatureName> compressedFormat(Image::Type type, bool srgb)
+    {
+        switch (type)
+        {
+            case Image::Type::BC1:  return { srgb ? Texture::Format::BC1srgb  : Texture::Format::BC1,  WGPUFeatureName_TextureCompressionBC };
+            case Image::Type::BC3:  return { srgb ? Texture::Format::BC3srgb  : Texture::Format::BC3,  WGPUFeatureName_TextureCompressionBC };
+            case Image::Type::BC5:  return { Texture::Format::BC5,                                     WGPUFeatureName_TextureCompressionBC };
+            case Image::Type::BC7:  return { srgb ? Texture::Format::BC7srgb  : Texture::Format::BC7,  WGPUFeatureName_TextureCompressionBC };
+            case Image::Type::ETC2: return { srgb ? Texture::Format::ETC2srgb : Texture::Format::ETC2, WGPUFeatureName_TextureCompressionETC2 };
+            default:                return { srgb ? Texture::Format::ASTCsrgb : Texture::Format::ASTC, WGPUFeatureName_TextureCompressionASTC };
+        }
+    }
+
+    // The finest level of image that fits in maxDimension
+    int firstFittingLevel(const Image& image, int maxDimension)
+    {
+        int level = 0;
+        while (level + 1 < image.mipLevelCount && std::max(image.mipLevelWidth(level), image.mipLevelHeight(level)) > maxDimension)
+            level++;
+        return level;
+    }
+
+    // Compressed textures need sizes that are multiples of the block size
+    bool usableLevel(const Image& image, int level)
+    {
+        return !image.isBlockCompressed() || (image.mipLevelWidth(level) % 4 == 0 && image.mipLevelHeight(level) % 4 == 0);
+    }
+
+    // Decodes compressed images, converts RGB and 16-bit images to RGBA and generates the mip chain of images without
+    // one that can't get it on the GPU
+    Image prepareSource(const Image& image, bool srgb)
+    {
+        const Image rgba = image.isBlockCompressed() ? decompressImage(image) : image.type == Image::Type::RGBA ? image : image.toRGBA();
+        return rgba.mipLevelCount > 1 ? rgba : rgba.generateMipMaps(maxMipLevels, srgb);
+    }
+}
+
+TextureStreamer::TextureStreamer(Gpu& gpu)
+    : m_gpu(gpu)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::setParams(const Params& params)
+{
+    m_params = params;
+}
+
+const TextureStreamer::Params& TextureStreamer::getParams() const
+{
+    return m_params;
+}
+
+TextureStreamer::Entry& TextureStreamer::entry(const Image& image, bool srgb)
+{
+    EntryKey key(image.getPixels(), srgb);
+    auto     found = m_entries.find(key);
+    if (found != m_entries.end()) return found->second;
+
+    Entry& entry = m_entries[key];
+    entry.format = srgb ? Texture::Format::RGBAsrgb : Texture::Format::RGBA;
+
+    // Compressed images stay compressed on devices with the format, when the levels that fit the device are
+    // usable. They are decoded in software otherwise.
+    bool compressed = false;
+    if (image.isBlockCompressed())
+    {
+        auto [format, feature]  = compressedFormat(image.type, srgb);
+        int  level              = firstFittingLevel(image, int(m_gpu.maxTextureDimension()));
+        bool fits               = std::max(image.mipLevelWidth(level), image.mipLevelHeight(level)) <= int(m_gpu.maxTextureDimension());
+
+        compressed = m_gpu.hasFeature(feature) && fits && usableLevel(image, level);
+        if (compressed)
+            entry.format = format;
+    }
+
+    // Images from scene packs and KTX2 files have their levels already. Images without levels that fit the device
+    // get them from the compute pass, others are prepared on the thread pool.
+    bool convertible = image.type == Image::Type::RGBA || image.type == Image::Type::RGB || image.type == Image::Type::RGBA16;
+    bool generated   = convertible && image.mipLevelCount == 1 && std::max(image.width, image.height) <= int(m_gpu.maxTextureDimension());
+    if (generated)
+    {
+        Texture::Params params
+        {
+            .format         = entry.format,
+            .usage          = Texture::Usage::CopySrcTextureBinding,
+            .sampleCount    = 1
+        };
+        entry.chain = std::make_unique<Texture>(m_gpu, params);
+        entry.chain->setImage(image, maxMipLevels);
+    }
+
+    if (compressed || generated || (image.type == Image::Type::RGBA && image.mipLevelCount > 1))
+    {
+        std::promise<Image> ready;
+        ready.set_value(image);
+        entry.source = ready.get_future().share();
+    }
+    else
+    {
+        entry.source = ThreadPool::shared().submit([image, srgb]() { return prepareSource(image, srgb); }).share();
+    }
+    return entry;
+}
+
+void TextureStreamer::prepare(Entry& entry)
+{
+    if (entry.prepared) return;
+
+    const Image& source = entry.source.get();
+    entry.levelCount    = entry.chain ? int(entry.chain->mipLevelCount()) : source.mipLevelCount;
+    entry.firstLevel    = firstFittingLevel(source, int(m_gpu.maxTextureDimension()));
+    entry.baseLevel     = entry.firstLevel;
+    while (entry.baseLevel + 1 < entry.levelCount && usableLevel(source, entry.baseLevel + 1) &&
+           std::max(source.mipLevelWidth(entry.baseLevel), source.mipLevelHeight(entry.baseLevel)) > m_params.residentSize)
+        entry.baseLevel++;
+
+    if (entry.chain)
+    {
+        for (int i = 0; i < entry.levelCount; i++)
+            m_stats.chainBytes += mipLevelBytes(entry, i);
+    }
+    entry.prepared = true;
+}
+
+void TextureStreamer::request(const Image& image, bool srgb, float projectedPixels)
+{
+    Entry& entry = this->entry(image, srgb);
+
+    // The level where a texel covers about a pixel, for a texture that is mapped once over the object
+    float texels = float(std::max(image.width, image.height));
+    int   level  = 0;
+    if (projectedPixels < texels)
+        level = projectedPixels > 1.0f ? int(std::floor(std::log2(texels / projectedPixels))) : INT_MAX;
+
+    if (entry.lastUsedFrame != m_frame)
+        entry.wantedLevel = level;
+    else
+        entry.wantedLevel = std::min(entry.wantedLevel, level);
+    entry.lastUsedFrame = m_frame;
+}
+
+void TextureStreamer::update()
+{
+    m_stats.uploadedBytes = 0;
+
+    // New textures get their coarse levels whatever the budget. All their sources were submitted to the thread
+    // pool by the requests before the first one is waited for.
+    std::vector<Entry*> upgrades;
+    for (auto& [key, entry] : m_entries)
+    {
+        if (entry.residentLevel < 0)
+        {
+            prepare(entry);
+            makeResident(entry, entry.baseLevel);
+        }
+        if (entry.lastUsedFrame == m_frame && neededLevel(entry) < entry.residentLevel)
+            upgrades.push_back(&entry);
+    }
+
+    // The textures that are sampled the most too coarse go first
+    std::stable_sort(upgrades.begin(), upgrades.end(), [this](const Entry* a, const Entry* b)
+    {
+        return a->residentLevel - neededLevel(*a) > b->residentLevel - neededLevel(*b);
+    });
+
+    m_streaming = false;
+    for (Entry* entry : upgrades)
+    {
+        int      level = m_params.immediate ? neededLevel(*entry) : entry->residentLevel - 1;
+        uint64_t bytes = levelBytes(*entry, level);
+        if (!m_params.immediate && !m_gpu.getUploadManager().reserve(uploadBytes(*entry, level)))
+        {
+            m_streaming = true;
+            break;
+        }
+
+        // Smaller textures further on may still fit
+        if (!makeRoom(bytes - entry->bytes, *entry)) continue;
+
+        makeResident(*entry, level);
+        m_streaming = m_streaming || level > neededLevel(*entry);
+    }
+
+    m_stats.budgetBytes     = m_params.budgetBytes;
+    m_stats.textureCount    = uint32_t(m_entries.size());
+    m_stats.pendingCount    = 0;
+    for (auto& [key, entry] : m_entries)
+    {
+        if (entry.lastUsedFrame == m_frame && neededLevel(entry) < entry.residentLevel)
+            m_stats.pendingCount++;
+    }
+
+    m_frame++;
+}
+
+bool TextureStreamer::makeRoom(uint64_t bytes, const Entry& keep)
+{
+    while (m_stats.residentBytes + bytes > m_params.budgetBytes)
+    {
+        // Textures that weren't drawn for the longest time lose their finer levels first, then the ones that were
+        // drawn this frame with finer levels than they need
+        Entry* victim = nullptr;
+        for (auto& [key, entry] : m_entries)
+        {
+            if (&entry == &keep || entry.residentLevel < 0) continue;
+
+            int level = entry.lastUsedFrame == m_frame ? neededLevel(entry) : entry.baseLevel;
+            if (entry.residentLevel >= level) continue;
+
+            if (victim == nullptr || entry.lastUsedFrame < victim->lastUsedFrame)
+                victim = &entry;
+        }
+        if (victim == nullptr) return false;
+
+        makeResident(*victim, victim->lastUsedFrame == m_frame ? neededLevel(*victim) : victim->baseLevel);
+        m_stats.evictionCount++;
+    }
+    return true;
+}
+
+void TextureStreamer::makeResident(Entry& entry, int level)
+{
+    // A texture has a fixed size and number of levels, other levels need a new one. The levels it has in common
+    // with the old texture are copied on the GPU, only the others are uploaded.
+    Texture::Params params
+    {
+        .format         = entry.format,
+        .usage          = Texture::Usage::CopySrcTextureBinding,
+        .sampleCount    = 1
+    };
+    const Image& source = entry.source.get();
+    int          count  = levelCount(entry, level);
+
+    auto texture = std::make_unique<Texture>(m_gpu, params);
+    texture->setSize(glm::vec3(source.mipLevelWidth(level), source.mipLevelHeight(level), 1), uint32_t(count));
+
+    int copyBegin = level;
+    int copyEnd   = level;
+    if (entry.texture)
+    {
+        copyBegin = std::max(level, entry.residentLevel);
+        copyEnd   = std::max(copyBegin, std::min(level + count, entry.residentLevel + levelCount(entry, entry.residentLevel)));
+        if (copyBegin < copyEnd)
+            texture->copyLevels(*entry.texture, copyBegin - entry.residentLevel, copyBegin - level, copyEnd - copyBegin);
+    }
+    for (int i = level; i < level + count; i++)
+    {
+        if (i >= copyBegin && i < copyEnd) continue;
+
+        if (entry.chain)
+            texture->copyLevels(*entry.chain, i, i - level, 1);
+        else
+            texture->writeLevel(source, i, i - level);
+    }
+
+    uint64_t bytes = levelBytes(entry, level);
+    m_stats.residentBytes   = m_stats.residentBytes - entry.bytes + bytes;
+    m_stats.uploadedBytes  += uploadBytes(entry, level);
+
+    entry.texture       = std::move(texture);
+    entry.residentLevel = level;
+    entry.bytes         = bytes;
+}
+
+int TextureStreamer::neededLevel(const Entry& entry) const
+{
+    return std::clamp(entry.wantedLevel, entry.firstLevel, entry.baseLevel);
+}
+
+int TextureStreamer::levelCount(const Entry& entry, int level) const
+{
+    // Textures keep at most 10 levels, like the ones with generated mips
+    return std::min(entry.levelCount - level, 10);
+}
+
+uint64_t TextureStreamer::mipLevelBytes(const Entry& entry, int level) const
+{
+    // Generated chains are RGBA whatever the type of the source
+    const Image& source = entry.source.get();
+    if (entry.chain)
+        return uint64_t(source.mipLevelWidth(level)) * source.mipLevelHeight(level) * 4;
+    return source.mipLevelBytes(level);
+}
+
+uint64_t TextureStreamer::levelBytes(const Entry& entry, int level) const
+{
+    uint64_t bytes = 0;
+    for (int i = level; i < level + levelCount(entry, level); i++)
+        bytes += mipLevelBytes(entry, i);
+    return bytes;
+}
+
+uint64_t TextureStreamer::uploadBytes(const Entry& entry, int level) const
+{
+    int      end   = entry.residentLevel < 0 ? level : entry.residentLevel + levelCount(entry, entry.residentLevel);
+    uint64_t bytes = 0;
+    for (int i = level; i < level + levelCount(entry, level); i++)
+    {
+        if (entry.residentLevel < 0 || i < entry.residentLevel || i >= end)
+            bytes += mipLevelBytes(entry, i);
+    }
+    return bytes;
+}
+
+Texture& TextureStreamer::get(const Image& image, bool srgb)
+{
+    Entry& entry = this->entry(image, srgb);
+    if (entry.residentLevel < 0)
+    {
+        prepare(entry);
+        makeResident(entry, entry.baseLevel);
+    }
+    return *entry.texture;
+}
+
+bool TextureStreamer::isStreaming() const
+{
+    return m_streaming;
+}
+
+const TextureStreamer::Stats& TextureStreamer::getStats() const
+{
+    return m_stats;
+}
+
+void TextureStreamer::clear()
+{
+    m_entries.clear();
+    m_stats.residentBytes   = 0;
+    m_stats.chainBytes      = 0;
+    m_stats.textureCount    = 0;
+    m_stats.pendingCount    = 0;
+    m_streaming             = false;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "image.h"
+#include "graphics/texture.h"
+
+#include <future>
+#include <map>
+#include <memory>
+
+class Gpu;
+
+// Keeps the textures of images resident at the mip levels the frame needs, within a budget of video memory.
+// A texture starts with its coarse levels, up to Params::residentSize, so objects appear immediately. Textures
+// that are sampled finer than that get one more level per frame, within the upload budget of the frame, until their
+// projected size is covered. Only the new level is uploaded, the others are copied from the previous texture. When the
+// budget is exceeded, textures that weren't drawn, or have finer levels than they need, go back to coarser levels.
+// Images without a mip chain get it generated by the compute pass, in a texture the levels are copied from. Sources
+// larger than the device supports start at the first level that fits.
+class TextureStreamer
+{
+public:
+    struct Params
+    {
+        uint64_t    budgetBytes         = uint64_t(512) << 20;
+
+        // Largest size of the levels that are uploaded on first use and never evicted
+        int         residentSize        = 128;
+
+        // Makes the needed levels resident in the frame they are requested, for offscreen rendering
+        bool        immediate           = false;
+    };
+
+    struct Stats
+    {
+        uint64_t    budgetBytes     = 0;
+        uint64_t    residentBytes   = 0;
+        uint64_t    uploadedBytes   = 0;    // New levels in the last update, without the ones copied from a previous texture
+        uint64_t    chainBytes      = 0;    // Generated mip chains the levels are copied from, outside the budget
+        uint32_t    textureCount    = 0;
+        uint32_t    pendingCount    = 0;    // Textures with coarser levels than they need
+        uint32_t    evictionCount   = 0;    // Since the streamer was created
+    };
+
+    TextureStreamer(Gpu& gpu);
+    ~TextureStreamer();
+
+    void            setParams(const Params& params);
+    const Params&   getParams() const;
+
+    // Registers that image is drawn projectedPixels wide this frame, sampled as sRGB color or as linear data
+    void request(const Image& image, bool srgb, float projectedPixels);
+
+    // Uploads the levels requested since the last update, and evicts levels to stay within the budget
+    void update();
+
+    // Returns the texture of image, with the levels resident so far
+    Texture& get(const Image& image, bool srgb);
+
+    // Whether requested levels wait for the upload budget of the next frames
+    bool isStreaming() const;
+
+    const Stats& getStats() const;
+
+    // Releases all textures
+    void clear();
+
+private:
+    struct Entry
+    {
+        // The pixels with their complete mip chain, in the format of the texture. Prepared on the thread pool.
+        std::shared_future<Image>   source;
+        bool                        prepared        = false;
+
+        // The mip chain of an image without one, generated on the GPU. The source is level 0 then.
+        std::unique_ptr<Texture>    chain;
+        int                         levelCount      = 0;
+
+        Texture::Format             format          = Texture::Format::RGBA;
+        std::unique_ptr<Texture>    texture;
+        int                         firstLevel      = 0;    // The finest level the device supports
+        int                         baseLevel       = 0;    // The coarsest level, resident from the start
+        int                         residentLevel   = -1;
+        uint64_t                    bytes           = 0;
+
+        int                         wantedLevel     = 0;
+        uint64_t                    lastUsedFrame   = 0;
+    };
+
+    Gpu&                            m_gpu;
+    Params                          m_params;
+    Stats                           m_stats;
+    uint64_t                        m_frame         = 1;
+    bool                            m_streaming     = false;
+
+    // Keyed by the pixels and the color space, an image sampled both as sRGB color and as linear data gets two
+    using EntryKey = std::pair<const uint8_t*, bool>;
+
+    std::map<EntryKey, Entry>       m_entries;
+
+    Entry&      entry           (const Image& image, bool srgb);
+    void        prepare         (Entry& entry);
+    void        makeResident    (Entry& entry, int level);
+    bool        makeRoom        (uint64_t bytes, const Entry& keep);
+    int         neededLevel     (const Entry& entry) const;
+    int         levelCount      (const Entry& entry, int level) const;
+    uint64_t    mipLevelBytes   (const Entry& entry, int level) const;
+
+    // The bytes of a texture from level on, and the part of them the resident texture doesn't have
+    uint64_t    levelBytes      (const Entry& entry, int level) const;
+    uint64_t    uploadBytes     (const Entry& entry, int level) const;
+
+    TextureStreamer             (const TextureStreamer&)    = delete;
+    TextureStreamer& operator=  (const TextureStreamer&)    = delete;
+};
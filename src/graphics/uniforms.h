@@ -18,7 +18,10 @@ public:
     virtual ~Uniforms()
     {
         if (m_buffer != nullptr)
+        {
+            m_gpu.getBindGroupCache().invalidate(m_buffer);
             wgpuBufferRelease(m_buffer);
+        }
         m_buffer = nullptr;
     }
 
@@ -28,7 +31,10 @@ public:
             return false;
 
         if (m_buffer != nullptr)
+        {
+            m_gpu.getBindGroupCache().invalidate(m_buffer);
             wgpuBufferRelease(m_buffer);
+        }
 
         uint32_t stride = m_gpu.uniformStride(sizeof(T));
         m_bufferDesc.size               = stride * newSize;
@@ -47,7 +53,7 @@ public:
         uint32_t stride = m_gpu.uniformStride(sizeof(T));
         uint32_t offset = stride * index;
         if (m_lastWrittenData[index] != data || !m_initialized[index])
-            wgpuQueueWriteBuffer(m_gpu.m_queue, m_buffer, offset, &data, sizeof(T));
+            m_gpu.getUploadManager().writeBuffer(m_buffer, offset, &data, sizeof(T));
 
         m_initialized[index]     = true;
         m_lastWrittenData[index] = data;
@@ -1,14 +1,24 @@
 #include "uniformsdata.h"
 
+#include <algorithm>
+#include <iterator>
+
 bool FrameData::operator==(const FrameData& other) const
 {
     return 
         view == other.view &&
         projection == other.projection &&
-        shadowViewProjection == other.shadowViewProjection &&
+        shadowView == other.shadowView &&
         viewPositionWorld == other.viewPositionWorld &&
         lightPositionWorld == other.lightPositionWorld &&
-        hasEnvironmentMap == other.hasEnvironmentMap;
+        std::equal(std::begin(cascadeScales), std::end(cascadeScales), std::begin(other.cascadeScales)) &&
+        std::equal(std::begin(cascadeOffsets), std::end(cascadeOffsets), std::begin(other.cascadeOffsets)) &&
+        cascadeSplits == other.cascadeSplits &&
+        cascadeBias == other.cascadeBias &&
+        nrPoissonSamples == other.nrPoissonSamples &&
+        hasEnvironmentMap == other.hasEnvironmentMap &&
+        nrShadowCascades == other.nrShadowCascades &&
+        shadowFilter == other.shadowFilter;
 }
 
 bool FrameData::operator!=(const FrameData& other) const
@@ -20,7 +30,7 @@ bool ModelData::operator==(const ModelData& other) const
 {
     return 
         model == other.model &&
-        modelInverseTranspose == other.modelInverseTranspose;
+        modelInverseTranspose == other.modelInverseTranspose &&
         baseColorFactor == other.baseColorFactor &&
         hasBaseColorTexture == other.hasBaseColorTexture &&
         hasOcclusionTexture == other.hasOcclusionTexture &&
@@ -2,17 +2,36 @@
 
 #include <glm/glm.hpp>
 
+// Layers of the shadow map, as many as the components of FrameData::cascadeSplits
+const int maxShadowCascades = 4;
+
+// How colorpass.wgsl filters the shadow map, the values of FrameData::shadowFilter
+enum class ShadowFilter : uint32_t
+{
+    Pcf     = 0,    // Adaptive percentage closer filtering of the depth
+    Evsm    = 1     // A single filtered sample of prefiltered exponential variance moments
+};
+
 struct FrameData
 {
     glm::mat4 view                  = glm::mat4(1.0);
     glm::mat4 projection            = glm::mat4(1.0);
-    glm::mat4 shadowViewProjection  = glm::mat4(1.0);
+    glm::mat4 shadowView            = glm::mat4(1.0);   // Shared by all cascades
     glm::vec4 viewPositionWorld     = glm::vec4(0.0);
     glm::vec4 lightPositionWorld    = glm::vec4(0.0);
-    uint32_t  nrPoissonSamples      = 0;
+
+    // Map positions in shadow view space to shadow map coordinates and depth, per cascade
+    glm::vec4 cascadeScales[maxShadowCascades]  = {glm::vec4(0.0), glm::vec4(0.0), glm::vec4(0.0), glm::vec4(0.0)};
+    glm::vec4 cascadeOffsets[maxShadowCascades] = {glm::vec4(0.0), glm::vec4(0.0), glm::vec4(0.0), glm::vec4(0.0)};
+
+    glm::vec4 cascadeSplits         = glm::vec4(0.0);   // Distance along the view direction where each cascade ends
+    glm::vec4 cascadeBias           = glm::vec4(0.0);   // Depth bias of each cascade in its depth range
+    uint32_t  nrPoissonSamples      = 0;                // Shadow filter samples of penumbra fragments, up to 32
     uint32_t  hasEnvironmentMap     = 0;
     uint32_t  mipLevelCount         = 0;
-    uint32_t  padding[1]            = {0};
+    uint32_t  nrShadowCascades      = 0;
+    uint32_t  shadowFilter          = 0;
+    uint32_t  padding[3]            = {0, 0, 0};
 
     bool operator==(const FrameData& other) const;
     bool operator!=(const FrameData& other) const;
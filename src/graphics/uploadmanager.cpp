@@ -0,0 +1,259 @@
+#include "uploadmanager.h"
+
+#include "graphics/gpu.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+UploadManager::UploadManager(Gpu& gpu, uint64_t stagingBufferSize, int nrStagingBuffers)
+    : m_gpu                 (gpu)
+    , m_stagingBufferSize   (stagingBufferSize)
+{
+    for (int i = 0; i < nrStagingBuffers; i++)
+    {
+        auto staging = std::make_unique<Staging>();
+        staging->manager = this;
+        m_staging.push_back(std::move(staging));
+    }
+}
+
+UploadManager::~UploadManager()
+{
+    if (m_encoder != nullptr)
+        wgpuCommandEncoderRelease(m_encoder);
+
+    for (auto& staging : m_staging)
+    {
+        while (staging->pending)
+            m_gpu.processEvents();
+
+        if (staging->buffer != nullptr)
+        {
+            wgpuBufferDestroy(staging->buffer);
+            wgpuBufferRelease(staging->buffer);
+        }
+    }
+}
+
+void UploadManager::writeBuffer(WGPUBuffer buffer, uint64_t offset, const void* data, uint64_t size)
+{
+    assert(offset % 4 == 0 && size % 4 == 0 && "Buffer uploads need offsets and sizes that are multiples of 4");
+
+    // Large writes are split over the staging buffers
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0)
+    {
+        uint64_t    chunk = std::min(size, m_stagingBufferSize);
+        WGPUBuffer  source;
+        uint64_t    sourceOffset;
+        std::memcpy(allocate(chunk, 4, source, sourceOffset), bytes, chunk);
+
+        wgpuCommandEncoderCopyBufferToBuffer(encoder(), source, sourceOffset, buffer, offset, chunk);
+
+        bytes       += chunk;
+        offset      += chunk;
+        size        -= chunk;
+        m_frameBytes += chunk;
+    }
+}
+
+void UploadManager::writeTexture(const WGPUImageCopyTexture& destination, const void* data, uint32_t bytesPerRow,
+                                 const WGPUExtent3D& size, uint32_t blockHeight)
+{
+    // Texture copies read rows at a pitch of a multiple of 256 bytes, staging buffers that can't hold a single row
+    // leave the write to the queue
+    uint32_t pitch  = (bytesPerRow + 255) & ~255u;
+    uint32_t rows   = size.height / blockHeight;
+    if (pitch > m_stagingBufferSize)
+    {
+        WGPUTextureDataLayout layout {};
+        layout.bytesPerRow  = bytesPerRow;
+        layout.rowsPerImage = rows;
+        wgpuQueueWriteTexture(m_gpu.m_queue, &destination, data, size_t(bytesPerRow) * rows, &layout, &size);
+        return;
+    }
+
+    // Large levels are split in bands of rows over the staging buffers
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (uint32_t row = 0; row < rows;)
+    {
+        uint32_t    bandRows = uint32_t(std::min<uint64_t>(rows - row, m_stagingBufferSize / pitch));
+        WGPUBuffer  source;
+        uint64_t    sourceOffset;
+        uint8_t*    staged = allocate(uint64_t(pitch) * bandRows, 256, source, sourceOffset);
+        for (uint32_t i = 0; i < bandRows; i++)
+            std::memcpy(staged + size_t(i) * pitch, bytes + size_t(row + i) * bytesPerRow, bytesPerRow);
+
+        WGPUImageCopyBuffer copySource {};
+        copySource.buffer               = source;
+        copySource.layout.offset        = sourceOffset;
+        copySource.layout.bytesPerRow   = pitch;
+        copySource.layout.rowsPerImage  = bandRows;
+
+        WGPUImageCopyTexture copyDestination = destination;
+        copyDestination.origin.y = destination.origin.y + row * blockHeight;
+
+        WGPUExtent3D bandSize = { size.width, bandRows * blockHeight, 1 };
+        wgpuCommandEncoderCopyBufferToTexture(encoder(), &copySource, &copyDestination, &bandSize);
+
+        row          += bandRows;
+        m_frameBytes += uint64_t(bytesPerRow) * bandRows;
+    }
+}
+
+uint8_t* UploadManager::allocate(uint64_t bytes, uint64_t alignment, WGPUBuffer& buffer, uint64_t& offset)
+{
+    assert(bytes <= m_stagingBufferSize);
+
+    uint64_t aligned = m_current != nullptr ? (m_current->used + alignment - 1) / alignment * alignment : 0;
+    if (m_current == nullptr || aligned + bytes > m_stagingBufferSize)
+    {
+        m_current   = &nextStaging();
+        aligned     = 0;
+    }
+
+    m_current->used     = aligned + bytes;
+    m_current->recorded = true;
+
+    buffer  = m_current->buffer;
+    offset  = aligned;
+    return m_current->mapped + aligned;
+}
+
+UploadManager::Staging& UploadManager::nextStaging()
+{
+    Staging& staging = *m_staging[m_nextStaging];
+    m_nextStaging = (m_nextStaging + 1) % m_staging.size();
+
+    // All staging buffers were used since the last flush, their copies are submitted to free them
+    if (staging.recorded)
+        flush();
+
+    // All buffers of the ring are in flight, wait for the oldest one.
+    while (staging.pending)
+        m_gpu.processEvents();
+
+    if (staging.buffer == nullptr)
+    {
+        WGPUBufferDescriptor bufferDesc{};
+        bufferDesc.label            = "staging buffer";
+        bufferDesc.size             = m_stagingBufferSize;
+        bufferDesc.usage            = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+        bufferDesc.mappedAtCreation = true;
+        staging.buffer = wgpuDeviceCreateBuffer(m_gpu.m_device, &bufferDesc);
+        staging.mapped = static_cast<uint8_t*>(wgpuBufferGetMappedRange(staging.buffer, 0, m_stagingBufferSize));
+    }
+
+    staging.used = 0;
+    return staging;
+}
+
+WGPUCommandEncoder UploadManager::encoder()
+{
+    if (m_encoder == nullptr)
+    {
+        WGPUCommandEncoderDescriptor encoderDesc{};
+        encoderDesc.label = "upload encoder";
+        m_encoder = wgpuDeviceCreateCommandEncoder(m_gpu.m_device, &encoderDesc);
+    }
+    return m_encoder;
+}
+
+void UploadManager::flush()
+{
+    if (m_encoder == nullptr) return;
+
+    // Staging buffers can't be mapped while the copies read them
+    for (auto& staging : m_staging)
+    {
+        if (staging->recorded)
+        {
+            wgpuBufferUnmap(staging->buffer);
+            staging->mapped = nullptr;
+        }
+    }
+
+    WGPUCommandBufferDescriptor commandDesc{};
+    commandDesc.label = "upload commands";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(m_encoder, &commandDesc);
+    wgpuCommandEncoderRelease(m_encoder);
+    wgpuQueueSubmit(m_gpu.m_queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    m_encoder = nullptr;
+    m_flushCount++;
+
+    for (auto& staging : m_staging)
+    {
+        if (staging->recorded)
+        {
+            staging->recorded   = false;
+            staging->pending    = true;
+            staging->used       = 0;
+            wgpuBufferMapAsync(staging->buffer, WGPUMapMode_Write, 0, m_stagingBufferSize, onBufferMapped, staging.get());
+        }
+    }
+    m_current = nullptr;
+}
+
+void UploadManager::onBufferMapped(WGPUBufferMapAsyncStatus status, void* userData)
+{
+    Staging& staging = *reinterpret_cast<Staging*>(userData);
+    staging.pending = false;
+
+    if (status != WGPUBufferMapAsyncStatus_Success)
+    {
+        // The buffer is replaced when it is used next
+        std::cerr << "Could not map staging buffer: " << status << std::endl;
+        wgpuBufferRelease(staging.buffer);
+        staging.buffer = nullptr;
+        return;
+    }
+
+    uint64_t size = staging.manager->m_stagingBufferSize;
+    staging.mapped = static_cast<uint8_t*>(wgpuBufferGetMappedRange(staging.buffer, 0, size));
+}
+
+uint64_t UploadManager::flushCount() const
+{
+    return m_flushCount;
+}
+
+void UploadManager::beginFrame()
+{
+    m_frameBytes    = 0;
+    m_reservedBytes = 0;
+    m_deferred      = false;
+}
+
+bool UploadManager::reserve(uint64_t bytes)
+{
+    if (m_reservedBytes > 0 && m_reservedBytes + bytes > m_frameBudget)
+    {
+        m_deferred = true;
+        return false;
+    }
+    m_reservedBytes += bytes;
+    return true;
+}
+
+bool UploadManager::hasDeferred() const
+{
+    return m_deferred;
+}
+
+void UploadManager::setFrameBudget(uint64_t bytes)
+{
+    m_frameBudget = bytes;
+}
+
+uint64_t UploadManager::getFrameBudget() const
+{
+    return m_frameBudget;
+}
+
+uint64_t UploadManager::frameBytes() const
+{
+    return m_frameBytes;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Gpu;
+
+// Uploads to buffers and textures go through a ring of staging buffers that stay mapped for writing: the data is
+// copied into the mapped memory right away and a copy command is recorded for it. The recorded copies are submitted
+// in one command buffer by flush(), which the gpu calls before it submits the commands of a frame, so they are done
+// before anything that is drawn with them. After a submission the staging buffers are mapped again asynchronously,
+// when all of them are in flight the oldest one is waited for.
+//
+// Uploads that can wait, like new meshes and finer texture levels, first ask for room in the byte budget of the
+// frame. The first one of a frame always gets it, so large uploads make progress.
+class UploadManager
+{
+public:
+    UploadManager(Gpu& gpu, uint64_t stagingBufferSize = uint64_t(4) << 20, int nrStagingBuffers = 3);
+    ~UploadManager();
+
+    // Writes size bytes to buffer at offset, both multiples of 4
+    void writeBuffer(WGPUBuffer buffer, uint64_t offset, const void* data, uint64_t size);
+
+    // Writes rows of bytesPerRow bytes to a region of size texels of a texture level. A row is blockHeight texels
+    // high, 4 for block compressed formats.
+    void writeTexture(const WGPUImageCopyTexture& destination, const void* data, uint32_t bytesPerRow,
+                      const WGPUExtent3D& size, uint32_t blockHeight = 1);
+
+    // Submits the copies recorded so far
+    void flush();
+
+    // Number of flushes so far, a destination written after the last flush must not be destroyed before the next one
+    uint64_t flushCount() const;
+
+    // Starts the byte budget of a new frame
+    void beginFrame();
+
+    // Takes bytes out of the budget of the frame, returns false when they have to wait for a next frame
+    bool reserve(uint64_t bytes);
+
+    // Whether uploads were deferred to a next frame since beginFrame()
+    bool hasDeferred() const;
+
+    void        setFrameBudget(uint64_t bytes);
+    uint64_t    getFrameBudget() const;
+
+    // Bytes copied through the staging buffers since beginFrame()
+    uint64_t    frameBytes() const;
+
+private:
+    struct Staging
+    {
+        UploadManager*  manager     = nullptr;
+        WGPUBuffer      buffer      = nullptr;
+        uint8_t*        mapped      = nullptr;
+        uint64_t        used        = 0;
+        bool            recorded    = false;    // Has copies in the encoder that weren't submitted yet
+        bool            pending     = false;    // Waits to be mapped again
+    };
+
+    Gpu&                        m_gpu;
+    uint64_t                    m_stagingBufferSize;
+
+    // Staging buffers are passed as user data to the map callbacks, their addresses must be stable.
+    std::vector<std::unique_ptr<Staging>>   m_staging;
+    size_t                                  m_nextStaging   = 0;
+    Staging*                                m_current       = nullptr;
+
+    WGPUCommandEncoder          m_encoder           = nullptr;
+    uint64_t                    m_flushCount        = 0;
+
+    uint64_t                    m_frameBudget       = uint64_t(16) << 20;
+    uint64_t                    m_frameBytes        = 0;
+    uint64_t                    m_reservedBytes     = 0;
+    bool                        m_deferred          = false;
+
+    // Returns room for bytes at an offset aligned to alignment, bytes is at most the staging buffer size
+    uint8_t*    allocate        (uint64_t bytes, uint64_t alignment, WGPUBuffer& buffer, uint64_t& offset);
+    Staging&    nextStaging     ();
+    WGPUCommandEncoder encoder  ();
+
+    static void onBufferMapped(WGPUBufferMapAsyncStatus status, void* userData);
+
+    UploadManager               (const UploadManager&)  = delete;
+    UploadManager& operator=    (const UploadManager&)  = delete;
+};
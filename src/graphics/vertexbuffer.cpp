@@ -1,4 +1,5 @@
 #include "vertexbuffer.h"
+#include <algorithm>
 #include <vector>
 
 #include "graphics/gpu.h"
@@ -11,9 +12,11 @@ VertexBuffer::VertexBuffer(Gpu &gpu)
 VertexBuffer::~VertexBuffer() 
 {
     wgpuBufferRelease(m_vertexBuffer);
+    wgpuBufferRelease(m_positionBuffer);
     wgpuBufferRelease(m_indexBuffer);
-    m_vertexBuffer  = nullptr;
-    m_indexBuffer   = nullptr;
+    m_vertexBuffer      = nullptr;
+    m_positionBuffer    = nullptr;
+    m_indexBuffer       = nullptr;
 }
 
 void VertexBuffer::setMesh(const Mesh *mesh) 
@@ -24,6 +27,12 @@ void VertexBuffer::setMesh(const Mesh *mesh)
         m_vertexBuffer = nullptr;
     }
 
+    if (m_positionBuffer != nullptr)
+    {
+        wgpuBufferRelease(m_positionBuffer);
+        m_positionBuffer = nullptr;
+    }
+
     if (m_indexBuffer != nullptr)
     {
         wgpuBufferRelease(m_indexBuffer);
@@ -31,33 +40,143 @@ void VertexBuffer::setMesh(const Mesh *mesh)
     }
 
     m_mesh = mesh;
+    UploadManager& uploads = m_gpu.getUploadManager();
+
+    // Write vertex buffer, the vertices are quantized on upload so the meshes keep full precision
+    std::vector<PackedVertex> packedVertices;
+    const void* vertexData = mesh->vertices().data();
+    size_t      vertexSize = sizeof(Vertex);
+    if (m_gpu.m_vertexFormat == Format::Packed)
+    {
+        packedVertices.reserve(mesh->vertices().size());
+        for (const Vertex& vertex: mesh->vertices())
+            packedVertices.push_back(PackedVertex::pack(vertex));
+
+        vertexData = packedVertices.data();
+        vertexSize = sizeof(PackedVertex);
+    }
 
-    // Write vertex buffer
     WGPUBufferDescriptor bufferDesc{};
     bufferDesc.nextInChain          = nullptr;
-    bufferDesc.size                 = mesh->vertices().size() * sizeof(Vertex);
+    bufferDesc.size                 = mesh->vertices().size() * vertexSize;
     bufferDesc.usage                = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex;
     bufferDesc.mappedAtCreation     = false;
 
     m_vertexBuffer = wgpuDeviceCreateBuffer(m_gpu.m_device, &bufferDesc);
-    wgpuQueueWriteBuffer(m_gpu.m_queue, m_vertexBuffer, 0, mesh->vertices().data(), bufferDesc.size);
+    uploads.writeBuffer(m_vertexBuffer, 0, vertexData, bufferDesc.size);
+
+    // Write position buffer, depth-only passes read 12 bytes per vertex instead of the whole vertex
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh->vertices().size());
+    for (const Vertex& vertex: mesh->vertices())
+        positions.push_back(glm::vec3(vertex.position));
+
+    WGPUBufferDescriptor positionBufferDesc{};
+    positionBufferDesc.nextInChain      = nullptr;
+    positionBufferDesc.size             = positions.size() * sizeof(glm::vec3);
+    positionBufferDesc.usage            = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex;
+    positionBufferDesc.mappedAtCreation = false;
+
+    m_positionBuffer = wgpuDeviceCreateBuffer(m_gpu.m_device, &positionBufferDesc);
+    uploads.writeBuffer(m_positionBuffer, 0, positions.data(), positionBufferDesc.size);
+
+    // Write index buffer, the levels of detail follow the full mesh. With 16-bit indices when all vertices can be
+    // addressed by them.
+    std::vector<const std::vector<glm::u32vec3>*> levels { &mesh->indices() };
+    for (const MeshLod& lod: mesh->lods())
+        levels.push_back(&lod.indices);
+
+    m_lods.clear();
+    uint32_t indexCount = 0;
+    for (const std::vector<glm::u32vec3>* level: levels)
+    {
+        m_lods.push_back(IndexRange { .firstIndex = indexCount, .indexCount = uint32_t(level->size() * 3) });
+        indexCount += level->size() * 3;
+    }
+
+    m_indexFormat = mesh->vertices().size() <= 65536 ? WGPUIndexFormat_Uint16 : WGPUIndexFormat_Uint32;
+    size_t indexSize = m_indexFormat == WGPUIndexFormat_Uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
 
-    // Write index buffer
     WGPUBufferDescriptor indexBufferDesc{};
     indexBufferDesc.nextInChain          = nullptr;
-    indexBufferDesc.size                 = mesh->indices().size() * sizeof(glm::u32vec3);
+    indexBufferDesc.size                 = indexCount * indexSize;
     indexBufferDesc.size                 = (indexBufferDesc.size + 3) & ~3; // round up to the next multiple of 4
     indexBufferDesc.usage                = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index;
     indexBufferDesc.mappedAtCreation     = false;
 
     m_indexBuffer = wgpuDeviceCreateBuffer(m_gpu.m_device, &indexBufferDesc);
-    wgpuQueueWriteBuffer(m_gpu.m_queue, m_indexBuffer, 0, mesh->indices().data(), indexBufferDesc.size);
+
+    if (m_indexFormat == WGPUIndexFormat_Uint16)
+    {
+        std::vector<uint16_t> shortIndices;
+        shortIndices.reserve(indexBufferDesc.size / sizeof(uint16_t));
+        for (const std::vector<glm::u32vec3>* level: levels)
+            for (const glm::u32vec3& triangle: *level)
+                shortIndices.insert(shortIndices.end(), { uint16_t(triangle.x), uint16_t(triangle.y), uint16_t(triangle.z) });
+        shortIndices.resize(indexBufferDesc.size / sizeof(uint16_t));
+
+        uploads.writeBuffer(m_indexBuffer, 0, shortIndices.data(), indexBufferDesc.size);
+        return;
+    }
+
+    // 32-bit levels are a multiple of 4 bytes, they are written where they are
+    for (size_t i = 0; i < levels.size(); i++)
+        uploads.writeBuffer(m_indexBuffer, m_lods[i].firstIndex * sizeof(uint32_t), levels[i]->data(), levels[i]->size() * sizeof(glm::u32vec3));
+}
+
+uint64_t VertexBuffer::uploadBytes(const Gpu& gpu, const Mesh& mesh)
+{
+    size_t indexCount = mesh.indices().size();
+    for (const MeshLod& lod: mesh.lods())
+        indexCount += lod.indices.size();
+
+    size_t vertexSize = gpu.m_vertexFormat == Format::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    size_t indexSize  = mesh.vertices().size() <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+    return uint64_t(mesh.vertices().size()) * (vertexSize + sizeof(glm::vec3)) + uint64_t(indexCount) * 3 * indexSize;
 }
 
 const Mesh &VertexBuffer::getMesh() const { return *m_mesh; }
 
-VertexBuffer::Layout::Layout()
+int VertexBuffer::lodCount() const
+{
+    return int(m_lods.size());
+}
+
+const VertexBuffer::IndexRange& VertexBuffer::lod(int level) const
 {
+    return m_lods[std::clamp(level, 0, int(m_lods.size()) - 1)];
+}
+
+VertexBuffer::Layout::Layout(Format format)
+{
+    if (format == Format::Packed)
+    {
+        // Position, a vec4f in the shaders with w = 1
+        vertexAttribs[0].shaderLocation = 0;
+        vertexAttribs[0].format = WGPUVertexFormat::WGPUVertexFormat_Float32x3;
+        vertexAttribs[0].offset = offsetof(PackedVertex, position);
+
+        // Octahedral encoded normal
+        vertexAttribs[1].shaderLocation = 1;
+        vertexAttribs[1].format = WGPUVertexFormat::WGPUVertexFormat_Snorm16x2;
+        vertexAttribs[1].offset = offsetof(PackedVertex, normal);
+
+        // Tangent and handedness, there is no bitangent at location 3
+        vertexAttribs[2].shaderLocation = 2;
+        vertexAttribs[2].format = WGPUVertexFormat::WGPUVertexFormat_Snorm8x4;
+        vertexAttribs[2].offset = offsetof(PackedVertex, tangent);
+
+        vertexAttribs[3].shaderLocation = 4;
+        vertexAttribs[3].format = WGPUVertexFormat::WGPUVertexFormat_Float16x2;
+        vertexAttribs[3].offset = offsetof(PackedVertex, uv);
+
+        layout.attributeCount = 4;
+        layout.attributes     = vertexAttribs.data();
+        layout.arrayStride    = sizeof(PackedVertex);
+        layout.stepMode       = WGPUVertexStepMode_Vertex;
+        return;
+    }
+
     // Position
     vertexAttribs[0].shaderLocation = 0;
     vertexAttribs[0].format = WGPUVertexFormat::WGPUVertexFormat_Float32x4;
@@ -84,4 +203,16 @@ VertexBuffer::Layout::Layout()
     layout.attributes     = vertexAttribs.data();
     layout.arrayStride    = sizeof(Vertex);
     layout.stepMode       = WGPUVertexStepMode_Vertex;
-}
\ No newline at end of file
+}
+
+VertexBuffer::PositionLayout::PositionLayout()
+{
+    vertexAttrib.shaderLocation = 0;
+    vertexAttrib.format = WGPUVertexFormat::WGPUVertexFormat_Float32x3;
+    vertexAttrib.offset = 0;
+
+    layout.attributeCount = 1;
+    layout.attributes     = &vertexAttrib;
+    layout.arrayStride    = sizeof(glm::vec3);
+    layout.stepMode       = WGPUVertexStepMode_Vertex;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include <webgpu/webgpu.h>
 #include "mesh.h"
 
@@ -10,26 +11,60 @@ class VertexBuffer
 {
 friend class RenderPass;
 friend class ShadowPass;
+friend class DrawList;
 
 public:
+    // Packed stores PackedVertex, Full the Vertex layout as is
+    enum class Format
+    {
+        Packed,
+        Full
+    };
+
     VertexBuffer(Gpu& gpu);
     ~VertexBuffer();
 
     class Layout
     {
     public:
-        Layout();
+        Layout(Format format);
         std::array<WGPUVertexAttribute, 5>  vertexAttribs = {};
         WGPUVertexBufferLayout              layout = {};
     };
 
+    // Only the positions, tightly packed, for depth-only pipelines. A vec4f in the shaders with w = 1.
+    class PositionLayout
+    {
+    public:
+        PositionLayout();
+        WGPUVertexAttribute     vertexAttrib = {};
+        WGPUVertexBufferLayout  layout = {};
+    };
+
+    // Indices of a level of detail in the index buffer, the full mesh is level 0
+    struct IndexRange
+    {
+        uint32_t    firstIndex  = 0;
+        uint32_t    indexCount  = 0;
+    };
+
     void setMesh(const Mesh* mesh);
+
+    // Bytes setMesh() uploads for mesh, with the vertex format of gpu
+    static uint64_t uploadBytes(const Gpu& gpu, const Mesh& mesh);
     const Mesh& getMesh() const;
 
+    int                 lodCount() const;
+    const IndexRange&   lod(int level) const;
+
 private:
     Gpu &           m_gpu;
     const Mesh*     m_mesh;
 
     WGPUBuffer  m_vertexBuffer = nullptr;
+    WGPUBuffer  m_positionBuffer = nullptr;
     WGPUBuffer  m_indexBuffer = nullptr;
+
+    WGPUIndexFormat         m_indexFormat = WGPUIndexFormat_Uint32;
+    std::vector<IndexRange> m_lods;
 };
\ No newline at end of file
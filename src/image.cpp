@@ -1,7 +1,6 @@
 #include "image.h"
 #include <glm/glm.hpp>
-#include <glm/ext/scalar_constants.hpp>
-#include <random>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -25,6 +24,11 @@ Image::Image(const std::vector<uint8_t>& pixels)
 {
 }
 
+Image::Image(std::vector<uint8_t>&& pixels)
+    : pixels(std::make_shared<std::vector<uint8_t>>(std::move(pixels)))
+{
+}
+
 const Image Image::toRGBA() const
 {
     Image result(width * height * 4);
@@ -32,11 +36,23 @@ const Image Image::toRGBA() const
     result.height = height;
     result.bytesPerPixel = 4;
     result.type = Image::Type::RGBA;
-    for (size_t i = 0; i < width * height; ++i)
+
+    if (type == Type::RGBA16)
+    {
+        // Keeps the high byte of every channel
+        const uint16_t* source = reinterpret_cast<const uint16_t*>(getPixels());
+        for (size_t i = 0; i < size_t(width) * height * 4; ++i)
+            (*result.pixels)[i] = uint8_t(source[i] >> 8);
+        return result;
+    }
+
+    // Reads through getPixels, the pixels may be external
+    const uint8_t* source = getPixels();
+    for (size_t i = 0; i < size_t(width) * height; ++i)
     {
-        result.pixels->at(i * 4 + 0) = pixels->at(i * bytesPerPixel + 0); // Red
-        result.pixels->at(i * 4 + 1) = pixels->at(i * bytesPerPixel + 1); // Green
-        result.pixels->at(i * 4 + 2) = pixels->at(i * bytesPerPixel + 2); // Blue
+        result.pixels->at(i * 4 + 0) = source[i * bytesPerPixel + 0]; // Red
+        result.pixels->at(i * 4 + 1) = source[i * bytesPerPixel + 1]; // Green
+        result.pixels->at(i * 4 + 2) = source[i * bytesPerPixel + 2]; // Blue
         result.pixels->at(i * 4 + 3) = 255;                   // Alpha (set to opaque)
     }
     return result;
@@ -69,111 +85,89 @@ void Image::copy(const Image &rhs)
     height          = rhs.height;
     bytesPerPixel   = rhs.bytesPerPixel;
     type            = rhs.type;
+    mipLevelCount   = rhs.mipLevelCount;
     pixels          = rhs.pixels;
+
+    m_externalOwner     = rhs.m_externalOwner;
+    m_externalPixels    = rhs.m_externalPixels;
+    m_externalSize      = rhs.m_externalSize;
 }
 
-vec2 randomPointInAnnulus(const vec2 &center, float minDistance, float maxDistance)
+const uint8_t *Image::getPixels() const
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> angleDist(0, 2 * glm::pi<double>());
-    std::uniform_real_distribution<> radiusDist(minDistance, maxDistance);
-
-    double angle     = angleDist(gen);
-    double radius    = radiusDist(gen);
-
-    return vec2(center.x + radius * std::cos(angle), center.y + radius * std::sin(angle));
+    return m_externalPixels ? m_externalPixels : pixels->data();
 }
 
-std::vector<vec2> generatePoissonDiscPoints(float width, float height, float minDistance, int newPointAttempts)
+const size_t Image::bytes() const
 {
-    double cellSize = minDistance / std::sqrt(2); // The grid cell size
-    int gridWidth = static_cast<int>(std::ceil(width / cellSize));
-    int gridHeight = static_cast<int>(std::ceil(height / cellSize));
+    return m_externalPixels ? m_externalSize : pixels->size();
+}
 
-    // Grid to hold points
-    std::vector<std::vector<vec2 *>> grid(gridWidth, std::vector<vec2 *>(gridHeight, nullptr));
+void Image::setExternalPixels(std::shared_ptr<const void> owner, const uint8_t* data, size_t size)
+{
+    pixels              = std::make_shared<std::vector<uint8_t>>();
+    m_externalOwner     = std::move(owner);
+    m_externalPixels    = data;
+    m_externalSize      = size;
+}
 
-    // Active list of points
-    std::vector<vec2> activeList;
-    std::vector<vec2> points; // Final set of points
+Image Image::mipLevels(int firstLevel) const
+{
+    Image result;
+    result.width            = mipLevelWidth(firstLevel);
+    result.height           = mipLevelHeight(firstLevel);
+    result.bytesPerPixel    = bytesPerPixel;
+    result.type             = type;
+    result.mipLevelCount    = mipLevelCount - firstLevel;
 
-    // Randomly select the first point
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> widthDist(0, width);
-    std::uniform_real_distribution<> heightDist(0, height);
+    std::shared_ptr<const void> owner = m_externalPixels ? m_externalOwner : std::shared_ptr<const void>(pixels);
+    size_t                      offset = mipLevelOffset(firstLevel);
+    result.setExternalPixels(std::move(owner), getPixels() + offset, bytes() - offset);
+    return result;
+}
 
-    vec2 initialPoint(widthDist(gen), heightDist(gen));
-    points.push_back(initialPoint);
-    activeList.push_back(initialPoint);
+int Image::mipLevelWidth(int level) const
+{
+    return std::max(1, width >> level);
+}
 
-    int gridX = static_cast<int>(initialPoint.x / cellSize);
-    int gridY = static_cast<int>(initialPoint.y / cellSize);
-    grid[gridX][gridY] = &points.back();
+int Image::mipLevelHeight(int level) const
+{
+    return std::max(1, height >> level);
+}
 
-    while (!activeList.empty())
-    {
-        int randomIndex = std::uniform_int_distribution<>(0, int(activeList.size()) - 1)(gen);
-        vec2 point = activeList[randomIndex];
-        bool found = false;
-
-        for (int i = 0; i < newPointAttempts; ++i)
-        {
-            vec2 newPoint = randomPointInAnnulus(point, minDistance, 2 * minDistance);
-
-            if (newPoint.x >= 0 && newPoint.x < width && newPoint.y >= 0 && newPoint.y < height)
-            {
-                int newGridX = static_cast<int>(newPoint.x / cellSize);
-                int newGridY = static_cast<int>(newPoint.y / cellSize);
-                bool valid = true;
-
-                // Check neighboring cells
-                for (int dx = -1; dx <= 1; ++dx)
-                {
-                    for (int dy = -1; dy <= 1; ++dy)
-                    {
-                        int neighborX = newGridX + dx;
-                        int neighborY = newGridY + dy;
-                        if (neighborX >= 0 && neighborX < gridWidth && neighborY >= 0 && neighborY < gridHeight)
-                        {
-                            vec2 *neighbor = grid[neighborX][neighborY];
-                            if (neighbor && (newPoint - *neighbor).length() < minDistance)
-                            {
-                                valid = false;
-                            }
-                        }
-                    }
-                }
-
-                if (valid)
-                {
-                    points.push_back(newPoint);
-                    activeList.push_back(newPoint);
-                    grid[newGridX][newGridY] = &points.back();
-                    found = true;
-                    break;
-                }
-            }
-        }
-
-        if (!found)
-        {
-            activeList.erase(activeList.begin() + randomIndex);
-        }
-    }
+size_t Image::mipLevelOffset(int level) const
+{
+    size_t offset = 0;
+    for (int i = 0; i < level; i++)
+        offset += mipLevelBytes(i);
+    return offset;
+}
 
-    return points;
+size_t Image::mipLevelBytes(int level) const
+{
+    if (isBlockCompressed())
+        return size_t((mipLevelWidth(level) + 3) / 4) * ((mipLevelHeight(level) + 3) / 4) * blockBytes();
+    return size_t(mipLevelWidth(level)) * mipLevelHeight(level) * bytesPerPixel;
 }
 
-const uint8_t *Image::getPixels() const
+bool Image::isBlockCompressed() const
 {
-    return pixels->data();
+    return blockBytes() > 0;
 }
 
-const size_t Image::bytes() const
+int Image::blockBytes() const
 {
-    return pixels->size();
+    switch (type)
+    {
+        case Type::BC1:     return 8;
+        case Type::BC3:
+        case Type::BC5:
+        case Type::BC7:
+        case Type::ETC2:
+        case Type::ASTC:    return 16;
+        default:            return 0;
+    }
 }
 
 void Image::setPixel(int x, int y, uint8_t value)
@@ -207,32 +201,3 @@ void Image::setPixel(int x, int y, uint32_t value)
     *pos = value;
 }
 
-int Image::makePoissonDisc(int width_, int height_, int minDistance)
-{
-    std::vector<vec2> points = generatePoissonDiscPoints(float(width_), float(width_), float(minDistance), 30);
-
-    width           = int(points.size());
-    height          = 1;
-    bytesPerPixel   = 2;
-    type            = Type::RG8;
-    pixels->resize(sizeInBytes(), 0);
-
-    int xi = 0;
-    for (const vec2& point : points)
-    {
-        int x = static_cast<int>(floor(point.x));
-        int y = static_cast<int>(floor(point.y));
-
-        if (x >= 0 && x < width_ && y >= 0 && y < height_) 
-        {
-            vec2 size           = vec2(width_, height_);
-            vec2 coordinate     = vec2(point.x, point.y) / size;
-
-            uint8_t r = static_cast<uint8_t>(coordinate.x * 255.0f);
-            uint8_t g = static_cast<uint8_t>(coordinate.y * 255.0f);
-            setPixel(xi, 0, r, g);
-        }
-        xi++;
-    }
-    return int(points.size());
-}
@@ -9,10 +9,12 @@ public:
     Image();
     Image(size_t size);
     Image(const std::vector<uint8_t>& pixels);
+    Image(std::vector<uint8_t>&& pixels);
     Image(const Image& rhs);
 
     virtual ~Image();
 
+    // Converts RGB and RGBA16 images to 8-bit RGBA
     const Image toRGBA() const;
 
     Image& operator=(const Image& rhs);
@@ -22,7 +24,15 @@ public:
         RGBA,
         RGB,
         RG8,
-        R8
+        R8,
+
+        // Block compressed in 4x4 texel blocks, bytesPerPixel is 0
+        BC1,
+        BC3,
+        BC5,
+        BC7,
+        ETC2,
+        ASTC
     };
 
     int width;
@@ -31,19 +41,46 @@ public:
     int bytesPerPixel       = 4;
     Type type               = Type::RGBA;
 
+    // Number of mip levels stored one after another in the pixels, level i is max(1, width >> i) by max(1, height >> i)
+    int mipLevelCount       = 1;
+
     const uint8_t* getPixels() const;
     const size_t bytes() const;
 
+    // Uses pixels stored elsewhere, for example in a mapped file, instead of pixels. They stay alive as long as owner.
+    void setExternalPixels(std::shared_ptr<const void> owner, const uint8_t* data, size_t size);
+
+    // Returns the image with a mip chain of at most maxMipLevels levels, each level the box filtered previous one.
+    // With srgb the color channels of 8-bit RGB(A) images are averaged in linear space. Implemented in imagemips.cpp.
+    Image generateMipMaps(int maxMipLevels, bool srgb = false) const;
+
+    // Number of levels of the mip chain generateMipMaps creates, down to 1x1 unless maxMipLevels ends it first
+    int mipChainLength(int maxMipLevels) const;
+
+    // Returns the levels from firstLevel on as an image of their own, which shares the pixels
+    Image mipLevels(int firstLevel) const;
+
+    int         mipLevelWidth   (int level) const;
+    int         mipLevelHeight  (int level) const;
+    size_t      mipLevelOffset  (int level) const;
+    size_t      mipLevelBytes   (int level) const;
+
+    bool        isBlockCompressed   () const;
+    int         blockBytes          () const;
+
     void setPixel(int x, int y, uint8_t value);
     void setPixel(int x, int y, uint8_t valueR, uint8_t valueG);
     void setPixel(int x, int y, uint16_t value);
     void setPixel(int x, int y, uint32_t value);
 
-    int makePoissonDisc(int width, int height, int minDistance);
     int sizeInBytes() const;
 
     std::shared_ptr<std::vector<uint8_t>> pixels;
 
 private:
+    std::shared_ptr<const void> m_externalOwner;
+    const uint8_t*              m_externalPixels    = nullptr;
+    size_t                      m_externalSize      = 0;
+
     void copy(const Image& rhs);
 };
@@ -0,0 +1,295 @@
+#include "image.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPS_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIPS_NEON
+#endif
+
+// Mip generation for Image::generateMipMaps. Levels with even sizes and 8-bit linear channels average 2x2 blocks
+// with SIMD kernels per pixel size. sRGB images average in linear space through lookup tables, odd sizes use a
+// three tap box filter so every source pixel contributes equally. The rows of a level are split over the shared
+// thread pool.
+
+// Conversions between 8-bit sRGB values and linear values
+struct SrgbTables
+{
+    static const int linearSteps = 16384;
+
+    float       toLinear    [256];
+    uint16_t    toLinear16  [256];      // Linear values scaled to 0..linearSteps - 1
+    uint8_t     fromLinear  [linearSteps];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float value     = i / 255.0f;
+            toLinear[i]     = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            toLinear16[i]   = uint16_t(std::lround(toLinear[i] * (linearSteps - 1)));
+        }
+        for (int i = 0; i < linearSteps; i++)
+        {
+            float linear    = float(i) / (linearSteps - 1);
+            float value     = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+            fromLinear[i]   = uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+        }
+    }
+
+    static const SrgbTables& get()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+};
+
+// Source pixels of a destination pixel when halving a row or column of size pixels. Even sizes average pairs,
+// odd sizes 2n + 1 spread the source over n pixels with three taps each.
+struct Taps
+{
+    int     first;
+    int     count;
+    float   weights[3];
+};
+
+static std::vector<Taps> halvingTaps(int size, int halfSize)
+{
+    std::vector<Taps> result(halfSize);
+    for (int i = 0; i < halfSize; i++)
+    {
+        if (size == 1)
+            result[i] = Taps { .first = 0, .count = 1, .weights = { 1.0f } };
+        else if (size % 2 == 0)
+            result[i] = Taps { .first = 2 * i, .count = 2, .weights = { 0.5f, 0.5f } };
+        else
+            result[i] = Taps { .first = 2 * i, .count = 3, .weights = { float(halfSize - i) / size, float(halfSize) / size, float(i + 1) / size } };
+    }
+    return result;
+}
+
+#ifdef MIPS_SSE2
+// Averages the 2x2 blocks of two rows of 8-bit pixels, returns the number of destination pixels written
+static int halveRowSimd(const uint8_t* row0, const uint8_t* row1, uint8_t* destination, int width, int bytesPerPixel)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i two   = _mm_set1_epi16(2);
+    const __m128i ones  = _mm_set1_epi16(1);
+
+    // 16 source bytes of both rows make 8 destination bytes
+    int step = 8 / bytesPerPixel;
+    int x    = 0;
+    for (; x + step <= width; x += step)
+    {
+        __m128i a   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x * bytesPerPixel));
+        __m128i b   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x * bytesPerPixel));
+        __m128i lo  = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi  = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+        // Add the horizontal neighbours, bytesPerPixel lanes apart
+        __m128i sum;
+        if (bytesPerPixel == 4)
+        {
+            sum = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+        }
+        else if (bytesPerPixel == 2)
+        {
+            __m128i l = _mm_shuffle_epi32(_mm_add_epi16(lo, _mm_srli_epi64(lo, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i h = _mm_shuffle_epi32(_mm_add_epi16(hi, _mm_srli_epi64(hi, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+            sum = _mm_unpacklo_epi64(l, h);
+        }
+        else
+        {
+            sum = _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+        }
+
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x * bytesPerPixel), _mm_packus_epi16(sum, sum));
+    }
+    return x;
+}
+#elif defined(MIPS_NEON)
+// Averages the 2x2 blocks of two rows of 8-bit pixels, returns the number of destination pixels written
+static int halveRowSimd(const uint8_t* row0, const uint8_t* row1, uint8_t* destination, int width, int bytesPerPixel)
+{
+    // 16 source pixels of both rows make 8 destination pixels, the loads split the channels
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const uint8_t*  a = row0 + 2 * x * bytesPerPixel;
+        const uint8_t*  b = row1 + 2 * x * bytesPerPixel;
+        uint8_t*        d = destination + x * bytesPerPixel;
+        if (bytesPerPixel == 4)
+        {
+            uint8x16x4_t    top     = vld4q_u8(a);
+            uint8x16x4_t    bottom  = vld4q_u8(b);
+            uint8x8x4_t     result;
+            for (int c = 0; c < 4; c++)
+                result.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(top.val[c]), bottom.val[c]), 2);
+            vst4_u8(d, result);
+        }
+        else if (bytesPerPixel == 2)
+        {
+            uint8x16x2_t    top     = vld2q_u8(a);
+            uint8x16x2_t    bottom  = vld2q_u8(b);
+            uint8x8x2_t     result;
+            for (int c = 0; c < 2; c++)
+                result.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(top.val[c]), bottom.val[c]), 2);
+            vst2_u8(d, result);
+        }
+        else
+        {
+            vst1_u8(d, vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(vld1q_u8(a)), vld1q_u8(b)), 2));
+        }
+    }
+    return x;
+}
+#else
+static int halveRowSimd(const uint8_t*, const uint8_t*, uint8_t*, int, int)
+{
+    return 0;
+}
+#endif
+
+// Even sizes, 8-bit linear channels
+static void halveRowLinear(const uint8_t* row0, const uint8_t* row1, uint8_t* destination, int width, int bytesPerPixel)
+{
+    int simdPixels = bytesPerPixel == 3 ? 0 : halveRowSimd(row0, row1, destination, width, bytesPerPixel);
+    for (int i = simdPixels * bytesPerPixel; i < width * bytesPerPixel; i++)
+    {
+        int pixel   = i / bytesPerPixel;
+        int channel = i % bytesPerPixel;
+        int left    = 2 * pixel * bytesPerPixel + channel;
+        int right   = left + bytesPerPixel;
+        destination[i] = uint8_t((row0[left] + row0[right] + row1[left] + row1[right] + 2) >> 2);
+    }
+}
+
+// Even sizes, RGB(A) with sRGB color channels and linear alpha
+static void halveRowSrgb(const uint8_t* row0, const uint8_t* row1, uint8_t* destination, int width, int bytesPerPixel)
+{
+    const SrgbTables& tables = SrgbTables::get();
+    for (int x = 0; x < width; x++)
+    {
+        const uint8_t* a = row0 + 2 * x * bytesPerPixel;
+        const uint8_t* b = row1 + 2 * x * bytesPerPixel;
+        const uint8_t* e = a + bytesPerPixel;
+        const uint8_t* f = b + bytesPerPixel;
+        uint8_t*       d = destination + x * bytesPerPixel;
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t sum = tables.toLinear16[a[c]] + tables.toLinear16[e[c]] + tables.toLinear16[b[c]] + tables.toLinear16[f[c]];
+            d[c] = tables.fromLinear[(sum + 2) >> 2];
+        }
+        if (bytesPerPixel == 4)
+            d[3] = uint8_t((a[3] + e[3] + b[3] + f[3] + 2) >> 2);
+    }
+}
+
+// Any size and channel layout, 8 or 16-bit channels
+static void halveRowFiltered(const uint8_t* source, int sourceWidth, uint8_t* destination, const std::vector<Taps>& columns,
+                             const Taps& rows, int bytesPerPixel, int channelSize, bool srgb)
+{
+    const SrgbTables&   tables      = SrgbTables::get();
+    int                 channels    = bytesPerPixel / channelSize;
+    float               maxValue    = channelSize == 1 ? 255.0f : 65535.0f;
+
+    auto read = [&](const uint8_t* pixel, int channel)
+    {
+        if (channelSize == 2) return reinterpret_cast<const uint16_t*>(pixel)[channel] / maxValue;
+        return srgb && channel < 3 ? tables.toLinear[pixel[channel]] : pixel[channel] / maxValue;
+    };
+
+    for (size_t x = 0; x < columns.size(); x++)
+    {
+        const Taps& column = columns[x];
+        for (int c = 0; c < channels; c++)
+        {
+            float sum = 0.0f;
+            for (int j = 0; j < rows.count; j++)
+            {
+                const uint8_t* row = source + size_t(rows.first + j) * sourceWidth * bytesPerPixel;
+                for (int i = 0; i < column.count; i++)
+                    sum += rows.weights[j] * column.weights[i] * read(row + (column.first + i) * bytesPerPixel, c);
+            }
+
+            uint8_t* pixel = destination + x * bytesPerPixel;
+            if (channelSize == 2)
+                reinterpret_cast<uint16_t*>(pixel)[c] = uint16_t(std::lround(std::clamp(sum, 0.0f, 1.0f) * maxValue));
+            else if (srgb && c < 3)
+                pixel[c] = tables.fromLinear[std::lround(std::clamp(sum, 0.0f, 1.0f) * (SrgbTables::linearSteps - 1))];
+            else
+                pixel[c] = uint8_t(std::lround(std::clamp(sum, 0.0f, 1.0f) * maxValue));
+        }
+    }
+}
+
+int Image::mipChainLength(int maxMipLevels) const
+{
+    int levels = 1;
+    while (levels < maxMipLevels && (std::max(width, height) >> levels) > 0)
+        levels++;
+    return levels;
+}
+
+Image Image::generateMipMaps(int maxMipLevels, bool srgb) const
+{
+    int levels = mipChainLength(maxMipLevels);
+
+    Image result(*this);
+    result.mipLevelCount    = levels;
+    result.pixels           = std::make_shared<std::vector<uint8_t>>(result.mipLevelOffset(levels));
+    result.m_externalOwner  = nullptr;
+    result.m_externalPixels = nullptr;
+    result.m_externalSize   = 0;
+
+    uint8_t* chain = result.pixels->data();
+    std::copy(getPixels(), getPixels() + size_t(width) * height * bytesPerPixel, chain);
+
+    int  channelSize    = type == Type::RGBA16 ? 2 : 1;
+    bool srgbColor      = srgb && channelSize == 1 && bytesPerPixel >= 3;
+
+    for (int level = 1; level < levels; level++)
+    {
+        const uint8_t*  previous        = chain + result.mipLevelOffset(level - 1);
+        uint8_t*        current         = chain + result.mipLevelOffset(level);
+        int             previousWidth   = result.mipLevelWidth(level - 1);
+        int             previousHeight  = result.mipLevelHeight(level - 1);
+        int             levelWidth      = result.mipLevelWidth(level);
+        int             levelHeight     = result.mipLevelHeight(level);
+        size_t          previousStride  = size_t(previousWidth) * bytesPerPixel;
+        size_t          levelStride     = size_t(levelWidth) * bytesPerPixel;
+
+        bool even       = previousWidth % 2 == 0 && previousHeight % 2 == 0;
+        bool fastLinear = even && channelSize == 1 && !srgbColor;
+        bool fastSrgb   = even && srgbColor;
+
+        std::vector<Taps> columns   = halvingTaps(previousWidth, levelWidth);
+        std::vector<Taps> rows      = halvingTaps(previousHeight, levelHeight);
+
+        // Chunks of about 16k pixels
+        size_t rowsPerChunk = std::max(1, 16384 / levelWidth);
+        ThreadPool::shared().parallelFor(size_t(levelHeight), rowsPerChunk, [&](size_t begin, size_t end)
+        {
+            for (size_t y = begin; y < end; y++)
+            {
+                const uint8_t*  row0        = previous + 2 * y * previousStride;
+                uint8_t*        destination = current + y * levelStride;
+
+                if (fastLinear)
+                    halveRowLinear(row0, row0 + previousStride, destination, levelWidth, bytesPerPixel);
+                else if (fastSrgb)
+                    halveRowSrgb(row0, row0 + previousStride, destination, levelWidth, bytesPerPixel);
+                else
+                    halveRowFiltered(previous, previousWidth, destination, columns, rows[y], bytesPerPixel, channelSize, srgbColor);
+            }
+        });
+    }
+
+    return result;
+}
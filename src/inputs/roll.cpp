@@ -39,13 +39,17 @@ void RollInput::mouseWheel(int direction)
 
 bool RollInput::animate()
 {
-    zoom(zoomFactor);
-    roll(rotation);
+    // Stop once the motion has decayed, so the object is no longer changed and the viewer can go idle.
+    if (length(rotation) < 0.001f)  rotation    = vec2(0.0);
+    if (abs(zoomFactor) < 0.001f)   zoomFactor  = 0.0f;
+
+    if (zoomFactor != 0.0f)         zoom(zoomFactor);
+    if (rotation != vec2(0.0))      roll(rotation);
 
     rotation = rotation * 0.95f;
     zoomFactor = zoomFactor * 0.60f;
 
-    return rotation.length() > 0.001 && zoomFactor > 0.001;
+    return rotation != vec2(0.0) || zoomFactor != 0.0f;
 }
 
 void RollInput::roll(const glm::vec2 &rotation)
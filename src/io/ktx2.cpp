@@ -0,0 +1,133 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const uint8_t ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+    struct Ktx2Header
+    {
+        uint8_t     identifier[12];
+        uint32_t    vkFormat;
+        uint32_t    typeSize;
+        uint32_t    pixelWidth;
+        uint32_t    pixelHeight;
+        uint32_t    pixelDepth;
+        uint32_t    layerCount;
+        uint32_t    faceCount;
+        uint32_t    levelCount;
+        uint32_t    supercompressionScheme;
+
+        uint32_t    dfdByteOffset;
+        uint32_t    dfdByteLength;
+        uint32_t    kvdByteOffset;
+        uint32_t    kvdByteLength;
+        uint64_t    sgdByteOffset;
+        uint64_t    sgdByteLength;
+    };
+
+    struct Ktx2Level
+    {
+        uint64_t    byteOffset;
+        uint64_t    byteLength;
+        uint64_t    uncompressedByteLength;
+    };
+
+    // Vulkan formats, the sRGB variants have the same layout, whether a texture is sRGB follows from its use
+    std::optional<Image::Type> imageType(uint32_t vkFormat)
+    {
+        switch (vkFormat)
+        {
+            case 37:  case 43:  return Image::Type::RGBA;   // VK_FORMAT_R8G8B8A8_UNORM, _SRGB
+            case 131: case 132:                             // VK_FORMAT_BC1_RGB_UNORM_BLOCK, _SRGB_BLOCK
+            case 133: case 134: return Image::Type::BC1;    // VK_FORMAT_BC1_RGBA_UNORM_BLOCK, _SRGB_BLOCK
+            case 137: case 138: return Image::Type::BC3;    // VK_FORMAT_BC3_UNORM_BLOCK, _SRGB_BLOCK
+            case 141:           return Image::Type::BC5;    // VK_FORMAT_BC5_UNORM_BLOCK
+            case 145: case 146: return Image::Type::BC7;    // VK_FORMAT_BC7_UNORM_BLOCK, _SRGB_BLOCK
+            case 151: case 152: return Image::Type::ETC2;   // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, _SRGB_BLOCK
+            case 157: case 158: return Image::Type::ASTC;   // VK_FORMAT_ASTC_4x4_UNORM_BLOCK, _SRGB_BLOCK
+            default:            return std::nullopt;
+        }
+    }
+}
+
+bool isKtx2(const uint8_t* data, size_t size)
+{
+    return size >= sizeof(ktx2Identifier) && std::memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) == 0;
+}
+
+std::optional<Image> readKtx2(const uint8_t* data, size_t size)
+{
+    Ktx2Header header;
+    if (!isKtx2(data, size) || size < sizeof(header))
+    {
+        std::cerr << "readKtx2() - not a KTX2 file" << std::endl;
+        return std::nullopt;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    std::optional<Image::Type> type = imageType(header.vkFormat);
+    if (!type.has_value() || header.supercompressionScheme != 0)
+    {
+        std::cerr << "readKtx2() - unsupported format " << header.vkFormat << " or supercompression " << header.supercompressionScheme << std::endl;
+        return std::nullopt;
+    }
+    if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0)
+    {
+        std::cerr << "readKtx2() - only 2D images are supported" << std::endl;
+        return std::nullopt;
+    }
+
+    if (header.pixelWidth > INT_MAX || header.pixelHeight > INT_MAX)
+    {
+        std::cerr << "readKtx2() - image of " << header.pixelWidth << "x" << header.pixelHeight << " is too large" << std::endl;
+        return std::nullopt;
+    }
+    if (header.levelCount > uint32_t(std::bit_width(std::max(header.pixelWidth, header.pixelHeight))))
+    {
+        std::cerr << "readKtx2() - " << header.levelCount << " levels exceed the mip chain" << std::endl;
+        return std::nullopt;
+    }
+
+    // A level count of 0 asks for generated mips
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    if (size < sizeof(header) + levelCount * sizeof(Ktx2Level))
+    {
+        std::cerr << "readKtx2() - truncated level index" << std::endl;
+        return std::nullopt;
+    }
+
+    Image image;
+    image.width         = int(header.pixelWidth);
+    image.height        = int(header.pixelHeight);
+    image.type          = type.value();
+    image.bytesPerPixel = image.type == Image::Type::RGBA ? 4 : 0;
+    image.mipLevelCount = int(levelCount);
+
+    // Every level has to lie within the file before the chain is allocated, the header alone can ask for gigabytes
+    std::vector<Ktx2Level> levels(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        Ktx2Level& index = levels[level];
+        std::memcpy(&index, data + sizeof(header) + level * sizeof(Ktx2Level), sizeof(index));
+
+        size_t levelBytes = image.mipLevelBytes(int(level));
+        if (index.byteLength != levelBytes || index.byteOffset > size || size - index.byteOffset < levelBytes)
+        {
+            std::cerr << "readKtx2() - level " << level << " has an unexpected size" << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    image.pixels->resize(image.mipLevelOffset(image.mipLevelCount));
+    for (uint32_t level = 0; level < levelCount; level++)
+        std::memcpy(image.pixels->data() + image.mipLevelOffset(int(level)), data + levels[level].byteOffset, levels[level].byteLength);
+
+    return image;
+}
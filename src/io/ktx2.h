@@ -0,0 +1,17 @@
+#pragma once
+
+#include "image.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Reading of KTX2 texture containers, as used by glTF models with KHR_texture_basisu or image/ktx2 images.
+// Supported are 2D images without supercompression in RGBA8, BC1, BC3, BC5, BC7, ETC2 RGBA8 and ASTC 4x4
+// formats, the levels in the file become the mip chain of the image.
+
+// Whether data starts with the KTX2 file identifier
+bool isKtx2(const uint8_t* data, size_t size);
+
+// Returns the image of a KTX2 file, nothing when the file is invalid or not supported
+std::optional<Image> readKtx2(const uint8_t* data, size_t size);
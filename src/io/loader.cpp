@@ -1,9 +1,14 @@
 #include "loader.h"
 
 #include "renderable.h"
+#include "threadpool.h"
+#include "mappedfile.h"
+#include "meshoptimizer.h"
+#include "ktx2.h"
 
 #include <iostream>
 #include <optional>
+#include <future>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp> 
@@ -28,8 +33,25 @@
 
 using namespace glm;
 
-std::map<int, Image>    imageCache;
-std::map<int, Mesh>     meshCache;
+// Pixels of a glTF image, decoded on the shared thread pool while the model is loaded
+struct DecodedImage
+{
+    // The decoder's allocation, freed with stbi_image_free when the last image using it goes away
+    std::shared_ptr<unsigned char>          pixels;
+    size_t                                  size = 0;
+    int                                     bits = 8;
+
+    // KTX2 images are read in their final layout, with their mip chain
+    std::optional<Image>                    image;
+};
+
+// The GLB file of the model being loaded, its binary chunk is read in place instead of from the tinygltf buffer
+std::unique_ptr<MappedFile>                         mappedModel;
+const unsigned char*                                binaryChunk = nullptr;
+
+std::map<int, Image>                                imageCache;
+std::map<int, std::shared_future<DecodedImage>>     decodedImages;
+std::map<int, Mesh>                                 meshCache;
 
 Image getImage(int i, std::function<Image(void)> creator)
 {
@@ -90,6 +112,15 @@ glm::mat4 getNodeTransformation(const tinygltf::Node& node)
     return transform;
 }
 
+const unsigned char* bufferData(const tinygltf::Model& model, int bufferIndex)
+{
+    const tinygltf::Buffer& buffer = model.buffers[bufferIndex];
+    if (buffer.data.empty() && buffer.uri.empty())
+        return binaryChunk;
+
+    return buffer.data.data();
+}
+
 struct AttributeData
 {
     const unsigned char* dataPtr        = nullptr;
@@ -112,10 +143,9 @@ std::optional<AttributeData> read(const tinygltf::Model& model, tinygltf::Primit
 
 	const tinygltf::Accessor*   accessor   = &model.accessors[accessorIndex];
 	const tinygltf::BufferView* bufferView = &model.bufferViews[accessor->bufferView];
-	const tinygltf::Buffer*     buffer     = &model.buffers[bufferView->buffer];
 
 	auto result = AttributeData {
-		&buffer->data[bufferView->byteOffset + accessor->byteOffset],
+		bufferData(model, bufferView->buffer) + bufferView->byteOffset + accessor->byteOffset,
 		accessor->count,
 		accessor->ByteStride(*bufferView),
         accessor->componentType
@@ -123,6 +153,21 @@ std::optional<AttributeData> read(const tinygltf::Model& model, tinygltf::Primit
 	return result;
 }
 
+std::optional<AttributeData> read(const tinygltf::Model& model, int accessorIndex)
+{
+    if (accessorIndex < 0 || accessorIndex >= model.accessors.size()) return std::nullopt;
+
+    const tinygltf::Accessor*   accessor   = &model.accessors[accessorIndex];
+    const tinygltf::BufferView* bufferView = &model.bufferViews[accessor->bufferView];
+
+    return AttributeData {
+        bufferData(model, bufferView->buffer) + bufferView->byteOffset + accessor->byteOffset,
+        accessor->count,
+        accessor->ByteStride(*bufferView),
+        accessor->componentType
+    };
+}
+
 std::optional<AttributeData> read(const tinygltf::Model& model, tinygltf::Primitive& primitive, const std::string& attribute)
 {
     std::optional<AttributeData> result = std::nullopt;
@@ -213,15 +258,13 @@ std::vector<vec2> getUVSet(int uvIndex, const tinygltf::Model& model)
 
     const tinygltf::Accessor* texCoordAccessor        = nullptr;
     const tinygltf::BufferView* texCoordBufferView    = nullptr;
-    const tinygltf::Buffer* texCoordBuffer            = nullptr;
     const unsigned char* texCoordData                 = nullptr;
     size_t texCoordStride = 0;
 
     int texCoordAccessorIndex   = uvIndex;
     texCoordAccessor            = &model.accessors[texCoordAccessorIndex];
     texCoordBufferView          = &model.bufferViews[texCoordAccessor->bufferView];
-    texCoordBuffer              = &model.buffers[texCoordBufferView->buffer];
-    texCoordData                = &texCoordBuffer->data[texCoordBufferView->byteOffset + texCoordAccessor->byteOffset];
+    texCoordData                = bufferData(model, texCoordBufferView->buffer) + texCoordBufferView->byteOffset + texCoordAccessor->byteOffset;
     texCoordStride              = texCoordAccessor->ByteStride(*texCoordBufferView);
     if (texCoordStride == 0) texCoordStride = sizeof(vec2);
 
@@ -292,16 +335,13 @@ TextureTransforms getTextureTransforms(const tinygltf::TextureInfo& textureInfo)
     return result;
 }
 
-Image convertTo8bits(Image& image)
+// Textures with KHR_texture_basisu refer to their KTX2 image in the extension
+int textureSource(const tinygltf::Texture& texture)
 {
-    std::vector<uint8_t> newPixels(image.bytes() / 2);
-
-    int nrBytes = newPixels.size();
-    for (int i = 0; i < nrBytes; i++)
-        newPixels[i] = image.getPixels()[i * 2];
-
-    Image result(newPixels);
-    return result;
+    auto basisu = texture.extensions.find("KHR_texture_basisu");
+    if (basisu != texture.extensions.end() && basisu->second.Has("source"))
+        return basisu->second.Get("source").GetNumberAsInt();
+    return texture.source;
 }
 
 template <typename T>
@@ -314,52 +354,74 @@ Image getImage(const T& textureInfo, const tinygltf::Model& model)
         {
             
             const tinygltf::Texture& texture    = model.textures[textureInfo.index];
-            const tinygltf::Image& image        = model.images[texture.source];
+            int                      source     = textureSource(texture);
+            if (source < 0 || source >= int(model.images.size())) return Image();
+
+            const tinygltf::Image& image        = model.images[source];
 
-            Image newImage(image.image);
+            Image newImage;
+            int bits        = image.bits;
+            int pixelType   = image.pixel_type;
+
+            auto decoded = decodedImages.find(source);
+            if (decoded != decodedImages.end())
+            {
+                // The image takes a reference on the decoder's pixels rather than copying them
+                const DecodedImage& result = decoded->second.get();
+                if (result.image.has_value()) return result.image.value();
+                if (!result.pixels) return Image();
+
+                newImage.setExternalPixels(result.pixels, result.pixels.get(), result.size);
+                bits            = result.bits;
+                pixelType       = result.bits == 16 ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+            }
+            else
+            {
+                newImage = Image(image.image);
+            }
             newImage.width           = image.width;
             newImage.height          = image.height;
-            newImage.bytesPerPixel   = image.component * (image.bits / 8);
+            newImage.bytesPerPixel   = image.component * (bits / 8);
 
             std::cout << "component: " << image.component << std::endl;
-            std::cout << "bits: " << image.bits << std::endl;
+            std::cout << "bits: " << bits << std::endl;
 
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 4)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 4)
             {
                 newImage.bytesPerPixel   = 4;
                 newImage.type            = Image::Type::RGBA;
                 std::cout << "TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE" << std::endl;
             }
 
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT && image.component == 4)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT && image.component == 4)
             {
-                newImage = convertTo8bits(newImage);
-                newImage.bytesPerPixel   = 4;
-                newImage.type            = Image::Type::RGBA;
+                // Converted to 8 bits when uploaded
+                newImage.bytesPerPixel   = 8;
+                newImage.type            = Image::Type::RGBA16;
                 std::cout << "TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT" << std::endl;
             }
 
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 2)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 2)
             {
                 newImage.type = Image::Type::RG8;
                 std::cout << "TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE" << std::endl;
             }
 
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 1)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 1)
             {
                 newImage.type = Image::Type::R8;
                 std::cout << "TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE" << std::endl;
             }
 
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 3)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && image.component == 3)
             {
                 newImage.type = Image::Type::RGB;
                 std::cout << "TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE" << std::endl;
             }
 
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_FLOAT)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_FLOAT)
                 std::cout << "TINYGLTF_COMPONENT_TYPE_FLOAT" << std::endl;
-            if (image.pixel_type == TINYGLTF_COMPONENT_TYPE_DOUBLE)
+            if (pixelType == TINYGLTF_COMPONENT_TYPE_DOUBLE)
                 std::cout << "TINYGLTF_COMPONENT_TYPE_DOUBLE" << std::endl;
 
             std::cout << "image width "     << newImage.width << std::endl;
@@ -431,7 +493,28 @@ void fillMaterial(const tinygltf::Model& model, int materialIndex, Material& mat
     }
 }
 
-void traverseNodes(tinygltf::Model& model, const tinygltf::Node& node, Mesh& mesh, mat4 nodeTransform)
+// Appends the vertices and triangles of a primitive to mesh and records where they are, normals are generated
+// later for the ranges of primitives without them, tangents for all.
+void fillPrimitive(const tinygltf::Model& model, tinygltf::Primitive& primitive, Mesh& mesh, mat4 nodeTransform,
+                   std::vector<MeshRange>& ranges, std::vector<MeshRange>& rangesWithoutNormals)
+{
+    MeshRange range;
+    range.firstVertex   = mesh.vertices().size();
+    range.firstTriangle = mesh.indices().size();
+
+    fillVertices(model, primitive, mesh, nodeTransform);
+    fillIndices (model, primitive, mesh, range.firstVertex);
+
+    range.vertexCount   = mesh.vertices().size() - range.firstVertex;
+    range.triangleCount = mesh.indices().size() - range.firstTriangle;
+
+    ranges.push_back(range);
+    if (!primitive.attributes.contains("NORMAL"))
+        rangesWithoutNormals.push_back(range);
+}
+
+void traverseNodes(tinygltf::Model& model, const tinygltf::Node& node, Mesh& mesh, mat4 nodeTransform,
+                   std::vector<MeshRange>& ranges, std::vector<MeshRange>& rangesWithoutNormals)
 {
     std::cout << "Node: " << node.name << std::endl;
     
@@ -442,62 +525,155 @@ void traverseNodes(tinygltf::Model& model, const tinygltf::Node& node, Mesh& mes
         tinygltf::Mesh& nodeMesh = model.meshes[node.mesh];
 
         for (auto& primitive: nodeMesh.primitives)
+            fillPrimitive(model, primitive, mesh, nodeTransform, ranges, rangesWithoutNormals);
+    }
+    
+    for (const auto& childIndex : node.children)
+        traverseNodes(model, model.nodes[childIndex], mesh, nodeTransform, ranges, rangesWithoutNormals);
+}
+
+void fillRenderable(tinygltf::Model& model, int meshIndex, Renderable& renderable)
+{
+    tinygltf::Mesh& nodeMesh = model.meshes[meshIndex];
+
+    bool newMesh = !meshCache.contains(meshIndex);
+    if (!newMesh)
+    {
+        renderable.mesh = meshCache[meshIndex];
+    }
+    else
+    {
+        Mesh& mesh = renderable.mesh;
+        std::vector<MeshRange> ranges;
+        std::vector<MeshRange> rangesWithoutNormals;
+        for (auto& primitive: nodeMesh.primitives)
+            fillPrimitive(model, primitive, mesh, mat4(1.0), ranges, rangesWithoutNormals);
+
+        mesh.generateNormals        (rangesWithoutNormals);
+        mesh.generateTangentVectors (ranges);
+        meshCache[meshIndex] = mesh;
+    }
+
+    Mesh& mesh = renderable.mesh;
+    bool uvOverride = false;
+    for (auto& primitive: nodeMesh.primitives)
+    {
+        if (primitive.material >= 0)
         {
-            int offset = mesh.vertices().size();
-            fillVertices(model, primitive, mesh, nodeTransform);
-            fillIndices(model, primitive, mesh, offset);
+            Material& material = renderable.material;
+            fillMaterial(model, primitive.material, material);
+            if (material.uvSet.has_value())
+            {
+                std::cout << "overriding uvset " << std::endl;
+                int i = 0;
+                for (Vertex& vertex: mesh.vertices())
+                    vertex.uv = material.uvSet.value()[i++];
+                uvOverride = true;
+            }
+        }
+    }
+
+    // The uv override relies on the vertex order of the file, the cached mesh shares its data with the renderable
+    if (newMesh)
+    {
+        if (!uvOverride)
+            optimizeMesh(mesh, nodeMesh.name);
+        mesh.generateLods();
+    }
+}
 
-            mesh.generateTangentVectors();
+// Reads component i of the element at index as float, normalizing integer components as glTF prescribes.
+float readComponent(const AttributeData& data, int nrComponents, size_t index, int i)
+{
+    auto component = [&]<typename T>(T) -> float
+    {
+        int strideBytes = data.stride > 0 ? data.stride : nrComponents * sizeof(T);
+        return float(reinterpret_cast<const T*>(data.dataPtr + index * strideBytes)[i]);
+    };
+
+    switch (data.componentType)
+    {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:             return component(float());
+        case TINYGLTF_COMPONENT_TYPE_BYTE:              return std::max(component(int8_t())  / 127.0f,   -1.0f);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:     return component(uint8_t())  / 255.0f;
+        case TINYGLTF_COMPONENT_TYPE_SHORT:             return std::max(component(int16_t()) / 32767.0f, -1.0f);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:    return component(uint16_t()) / 65535.0f;
+    }
+    return 0.0f;
+}
+
+// Returns the instance transforms of a node using EXT_mesh_gpu_instancing, empty if it doesn't use it.
+std::vector<mat4> getInstanceTransforms(const tinygltf::Model& model, const tinygltf::Node& node)
+{
+    std::vector<mat4> result;
+
+    auto extension = node.extensions.find("EXT_mesh_gpu_instancing");
+    if (extension == node.extensions.end() || !extension->second.Has("attributes")) return result;
+
+    const tinygltf::Value& attributes = extension->second.Get("attributes");
+    auto accessor = [&](const std::string& name) -> std::optional<AttributeData>
+    {
+        return attributes.Has(name) ? read(model, attributes.Get(name).GetNumberAsInt()) : std::nullopt;
+    };
+
+    std::optional<AttributeData> translations  = accessor("TRANSLATION");
+    std::optional<AttributeData> rotations     = accessor("ROTATION");
+    std::optional<AttributeData> scales        = accessor("SCALE");
+
+    size_t nrInstances = 0;
+    for (const auto& data : { translations, rotations, scales })
+        if (data.has_value()) nrInstances = std::max(nrInstances, data->itemCount);
+
+    result.reserve(nrInstances);
+    for (size_t i = 0; i < nrInstances; i++)
+    {
+        mat4 transform = mat4(1.0);
+        if (translations.has_value())
+            transform = translate(transform, translations->get<vec3>(i));
+
+        if (rotations.has_value())
+        {
+            quat rotation(readComponent(*rotations, 4, i, 3), readComponent(*rotations, 4, i, 0), readComponent(*rotations, 4, i, 1), readComponent(*rotations, 4, i, 2));
+            transform *= toMat4(rotation);
         }
+
+        if (scales.has_value())
+            transform = scale(transform, scales->get<vec3>(i));
+
+        result.push_back(transform);
     }
-    
-    for (const auto& childIndex : node.children)
-        traverseNodes(model, model.nodes[childIndex], mesh, nodeTransform);
+
+    std::cout << node.name << " has " << nrInstances << " gpu instances" << std::endl;
+    return result;
 }
 
 void traverseNodes(tinygltf::Model& model, const tinygltf::Node& node, Scene& scene, Object& parent, mat4 nodeTransform)
 {
     std::cout << "Node: " << node.name << std::endl;
 
-    mat4 transform                          = getNodeTransformation(node);
     RenderableObject& item = scene.newObject(parent);
     
     item.getObject().setTransform(getNodeTransformation(node));
 
     if (node.mesh >= 0)
     {
-        tinygltf::Mesh& nodeMesh    = model.meshes[node.mesh];
-
-        if (meshCache.contains(node.mesh))
-        {            
-            item.getRenderable().mesh = meshCache[node.mesh];
-        } 
-        else 
+        std::vector<mat4> instanceTransforms = getInstanceTransforms(model, node);
+        if (instanceTransforms.empty())
         {
-            for (auto& primitive: nodeMesh.primitives)
-            {
-                Mesh& mesh = item.getRenderable().mesh;
-                fillVertices (model, primitive, mesh, mat4(1.0));
-                fillIndices  (model, primitive, mesh, 0);
-                mesh.generateTangentVectors();
-                meshCache[node.mesh] = mesh;
-            }
+            fillRenderable(model, node.mesh, item.getRenderable());
         }
-
-        Mesh& mesh = item.getRenderable().mesh;
-        for (auto& primitive: nodeMesh.primitives)
+        else
         {
-            if (primitive.material >= 0)
+            // Every instance becomes a child sharing the mesh, the passes draw them with a single instanced call.
+            Renderable prototype(item.getObject());
+            fillRenderable(model, node.mesh, prototype);
+
+            for (const mat4& instanceTransform : instanceTransforms)
             {
-                Material& material = item.getRenderable().material;
-                fillMaterial(model, primitive.material, material);
-                if (material.uvSet.has_value())
-                {
-                    std::cout << "overriding uvset " << std::endl;
-                    int i = 0;
-                    for (Vertex& vertex: mesh.vertices())
-                        vertex.uv = material.uvSet.value()[i++];
-                }
+                RenderableObject& instance = scene.newObject(item.getObject());
+                instance.getObject().setTransform(instanceTransform);
+                instance.getRenderable().mesh       = prototype.mesh;
+                instance.getRenderable().material   = prototype.material;
             }
         }
     }
@@ -506,6 +682,87 @@ void traverseNodes(tinygltf::Model& model, const tinygltf::Node& node, Scene& sc
         traverseNodes(model, model.nodes[childIndex], scene, object, nodeTransform);
 }
 
+DecodedImage decodeImage(const std::vector<uint8_t>& encoded, bool is16Bit)
+{
+    DecodedImage    result;
+    int             width, height, components = 0;
+    unsigned char*  data = nullptr;
+
+    if (is16Bit)
+    {
+        data        = reinterpret_cast<unsigned char*>(stbi_load_16_from_memory(encoded.data(), int(encoded.size()), &width, &height, &components, STBI_rgb_alpha));
+        result.bits = 16;
+    }
+    if (data == nullptr)
+    {
+        data        = stbi_load_from_memory(encoded.data(), int(encoded.size()), &width, &height, &components, STBI_rgb_alpha);
+        result.bits = 8;
+    }
+    if (data == nullptr)
+    {
+        std::cerr << "decodeImage() - could not decode image: " << stbi_failure_reason() << std::endl;
+        return result;
+    }
+
+    result.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+    result.size   = size_t(width) * height * 4 * (result.bits / 8);
+    return result;
+}
+
+// Reads only the image header while parsing and leaves decoding the pixels to the thread pool,
+// the images are decoded concurrently and waited for when the textures are created.
+bool loadImageDeferred(tinygltf::Image* image, const int imageIndex, std::string* errors, std::string* warnings,
+                       int requestedWidth, int requestedHeight, const unsigned char* bytes, int size, void* userData)
+{
+    if (isKtx2(bytes, size))
+    {
+        // Only the pixels of the levels are copied, there is nothing to decode
+        DecodedImage result;
+        result.image = readKtx2(bytes, size);
+        if (!result.image.has_value())
+        {
+            if (errors) *errors += "Unsupported KTX2 image[" + std::to_string(imageIndex) + "] " + image->name + "\n";
+            return false;
+        }
+
+        image->width        = result.image->width;
+        image->height       = result.image->height;
+        image->component    = 4;
+        image->bits         = 8;
+        image->pixel_type   = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+
+        std::promise<DecodedImage> ready;
+        ready.set_value(std::move(result));
+        decodedImages[imageIndex] = ready.get_future().share();
+        return true;
+    }
+
+    int width, height, components = 0;
+    if (!stbi_info_from_memory(bytes, size, &width, &height, &components))
+    {
+        if (errors) *errors += "Unknown image format for image[" + std::to_string(imageIndex) + "] " + image->name + "\n";
+        return false;
+    }
+
+    bool is16Bit = stbi_is_16_bit_from_memory(bytes, size);
+
+    // Like the default loader, images are expanded to RGBA
+    image->width        = width;
+    image->height       = height;
+    image->component    = 4;
+    image->bits         = is16Bit ? 16 : 8;
+    image->pixel_type   = is16Bit ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+
+    // The bytes only live during parsing, the encoded image is small compared to the decoded pixels
+    auto encoded = std::make_shared<std::vector<uint8_t>>(bytes, bytes + size);
+    decodedImages[imageIndex] = ThreadPool::shared().submit([encoded, is16Bit]()
+    {
+        return decodeImage(*encoded, is16Bit);
+    }).share();
+
+    return true;
+}
+
 std::optional<tinygltf::Model> loadGlTFModel(const std::string& filePath)
 {
     std::cout << "Loading glTF model from " << filePath << std::endl;
@@ -514,13 +771,55 @@ std::optional<tinygltf::Model> loadGlTFModel(const std::string& filePath)
     tinygltf::Model     model;
     std::string         errors;
     std::string         warnings;
-    
-    bool loaded = loader.LoadBinaryFromFile(&model, &errors, &warnings, filePath);
+
+    decodedImages.clear();
+    loader.SetImageLoader(loadImageDeferred, nullptr);
+
+    mappedModel = std::make_unique<MappedFile>(filePath);
+    binaryChunk = nullptr;
+
+    bool loaded = false;
+    if (mappedModel->isOpen() && mappedModel->size() >= 20)
+    {
+        std::string baseDirectory = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+        loaded = loader.LoadBinaryFromMemory(&model, &errors, &warnings, mappedModel->data(), uint32_t(mappedModel->size()), baseDirectory);
+    }
+    else
+    {
+        loaded = loader.LoadBinaryFromFile(&model, &errors, &warnings, filePath);
+    }
+
+    // tinygltf copies the binary chunk into the buffer while parsing, that copy is released and the
+    // accessors read the mapped file instead: header (12 bytes), json chunk, binary chunk header (8 bytes)
+    if (loaded && mappedModel->isOpen())
+    {
+        const uint8_t*  data        = mappedModel->data();
+        uint32_t        jsonLength  = 0;
+        std::memcpy(&jsonLength, data + 12, sizeof(jsonLength));
+
+        if (20 + size_t(jsonLength) + 8 <= mappedModel->size())
+        {
+            binaryChunk = data + 20 + jsonLength + 8;
+
+            for (tinygltf::Buffer& buffer: model.buffers)
+            {
+                if (buffer.uri.empty())
+                    std::vector<unsigned char>().swap(buffer.data);
+            }
+        }
+    }
     
     std::cout << "errors:"      << errors   << std::endl;
     std::cout << "warnings:"    << warnings << std::endl;
 
-    return loaded ? std::optional<tinygltf::Model>(model) : std::nullopt;
+    return loaded ? std::optional<tinygltf::Model>(std::move(model)) : std::nullopt;
+}
+
+void releaseGlTFModel()
+{
+    decodedImages.clear();
+    binaryChunk = nullptr;
+    mappedModel.reset();
 }
 
 Mesh loadModel(const std::string& filePath)
@@ -535,15 +834,21 @@ Mesh loadModel(const std::string& filePath)
     Mesh result;
     mat4 nodeTransform = mat4(1.0);
 
+    // Normals and tangents are generated once for all primitives, in parallel
+    std::vector<MeshRange> ranges;
+    std::vector<MeshRange> rangesWithoutNormals;
     for (tinygltf::Scene& scene: model.scenes)
     {
         for (int nodeIndex : scene.nodes)
         {
             tinygltf::Node& node = model.nodes[nodeIndex];
             std::cout << "traversing node " << node.name << std::endl;
-            traverseNodes(model, node, result, nodeTransform);
+            traverseNodes(model, node, result, nodeTransform, ranges, rangesWithoutNormals);
         }
     }
+    result.generateNormals          (rangesWithoutNormals);
+    result.generateTangentVectors   (ranges);
+    releaseGlTFModel();
 
     return result;
 }
@@ -551,6 +856,7 @@ Mesh loadModel(const std::string& filePath)
 std::unique_ptr<Scene> loadModelObjects(const std::string &filePath, Object &parent)
 {
     imageCache.clear();
+    meshCache.clear();
     auto result = std::make_unique<Scene>();
 
     std::optional<tinygltf::Model>  loadResult = loadGlTFModel(filePath);
@@ -568,6 +874,7 @@ std::unique_ptr<Scene> loadModelObjects(const std::string &filePath, Object &par
             traverseNodes(model, node, *result, parent, transform);
         }
     }
+    releaseGlTFModel();
 
     return result;
 }
@@ -575,17 +882,60 @@ std::unique_ptr<Scene> loadModelObjects(const std::string &filePath, Object &par
 Image loadImage(const std::string &filePath)
 {
     std::cout << "loadImage() - " << filePath << std::endl;
+
+    MappedFile file(filePath);
+    if (file.isOpen() && isKtx2(file.data(), file.size()))
+        return readKtx2(file.data(), file.size()).value_or(Image());
+
     int x, y, n = 0;
     unsigned char *data = stbi_load(filePath.c_str(), &x, &y, &n, STBI_rgb_alpha); 
+    if (data == nullptr)
+    {
+        std::cerr << "loadImage() - could not load " << filePath << std::endl;
+        return Image();
+    }
 
     Image image;
     image.bytesPerPixel = 4;
     image.width         = x;
     image.height        = y;
 
-    image.pixels->assign(data, data + x * y * 4);
+    image.setExternalPixels(std::shared_ptr<unsigned char>(data, stbi_image_free), data, size_t(x) * y * 4);
 
     image.type = Image::Type::RGBA;
-    stbi_image_free(data);
     return image;
 }
+
+bool saveImage(const std::string& filePath, const Image& image)
+{
+    std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    const int components = image.bytesPerPixel;
+
+    int result = 0;
+    if (extension == "png")
+        result = stbi_write_png(filePath.c_str(), image.width, image.height, components, image.getPixels(), image.width * components);
+    else if (extension == "bmp")
+        result = stbi_write_bmp(filePath.c_str(), image.width, image.height, components, image.getPixels());
+    else if (extension == "tga")
+        result = stbi_write_tga(filePath.c_str(), image.width, image.height, components, image.getPixels());
+    else if (extension == "hdr")
+    {
+        std::vector<float> linear(image.bytes());
+        for (size_t i = 0; i < linear.size(); i++)
+        {
+            float value = image.getPixels()[i] / 255.0f;
+            bool  alpha = components == 4 && i % 4 == 3;
+            linear[i] = alpha ? value : (value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f));
+        }
+        result = stbi_write_hdr(filePath.c_str(), image.width, image.height, components, linear.data());
+    }
+    else
+        std::cerr << "saveImage() - unsupported file type: " << filePath << std::endl;
+
+    if (result == 0)
+        std::cerr << "saveImage() - could not write " << filePath << std::endl;
+
+    return result != 0;
+}
@@ -14,5 +14,9 @@ Mesh loadModel(const std::string& filePath);
 // Loads the gltf model in a scene graph under parent, respecting the individual components in the model
 std::unique_ptr<Scene> loadModelObjects(const std::string &filePath, Object &parent);
 
-// Loads an image from the given file path. Can be one of: jpg, png, tga, bmp, psd, gif, hdr radiance rgbE
-Image loadImage(const std::string& filePath);
\ No newline at end of file
+// Loads an image from the given file path. Can be one of: jpg, png, tga, bmp, psd, gif, hdr radiance rgbE, ktx2
+Image loadImage(const std::string& filePath);
+
+// Saves an image to the given file path, the format follows the extension: png, bmp, tga or hdr.
+// Pixels are expected to be sRGB encoded RGBA, for hdr they are converted to linear values.
+bool saveImage(const std::string& filePath, const Image& image);
@@ -0,0 +1,101 @@
+#include "mappedfile.h"
+
+#include <fstream>
+#include <iostream>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+    #if defined(_WIN32)
+
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "MappedFile() - could not open " << filePath << std::endl;
+        return;
+    }
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return;
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr) return;
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    m_size = m_data ? size_t(size.QuadPart) : 0;
+
+    #elif defined(__EMSCRIPTEN__)
+
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        std::cerr << "MappedFile() - could not open " << filePath << std::endl;
+        return;
+    }
+    m_contents.resize(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(m_contents.data()), m_contents.size());
+
+    m_data = m_contents.data();
+    m_size = m_contents.size();
+
+    #else
+
+    int file = open(filePath.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        std::cerr << "MappedFile() - could not open " << filePath << std::endl;
+        return;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping != MAP_FAILED)
+        {
+            m_data = static_cast<const uint8_t*>(mapping);
+            m_size = size_t(status.st_size);
+        }
+    }
+    // The mapping stays valid after closing the descriptor
+    close(file);
+
+    #endif
+}
+
+MappedFile::~MappedFile()
+{
+    #if defined(_WIN32)
+    if (m_data)     UnmapViewOfFile(m_data);
+    if (m_mapping)  CloseHandle(m_mapping);
+    if (m_file)     CloseHandle(m_file);
+    #elif !defined(__EMSCRIPTEN__)
+    if (m_data)     munmap(const_cast<uint8_t*>(m_data), m_size);
+    #endif
+}
+
+bool MappedFile::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+const uint8_t* MappedFile::data() const
+{
+    return m_data;
+}
+
+size_t MappedFile::size() const
+{
+    return m_size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read only view of a file's contents. The file is memory mapped where the platform supports it,
+// so its pages are loaded on access and shared with the page cache instead of copied to the heap.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& filePath);
+    ~MappedFile();
+
+    bool isOpen() const;
+
+    const uint8_t*  data() const;
+    size_t          size() const;
+
+private:
+    const uint8_t*          m_data      = nullptr;
+    size_t                  m_size      = 0;
+
+    // Holds the contents on platforms without memory mapping
+    std::vector<uint8_t>    m_contents;
+
+    #ifdef _WIN32
+    void*                   m_file      = nullptr;
+    void*                   m_mapping   = nullptr;
+    #endif // _WIN32
+
+    MappedFile (const MappedFile&)              = delete;
+    MappedFile& operator= (const MappedFile&)   = delete;
+};
@@ -0,0 +1,535 @@
+#include "scenepack.h"
+
+#include "mappedfile.h"
+#include "blockcompression.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+
+using namespace glm;
+
+const uint32_t  packMagic       = 0x4b415053; // "SPAK"
+const uint32_t  packVersion     = 3;
+const size_t    packAlignment   = 16;
+const size_t    packMaxLods     = 4;
+
+struct PackHeader
+{
+    uint32_t    magic;
+    uint32_t    version;
+
+    uint32_t    nodeCount;
+    uint32_t    meshCount;
+    uint32_t    materialCount;
+    uint32_t    imageCount;
+
+    uint64_t    nodesOffset;
+    uint64_t    meshesOffset;
+    uint64_t    materialsOffset;
+    uint64_t    imagesOffset;
+
+    // Images of the environment cubemap faces, -1 without environment map
+    int32_t     environmentMap[6];
+    uint32_t    padding[2];
+};
+
+struct PackNode
+{
+    int32_t     parent;     // -1 for children of the object the pack is loaded under
+    int32_t     mesh;       // -1 for nodes that only transform their children
+    int32_t     material;
+    uint32_t    padding;
+    float       transform[16];
+};
+
+struct PackMesh
+{
+    uint64_t    verticesOffset;
+    uint64_t    vertexCount;
+    uint64_t    indicesOffset;
+    uint64_t    triangleCount;
+    float       boxMin[3];
+    float       boxMax[3];
+
+    // The triangles of the levels of detail follow the ones of the full mesh
+    uint32_t    lodCount;
+    uint32_t    lodTriangleCounts[packMaxLods];
+    float       lodErrors[packMaxLods];
+    uint32_t    padding;
+};
+
+struct PackTextureTransforms
+{
+    float       offset[2];
+    float       scale[2];
+    float       rotation;
+    int32_t     uvSet;
+};
+
+struct PackMaterial
+{
+    float       albedo[3];
+    float       roughness;
+    float       metallic;
+    float       normalMapScale;
+    uint32_t    castsShadow;
+    uint32_t    shaded;
+
+    // Indices in the images, -1 when the material doesn't use the texture
+    int32_t     baseColorTexture;
+    int32_t     metallicRoughness;
+    int32_t     emissive;
+    int32_t     normalMap;
+    int32_t     occlusion;
+    uint32_t    padding;
+
+    PackTextureTransforms baseColorTransforms;
+    PackTextureTransforms metallicRoughnessTransforms;
+};
+
+struct PackImage
+{
+    uint64_t    pixelsOffset;
+    uint64_t    pixelsSize;
+    int32_t     width;
+    int32_t     height;
+    int32_t     bytesPerPixel;
+    int32_t     type;
+    int32_t     mipLevelCount;
+    uint32_t    padding;
+};
+
+// Builds the pack in memory, every appended block starts aligned
+class PackWriter
+{
+public:
+    std::vector<uint8_t> data;
+
+    uint64_t append(const void* block, size_t size)
+    {
+        data.resize((data.size() + packAlignment - 1) / packAlignment * packAlignment);
+
+        uint64_t offset = data.size();
+        data.insert(data.end(), static_cast<const uint8_t*>(block), static_cast<const uint8_t*>(block) + size);
+        return offset;
+    }
+
+    template <typename T>
+    uint64_t append(const std::vector<T>& items)
+    {
+        return append(items.data(), items.size() * sizeof(T));
+    }
+};
+
+int maxMipLevels(const Image& image)
+{
+    // The same limits as the textures use when they generate the mips themselves
+    return image.type == Image::Type::R8 || image.type == Image::Type::RG8 ? 1 : 10;
+}
+
+// What a material image is used for, which decides its color space and compressed format
+enum class PackImageUse
+{
+    BaseColor,
+    Emissive,
+    Data,
+    NormalMap,
+    Environment
+};
+
+bool hasAlpha(const Image& image)
+{
+    const uint8_t* pixels = image.getPixels();
+    for (size_t i = 3; i < size_t(image.width) * image.height * 4; i += 4)
+        if (pixels[i] != 255) return true;
+    return false;
+}
+
+// The block compressed type of an RGBA image, RGBA when it stays uncompressed
+Image::Type compressedType(const Image& image, PackImageUse use, TextureCompression compression)
+{
+    if (compression == TextureCompression::None || use == PackImageUse::Environment || !canCompress(image))
+        return Image::Type::RGBA;
+
+    switch (use)
+    {
+        case PackImageUse::BaseColor:
+            if (compression == TextureCompression::Quality) return Image::Type::BC7;
+            return hasAlpha(image) ? Image::Type::BC3 : Image::Type::BC1;
+        case PackImageUse::NormalMap:
+            return Image::Type::BC5;
+        default:
+            return Image::Type::BC1;
+    }
+}
+
+PackTextureTransforms toPack(const TextureTransforms& transforms)
+{
+    return PackTextureTransforms
+    {
+        .offset     = { transforms.offset.x, transforms.offset.y },
+        .scale      = { transforms.scale.x, transforms.scale.y },
+        .rotation   = transforms.rotation,
+        .uvSet      = transforms.uvSet
+    };
+}
+
+TextureTransforms fromPack(const PackTextureTransforms& transforms)
+{
+    TextureTransforms result;
+    result.offset   = vec2(transforms.offset[0], transforms.offset[1]);
+    result.scale    = vec2(transforms.scale[0], transforms.scale[1]);
+    result.rotation = transforms.rotation;
+    result.uvSet    = transforms.uvSet;
+    return result;
+}
+
+bool saveScenePack(const std::string& filePath, Scene& scene, const Object& parent, const Cubemap* environmentMap,
+                   TextureCompression compression)
+{
+    std::vector<PackNode>       nodes;
+    std::vector<PackMesh>       meshes;
+    std::vector<PackMaterial>   materials;
+
+    std::map<const Object*, int32_t>                nodeIndices;
+    std::map<const std::vector<Vertex>*, int32_t>   meshIndices;
+    std::map<const uint8_t*, int32_t>               imageIndices;
+    std::vector<std::future<Image>>                 images;
+
+    PackWriter writer;
+    writer.data.resize(sizeof(PackHeader));
+
+    // Images are referred to by their pixels, the mip chains are generated and compressed on the thread pool.
+    // Color images are sRGB encoded and filtered in linear space. Images that are compressed already, from
+    // KTX2 files, are stored as they are.
+    auto addImage = [&](const Image& image, PackImageUse use) -> int32_t
+    {
+        auto found = imageIndices.find(image.getPixels());
+        if (found != imageIndices.end()) return found->second;
+
+        bool  srgb = use == PackImageUse::BaseColor || use == PackImageUse::Emissive || use == PackImageUse::Environment;
+        Image rgba = image.type == Image::Type::RGB || image.type == Image::Type::RGBA16 ? image.toRGBA() : image;
+        images.emplace_back(ThreadPool::shared().submit([rgba, srgb, use, compression]()
+        {
+            if (rgba.isBlockCompressed()) return rgba;
+
+            Image       levels  = rgba.generateMipMaps(maxMipLevels(rgba), srgb);
+            Image::Type type    = compressedType(levels, use, compression);
+            return type == Image::Type::RGBA ? levels : compressImage(levels, type);
+        }));
+
+        return imageIndices[image.getPixels()] = int32_t(images.size() - 1);
+    };
+    auto addOptionalImage = [&](const std::optional<Image>& image, PackImageUse use) -> int32_t
+    {
+        return image.has_value() ? addImage(image.value(), use) : -1;
+    };
+
+    for (auto& renderableObject: scene.all())
+    {
+        const Object&       object      = renderableObject->getObject();
+        const Renderable&   renderable  = renderableObject->getRenderable();
+
+        PackNode node {};
+        node.parent     = -1;
+        node.mesh       = -1;
+        node.material   = -1;
+
+        auto parentIndex = nodeIndices.find(object.getParent());
+        if (parentIndex != nodeIndices.end())
+            node.parent = parentIndex->second;
+        else if (object.getParent() != &parent)
+            continue;
+
+        mat4 transform = object.getTransform();
+        std::memcpy(node.transform, &transform[0][0], sizeof(node.transform));
+
+        const Mesh& mesh = renderable.mesh;
+        if (!mesh.vertices().empty() && !mesh.indices().empty())
+        {
+            auto meshIndex = meshIndices.find(&mesh.vertices());
+            if (meshIndex == meshIndices.end())
+            {
+                PackMesh packMesh {};
+                packMesh.verticesOffset = writer.append(mesh.vertices());
+                packMesh.vertexCount    = mesh.vertices().size();
+                packMesh.triangleCount  = mesh.indices().size();
+                packMesh.lodCount       = uint32_t(std::min(mesh.lods().size(), packMaxLods));
+
+                std::vector<u32vec3> indices = mesh.indices();
+                for (uint32_t lod = 0; lod < packMesh.lodCount; lod++)
+                {
+                    packMesh.lodTriangleCounts[lod] = mesh.lods()[lod].indices.size();
+                    packMesh.lodErrors[lod]         = mesh.lods()[lod].error;
+                    indices.insert(indices.end(), mesh.lods()[lod].indices.begin(), mesh.lods()[lod].indices.end());
+                }
+                packMesh.indicesOffset  = writer.append(indices);
+                std::memcpy(packMesh.boxMin, &mesh.boundingBox.min[0], sizeof(packMesh.boxMin));
+                std::memcpy(packMesh.boxMax, &mesh.boundingBox.max[0], sizeof(packMesh.boxMax));
+
+                meshes.push_back(packMesh);
+                meshIndex = meshIndices.emplace(&mesh.vertices(), int32_t(meshes.size() - 1)).first;
+            }
+            node.mesh = meshIndex->second;
+
+            const Material& material = renderable.material;
+
+            PackMaterial packMaterial {};
+            std::memcpy(packMaterial.albedo, &material.albedo[0], sizeof(packMaterial.albedo));
+            packMaterial.roughness                      = material.roughness;
+            packMaterial.metallic                       = material.metallic;
+            packMaterial.normalMapScale                 = material.normalMapScale;
+            packMaterial.castsShadow                    = material.castsShadow;
+            packMaterial.shaded                         = material.shaded;
+            packMaterial.baseColorTexture               = addOptionalImage(material.baseColorTexture, PackImageUse::BaseColor);
+            packMaterial.metallicRoughness              = addOptionalImage(material.metallicRoughness, PackImageUse::Data);
+            packMaterial.emissive                       = addOptionalImage(material.emissive, PackImageUse::Emissive);
+            packMaterial.normalMap                      = addOptionalImage(material.normalMap, PackImageUse::NormalMap);
+            packMaterial.occlusion                      = addOptionalImage(material.occlusion, PackImageUse::Data);
+            packMaterial.baseColorTransforms            = toPack(material.baseColorTransforms);
+            packMaterial.metallicRoughnessTransforms    = toPack(material.metallicRoughnessTransforms);
+
+            materials.push_back(packMaterial);
+            node.material = int32_t(materials.size() - 1);
+        }
+
+        nodes.push_back(node);
+        nodeIndices[&object] = int32_t(nodes.size() - 1);
+    }
+
+    PackHeader header {};
+    header.magic    = packMagic;
+    header.version  = packVersion;
+
+    for (int i = 0; i < 6; i++)
+        header.environmentMap[i] = environmentMap ? addImage(environmentMap->faces(i), PackImageUse::Environment) : -1;
+
+    std::vector<PackImage> packImages;
+    for (auto& future: images)
+    {
+        Image image = future.get();
+
+        PackImage packImage {};
+        packImage.pixelsOffset  = writer.append(image.getPixels(), image.bytes());
+        packImage.pixelsSize    = image.bytes();
+        packImage.width         = image.width;
+        packImage.height        = image.height;
+        packImage.bytesPerPixel = image.bytesPerPixel;
+        packImage.type          = int32_t(image.type);
+        packImage.mipLevelCount = image.mipLevelCount;
+        packImages.push_back(packImage);
+    }
+
+    header.nodeCount        = uint32_t(nodes.size());
+    header.meshCount        = uint32_t(meshes.size());
+    header.materialCount    = uint32_t(materials.size());
+    header.imageCount       = uint32_t(packImages.size());
+    header.nodesOffset      = writer.append(nodes);
+    header.meshesOffset     = writer.append(meshes);
+    header.materialsOffset  = writer.append(materials);
+    header.imagesOffset     = writer.append(packImages);
+    std::memcpy(writer.data.data(), &header, sizeof(header));
+
+    std::ofstream file(filePath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+    if (!file)
+    {
+        std::cerr << "saveScenePack() - could not write " << filePath << std::endl;
+        return false;
+    }
+
+    std::cout << "saveScenePack() - " << filePath << ": " << nodes.size() << " nodes, " << meshes.size() << " meshes, "
+              << materials.size() << " materials, " << packImages.size() << " images, " << writer.data.size() << " bytes" << std::endl;
+    return true;
+}
+
+// Whether count elements at offset lie within the file, without overflowing the sum or the product
+bool inFile(const MappedFile& file, uint64_t offset, uint64_t count, uint64_t elementSize = 1)
+{
+    return offset <= file.size() && count <= (file.size() - offset) / elementSize;
+}
+
+// Pixel size of every image type, block compressed types have none
+int typeBytesPerPixel(Image::Type type)
+{
+    switch (type)
+    {
+        case Image::Type::RGBA16:   return 8;
+        case Image::Type::RGBA:     return 4;
+        case Image::Type::RGB:      return 3;
+        case Image::Type::RG8:      return 2;
+        case Image::Type::R8:       return 1;
+        default:                    return 0;
+    }
+}
+
+// Whether the dimensions, type and level count of a packed image describe a valid mip chain
+bool validImage(const PackImage& packImage)
+{
+    if (packImage.width <= 0 || packImage.height <= 0 || packImage.mipLevelCount <= 0) return false;
+    if (packImage.type < int32_t(Image::Type::RGBA16) || packImage.type > int32_t(Image::Type::ASTC)) return false;
+    if (packImage.bytesPerPixel != typeBytesPerPixel(Image::Type(packImage.type))) return false;
+
+    uint32_t chainLength = std::bit_width(uint32_t(std::max(packImage.width, packImage.height)));
+    return uint32_t(packImage.mipLevelCount) <= chainLength;
+}
+
+template <typename T>
+std::vector<T> readTable(const MappedFile& file, uint64_t offset, uint32_t count)
+{
+    std::vector<T> result;
+    if (!inFile(file, offset, count, sizeof(T))) return result;
+
+    result.resize(count);
+    std::memcpy(result.data(), file.data() + offset, count * sizeof(T));
+    return result;
+}
+
+std::unique_ptr<Scene> loadScenePack(const std::string& filePath, Object& parent)
+{
+    auto result = std::make_unique<Scene>();
+
+    auto file = std::make_shared<MappedFile>(filePath);
+    if (!file->isOpen() || file->size() < sizeof(PackHeader))
+    {
+        std::cerr << "loadScenePack() - could not read " << filePath << std::endl;
+        return result;
+    }
+
+    PackHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (header.magic != packMagic || header.version != packVersion)
+    {
+        std::cerr << "loadScenePack() - " << filePath << " is not a scene pack of version " << packVersion << std::endl;
+        return result;
+    }
+
+    auto nodes      = readTable<PackNode>       (*file, header.nodesOffset,     header.nodeCount);
+    auto meshes     = readTable<PackMesh>       (*file, header.meshesOffset,    header.meshCount);
+    auto materials  = readTable<PackMaterial>   (*file, header.materialsOffset, header.materialCount);
+    auto packImages = readTable<PackImage>      (*file, header.imagesOffset,    header.imageCount);
+
+    if (nodes.size() != header.nodeCount || meshes.size() != header.meshCount ||
+        materials.size() != header.materialCount || packImages.size() != header.imageCount)
+    {
+        std::cerr << "loadScenePack() - " << filePath << " is truncated" << std::endl;
+        return result;
+    }
+
+    // The pixels are not copied, the images keep the file mapped and are uploaded from it
+    std::vector<Image> images(packImages.size());
+    for (size_t i = 0; i < packImages.size(); i++)
+    {
+        const PackImage& packImage = packImages[i];
+        if (!validImage(packImage) || !inFile(*file, packImage.pixelsOffset, packImage.pixelsSize)) continue;
+
+        Image image;
+        image.width         = packImage.width;
+        image.height        = packImage.height;
+        image.bytesPerPixel = packImage.bytesPerPixel;
+        image.type          = Image::Type(packImage.type);
+        image.mipLevelCount = packImage.mipLevelCount;
+
+        // The textures read the whole chain from the mapping
+        if (packImage.pixelsSize < image.mipLevelOffset(image.mipLevelCount))
+        {
+            std::cerr << "loadScenePack() - " << filePath << ": pixels of image " << i << " are truncated" << std::endl;
+            continue;
+        }
+
+        image.setExternalPixels(file, file->data() + packImage.pixelsOffset, packImage.pixelsSize);
+        images[i] = std::move(image);
+    }
+    auto optionalImage = [&](int32_t index) -> std::optional<Image>
+    {
+        if (index < 0 || index >= int32_t(images.size())) return std::nullopt;
+        return images[index];
+    };
+
+    // Vertices and indices are copied in bulk, the meshes own their data
+    std::vector<Mesh> packMeshes(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const PackMesh& packMesh = meshes[i];
+        if (!inFile(*file, packMesh.verticesOffset, packMesh.vertexCount, sizeof(Vertex))) continue;
+        if (!inFile(*file, packMesh.indicesOffset, packMesh.triangleCount, sizeof(u32vec3))) continue;
+        if (packMesh.lodCount > packMaxLods) continue;
+
+        uint64_t triangleCount = packMesh.triangleCount;
+        for (uint32_t lod = 0; lod < packMesh.lodCount; lod++)
+            triangleCount += packMesh.lodTriangleCounts[lod];
+        if (!inFile(*file, packMesh.indicesOffset, triangleCount, sizeof(u32vec3))) continue;
+
+        const Vertex*   vertices    = reinterpret_cast<const Vertex*>(file->data() + packMesh.verticesOffset);
+        const u32vec3*  indices     = reinterpret_cast<const u32vec3*>(file->data() + packMesh.indicesOffset);
+
+        Mesh& mesh = packMeshes[i];
+        mesh.vertices().assign(vertices, vertices + packMesh.vertexCount);
+        mesh.indices().assign(indices, indices + packMesh.triangleCount);
+
+        indices += packMesh.triangleCount;
+        for (uint32_t lod = 0; lod < packMesh.lodCount; lod++)
+        {
+            MeshLod& meshLod = mesh.lods().emplace_back();
+            meshLod.indices.assign(indices, indices + packMesh.lodTriangleCounts[lod]);
+            meshLod.error    = packMesh.lodErrors[lod];
+            indices         += packMesh.lodTriangleCounts[lod];
+        }
+        mesh.boundingBox.min = vec3(packMesh.boxMin[0], packMesh.boxMin[1], packMesh.boxMin[2]);
+        mesh.boundingBox.max = vec3(packMesh.boxMax[0], packMesh.boxMax[1], packMesh.boxMax[2]);
+    }
+
+    std::vector<Object*> objects;
+    for (const PackNode& node: nodes)
+    {
+        Object& nodeParent = node.parent >= 0 && node.parent < int32_t(objects.size()) ? *objects[node.parent] : parent;
+
+        mat4 transform;
+        std::memcpy(&transform[0][0], node.transform, sizeof(node.transform));
+
+        RenderableObject& item = result->newObject(nodeParent);
+        item.getObject().setTransform(transform);
+        objects.push_back(&item.getObject());
+
+        if (node.mesh >= 0 && node.mesh < int32_t(packMeshes.size()))
+            item.getRenderable().mesh = packMeshes[node.mesh];
+
+        if (node.material >= 0 && node.material < int32_t(materials.size()))
+        {
+            const PackMaterial& packMaterial    = materials[node.material];
+            Material&           material        = item.getRenderable().material;
+
+            material.albedo                         = vec3(packMaterial.albedo[0], packMaterial.albedo[1], packMaterial.albedo[2]);
+            material.roughness                      = packMaterial.roughness;
+            material.metallic                       = packMaterial.metallic;
+            material.normalMapScale                 = packMaterial.normalMapScale;
+            material.castsShadow                    = packMaterial.castsShadow != 0;
+            material.shaded                         = packMaterial.shaded != 0;
+            material.baseColorTexture               = optionalImage(packMaterial.baseColorTexture);
+            material.metallicRoughness              = optionalImage(packMaterial.metallicRoughness);
+            material.emissive                       = optionalImage(packMaterial.emissive);
+            material.normalMap                      = optionalImage(packMaterial.normalMap);
+            material.occlusion                      = optionalImage(packMaterial.occlusion);
+            material.baseColorTransforms            = fromPack(packMaterial.baseColorTransforms);
+            material.metallicRoughnessTransforms    = fromPack(packMaterial.metallicRoughnessTransforms);
+        }
+    }
+
+    if (header.environmentMap[0] >= 0)
+    {
+        auto face = [&](int i) { return optionalImage(header.environmentMap[i]).value_or(Image()); };
+
+        result->m_ownedEnvironmentMap = std::make_unique<Cubemap>(face(0), face(1), face(2), face(3), face(4), face(5));
+        result->m_environmentMap      = result->m_ownedEnvironmentMap.get();
+    }
+
+    std::cout << "loadScenePack() - " << filePath << ": " << nodes.size() << " nodes, " << meshes.size() << " meshes, "
+              << images.size() << " images" << std::endl;
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "object.h"
+#include "scene.h"
+#include "cubemap.h"
+
+#include <memory>
+#include <string>
+
+// A scene pack is the result of loading a model once, stored in a single binary file that is memory mapped
+// at runtime: the node hierarchy with transforms, vertex and index data in the GPU layout, materials and
+// images with their complete mip chains, block compressed, including the environment cubemap. All offsets are relative to
+// the start of the file, so the file can be mapped anywhere.
+
+// How the material images are block compressed: Quality encodes color images as BC7, Fast as BC1 or, with
+// alpha, BC3. Both use BC1 for the other color and data images and BC5 for normal maps. The environment map
+// and images with sizes that aren't multiples of 4 stay uncompressed.
+enum class TextureCompression
+{
+    None,
+    Fast,
+    Quality
+};
+
+// Writes the renderables of scene that are descendants of parent, the environment map is optional
+bool saveScenePack(const std::string& filePath, Scene& scene, const Object& parent, const Cubemap* environmentMap,
+                   TextureCompression compression = TextureCompression::Quality);
+
+// Maps a scene pack and creates its objects under parent. The images keep referring to the mapped file,
+// when the pack contains an environment map it is owned by the scene.
+std::unique_ptr<Scene> loadScenePack(const std::string& filePath, Object& parent);
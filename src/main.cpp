@@ -20,12 +20,42 @@
 #include "object.h"
 #include "animator.h"
 #include "io/loader.h"
+#include "io/scenepack.h"
 #include "inputs/roll.h"
+#include "batchrender.h"
+#include "threadpool.h"
 
 using namespace glm;
 
-int main (int, char**)
+int main (int argc, char** argv)
 {
+    std::string packPath;
+    Gpu::Params gpuParams;
+    int         textureBudget = 0;
+    int         uploadBudget  = 0;
+    bool        depthPrepass  = false;
+    int         shadowSamples = 16;
+    ShadowFilter shadowFilter = ShadowFilter::Pcf;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--batch")
+            return runBatchRender(argc, argv);
+        if (std::string(argv[i]) == "--pack" && i + 1 < argc)
+            packPath = argv[++i];
+        if (std::string(argv[i]) == "--full-vertices")
+            gpuParams.vertexFormat = VertexBuffer::Format::Full;
+        if (std::string(argv[i]) == "--texture-budget" && i + 1 < argc)
+            textureBudget = std::atoi(argv[++i]);
+        if (std::string(argv[i]) == "--upload-budget" && i + 1 < argc)
+            uploadBudget = std::atoi(argv[++i]);
+        if (std::string(argv[i]) == "--depth-prepass")
+            depthPrepass = true;
+        if (std::string(argv[i]) == "--shadow-samples" && i + 1 < argc)
+            shadowSamples = std::atoi(argv[++i]);
+        if (std::string(argv[i]) == "--shadow-filter" && i + 1 < argc)
+            shadowFilter = std::string(argv[++i]) == "evsm" ? ShadowFilter::Evsm : ShadowFilter::Pcf;
+    }
+
     #ifdef GLM_FORCE_LEFT_HANDED
         std::cout << "GLM left handed" << std::endl;
     #else
@@ -38,27 +68,60 @@ int main (int, char**)
         std::cout << "Depth 1 .. -1" << std::endl;
     #endif
 
-    Gpu             gpu;
+    Gpu             gpu(gpuParams);
     Scheduler       scheduler;
     WindowTarget    windowTarget(gpu);
 
+    // Video memory for textures in MB, textures that weren't drawn recently lose their finest levels beyond it
+    if (textureBudget > 0)
+    {
+        TextureStreamer::Params streamerParams = gpu.getResourcePool().getTextureStreamer().getParams();
+        streamerParams.budgetBytes = uint64_t(textureBudget) << 20;
+        gpu.getResourcePool().getTextureStreamer().setParams(streamerParams);
+    }
+
+    // Upload bytes per frame in MB, new meshes and finer texture levels beyond it wait for the next frames
+    if (uploadBudget > 0)
+        gpu.getUploadManager().setFrameBudget(uint64_t(uploadBudget) << 20);
+
     Object          root;
     Object          sceneParent(root);
     CameraObject    camera  = CameraObject(root);
     LightObject     light   = LightObject(camera);
 
-    Cubemap reflectionMap;
-    reflectionMap.positiveX = loadImage("./cubemap/px.png");
-    reflectionMap.negativeX = loadImage("./cubemap/nx.png");
-    reflectionMap.positiveY = loadImage("./cubemap/py.png");
-    reflectionMap.negativeY = loadImage("./cubemap/ny.png");
-    reflectionMap.positiveZ = loadImage("./cubemap/pz.png");
-    reflectionMap.negativeZ = loadImage("./cubemap/nz.png"); 
-
-    std::unique_ptr<Scene> scene = loadModelObjects("./models/DamagedHelmet.glb", sceneParent);
-    scene->m_environmentMap = &reflectionMap;
+    // A scene pack made by the AssetCompiler is mapped and used as is, it contains the cubemap as well
+    std::unique_ptr<Scene>  scene;
+    Cubemap                 reflectionMap;
+    if (!packPath.empty())
+    {
+        scene = loadScenePack(packPath, sceneParent);
+    }
+    else
+    {
+        // The cubemap faces are decoded on the thread pool while the model loads
+        auto loadFace = [](const char* filePath) { return ThreadPool::shared().submit([filePath]() { return loadImage(filePath); }); };
+        auto positiveX = loadFace("./cubemap/px.png");
+        auto negativeX = loadFace("./cubemap/nx.png");
+        auto positiveY = loadFace("./cubemap/py.png");
+        auto negativeY = loadFace("./cubemap/ny.png");
+        auto positiveZ = loadFace("./cubemap/pz.png");
+        auto negativeZ = loadFace("./cubemap/nz.png");
+
+        scene = loadModelObjects("./models/DamagedHelmet.glb", sceneParent);
+
+        reflectionMap.positiveX = positiveX.get();
+        reflectionMap.negativeX = negativeX.get();
+        reflectionMap.positiveY = positiveY.get();
+        reflectionMap.negativeY = negativeY.get();
+        reflectionMap.positiveZ = positiveZ.get();
+        reflectionMap.negativeZ = negativeZ.get();
+        scene->m_environmentMap = &reflectionMap;
+    }
 
     std::unique_ptr<Viewport>        viewport = std::make_unique<Viewport>(scheduler, gpu, windowTarget, *scene);
+    viewport->setDepthPrepass(depthPrepass);
+    viewport->setShadowSamples(shadowSamples);
+    viewport->setShadowFilter(shadowFilter);
 
     sceneParent  .setTransform(scale(mat4(1.0), vec3(5.0)));
 
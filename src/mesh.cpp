@@ -1,9 +1,50 @@
 #include "mesh.h"
+#include "meshoptimizer.h"
+#include "threadpool.h"
 #include "iostream"
 #include <glm/ext/scalar_constants.hpp>
+#include <glm/gtc/packing.hpp>
 
 using namespace glm;
 
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex has to match the packed VertexBuffer::Layout");
+
+// Maps a unit vector on the octahedron and unfolds the lower half, decoded by octahedralDecode in colorpass.wgsl
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 result = vec2(n);
+    if (n.z < 0.0f)
+    {
+        vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        result = (1.0f - abs(vec2(n.y, n.x))) * signs;
+    }
+    return result;
+}
+
+PackedVertex PackedVertex::pack(const Vertex& vertex)
+{
+    vec3 normal = vec3(vertex.normal);
+    if (!std::isfinite(length(normal)) || !(length(normal) > 1e-6f))
+        normal = vec3(0.0f, 0.0f, 1.0f);
+    normal = normalize(normal);
+
+    // Meshes without uvs end up without a valid tangent, any perpendicular direction will do
+    vec3 tangent = vec3(vertex.tangent);
+    if (!std::isfinite(length(tangent)) || !(length(tangent) > 1e-6f))
+        tangent = abs(normal.x) < 0.9f ? cross(normal, vec3(1.0f, 0.0f, 0.0f)) : cross(normal, vec3(0.0f, 1.0f, 0.0f));
+    tangent = normalize(tangent);
+
+    vec2 encodedNormal = octahedralEncode(normal);
+
+    PackedVertex result;
+    result.position = vec3(vertex.position);
+    result.normal   = i16vec2(round(clamp(encodedNormal, -1.0f, 1.0f) * 32767.0f));
+    result.tangent  = i8vec4(i8vec3(round(tangent * 127.0f)), vertex.tangent.w < 0.0f ? -127 : 127);
+    result.uv       = u16vec2(packHalf1x16(vertex.uv.x), packHalf1x16(vertex.uv.y));
+    return result;
+}
+
 Mesh::Mesh()
 {
 
@@ -41,9 +82,159 @@ std::vector<glm::u32vec3> &Mesh::indices() const
     return *indicesData;
 }
 
+std::vector<MeshLod> &Mesh::lods() const
+{
+    return *lodData;
+}
+
+// Sums a value computed per triangle on the vertices of the triangle. The values of all triangles are computed in
+// parallel first, then each vertex sums the values of its triangles in triangle order, so no vertex is written by
+// more than one thread and the sums don't depend on the scheduling. Corners outside the vertices of their range
+// are ignored.
+template <typename Value, typename TriangleValue, typename VertexResult>
+void accumulateOnVertices(const std::vector<u32vec3>& triangles, const std::vector<MeshRange>& ranges, size_t nrVertices,
+                          TriangleValue triangleValue, VertexResult vertexResult)
+{
+    if (ranges.empty()) return;
+
+    const size_t grainSize = 4096;
+
+    // Small ranges share a chunk, large ones are split
+    struct Chunk
+    {
+        size_t range;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<Chunk>  triangleChunks;
+    std::vector<Chunk>  vertexChunks;
+    std::vector<size_t> adjacencyStarts;
+    size_t              adjacencySize = 0;
+    for (size_t r = 0; r < ranges.size(); r++)
+    {
+        const MeshRange& range = ranges[r];
+        for (size_t begin = 0; begin < range.triangleCount; begin += grainSize)
+            triangleChunks.push_back(Chunk { r, range.firstTriangle + begin, range.firstTriangle + std::min(range.triangleCount, begin + grainSize) });
+        for (size_t begin = 0; begin < range.vertexCount; begin += grainSize)
+            vertexChunks.push_back(Chunk { r, range.firstVertex + begin, range.firstVertex + std::min(range.vertexCount, begin + grainSize) });
+
+        adjacencyStarts.push_back(adjacencySize);
+        adjacencySize += range.triangleCount * 3;
+    }
+
+    auto inRange = [&](const MeshRange& range, uint32_t vertex)
+    {
+        return vertex >= range.firstVertex && vertex < range.firstVertex + range.vertexCount && vertex < nrVertices;
+    };
+
+    ThreadPool& pool = ThreadPool::shared();
+
+    std::vector<Value> values(triangles.size());
+    pool.parallelFor(triangleChunks.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c++)
+            for (size_t t = triangleChunks[c].begin; t < triangleChunks[c].end; t++)
+                values[t] = triangleValue(triangles[t]);
+    });
+
+    // Triangles of each vertex in triangle order, the ranges don't share vertices so each builds its own part
+    std::vector<uint32_t> firstTriangle(nrVertices, 0);
+    std::vector<uint32_t> triangleCount(nrVertices, 0);
+    std::vector<uint32_t> adjacency(adjacencySize);
+    pool.parallelFor(ranges.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t r = begin; r < end; r++)
+        {
+            const MeshRange& range = ranges[r];
+            for (size_t t = range.firstTriangle; t < range.firstTriangle + range.triangleCount; t++)
+                for (int i = 0; i < 3; i++)
+                    if (inRange(range, triangles[t][i])) triangleCount[triangles[t][i]]++;
+
+            size_t next = adjacencyStarts[r];
+            for (size_t v = range.firstVertex; v < std::min(range.firstVertex + range.vertexCount, nrVertices); v++)
+            {
+                firstTriangle[v]    = next;
+                next               += triangleCount[v];
+                triangleCount[v]    = 0;
+            }
+
+            for (size_t t = range.firstTriangle; t < range.firstTriangle + range.triangleCount; t++)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    uint32_t v = triangles[t][i];
+                    if (inRange(range, v)) adjacency[firstTriangle[v] + triangleCount[v]++] = t;
+                }
+            }
+        }
+    });
+
+    pool.parallelFor(vertexChunks.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c++)
+        {
+            for (size_t v = vertexChunks[c].begin; v < std::min(vertexChunks[c].end, nrVertices); v++)
+            {
+                Value sum {};
+                for (uint32_t i = firstTriangle[v]; i < firstTriangle[v] + triangleCount[v]; i++)
+                    sum += values[adjacency[i]];
+                vertexResult(v, sum);
+            }
+        }
+    });
+}
+
+std::vector<MeshRange> wholeMesh(const Mesh& mesh)
+{
+    return { MeshRange { .firstVertex = 0, .vertexCount = mesh.vertices().size(), .firstTriangle = 0, .triangleCount = mesh.indices().size() } };
+}
+
 void Mesh::generateNormals()
 {
-    // TODO: not yet implemented
+    generateNormals(wholeMesh(*this));
+}
+
+void Mesh::generateNormals(const std::vector<MeshRange>& ranges)
+{
+    std::vector<Vertex>& vertices = this->vertices();
+
+    // The cross product of two edges is the normal scaled by twice the area of the triangle
+    auto triangleNormal = [&](const u32vec3& triangle)
+    {
+        vec3 p0 = vec3(vertices[triangle.x].position);
+        vec3 p1 = vec3(vertices[triangle.y].position);
+        vec3 p2 = vec3(vertices[triangle.z].position);
+        return cross(p1 - p0, p2 - p0);
+    };
+
+    auto vertexNormal = [&](size_t v, const vec3& sum)
+    {
+        float sumLength = length(sum);
+        vertices[v].normal = sumLength > 0.0f ? vec4(sum / sumLength, 0.0f) : vec4(0.0f, 0.0f, 1.0f, 0.0f);
+    };
+
+    accumulateOnVertices<vec3>(indices(), ranges, vertices.size(), triangleNormal, vertexNormal);
+}
+
+void Mesh::generateLods(int maxLevels)
+{
+    lods().clear();
+
+    // Levels that don't remove a meaningful part of the triangles aren't worth switching to
+    std::vector<size_t> targets;
+    for (size_t target = indices().size() / 2; int(targets.size()) < maxLevels && target >= 64; target /= 2)
+        targets.push_back(target);
+
+    size_t previousCount = indices().size();
+    for (MeshLod& lod: simplifyMesh(*this, targets))
+    {
+        if (lod.indices.size() > previousCount * 3 / 4) break;
+        previousCount = lod.indices.size();
+
+        optimizeVertexCache(lod.indices, vertices().size());
+        lods().push_back(std::move(lod));
+    }
 }
 
 void Mesh::generateBoundingBox()
@@ -55,58 +246,59 @@ void Mesh::generateBoundingBox()
         boundingBox.expand(vertex.position);
 }
 
-void Mesh::generateTangentVectors()
+// Tangent and bitangent of a triangle, summed per vertex
+class TangentSum
 {
-    if (vertices().empty() || indices().empty()) return;
+public:
+    vec3 tangent    = vec3(0.0f);
+    vec3 bitangent  = vec3(0.0f);
 
-    for (const auto& index : indices())
+    TangentSum& operator+=(const TangentSum& rhs)
     {
-        Vertex& v0 = vertices()[index.x];
-        Vertex& v1 = vertices()[index.y];
-        Vertex& v2 = vertices()[index.z];
+        tangent     += rhs.tangent;
+        bitangent   += rhs.bitangent;
+        return *this;
+    }
+};
+
+void Mesh::generateTangentVectors()
+{
+    generateTangentVectors(wholeMesh(*this));
+}
+
+void Mesh::generateTangentVectors(const std::vector<MeshRange>& ranges)
+{
+    if (vertices().empty() || indices().empty()) return;
 
-        glm::vec3 pos1 = glm::vec3(v0.position);
-        glm::vec3 pos2 = glm::vec3(v1.position);
-        glm::vec3 pos3 = glm::vec3(v2.position);
+    std::vector<Vertex>& vertices = this->vertices();
 
-        glm::vec2 uv1 = v0.uv;
-        glm::vec2 uv2 = v1.uv;
-        glm::vec2 uv3 = v2.uv;
+    auto triangleTangents = [&](const u32vec3& index)
+    {
+        const Vertex& v0 = vertices[index.x];
+        const Vertex& v1 = vertices[index.y];
+        const Vertex& v2 = vertices[index.z];
 
-        glm::vec3 edge1 = pos2 - pos1;
-        glm::vec3 edge2 = pos3 - pos1;
+        glm::vec3 edge1 = glm::vec3(v1.position) - glm::vec3(v0.position);
+        glm::vec3 edge2 = glm::vec3(v2.position) - glm::vec3(v0.position);
 
-        glm::vec2 deltaUV1 = uv2 - uv1;
-        glm::vec2 deltaUV2 = uv3 - uv1;
+        glm::vec2 deltaUV1 = v1.uv - v0.uv;
+        glm::vec2 deltaUV2 = v2.uv - v0.uv;
 
         float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
 
-        glm::vec3 tangent;
-        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-        tangent = glm::normalize(tangent);
-
-        glm::vec3 bitangent;
-        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-        bitangent = glm::normalize(bitangent);
-
-        v0.tangent += glm::vec4(tangent, 0.0f);
-        v1.tangent += glm::vec4(tangent, 0.0f);
-        v2.tangent += glm::vec4(tangent, 0.0f);
-
-        v0.bitangent += glm::vec4(bitangent, 0.0f);
-        v1.bitangent += glm::vec4(bitangent, 0.0f);
-        v2.bitangent += glm::vec4(bitangent, 0.0f);
-    }
+        TangentSum result;
+        result.tangent      = glm::normalize(f * (deltaUV2.y * edge1 - deltaUV1.y * edge2));
+        result.bitangent    = glm::normalize(f * (-deltaUV2.x * edge1 + deltaUV1.x * edge2));
+        return result;
+    };
 
     // Normalize tangents and apply Gram-Schmidt orthogonalization
-    for (auto& vertex : vertices()) 
+    auto vertexTangents = [&](size_t v, const TangentSum& sum)
     {
+        Vertex& vertex = vertices[v];
+
         glm::vec3 normal    = glm::normalize(glm::vec3(vertex.normal));
-        glm::vec3 tangent   = glm::normalize(glm::vec3(vertex.tangent));
+        glm::vec3 tangent   = glm::normalize(sum.tangent);
 
         // Orthogonalize tangent
         tangent = glm::normalize(tangent - glm::dot(tangent, normal) * normal);
@@ -115,10 +307,12 @@ void Mesh::generateTangentVectors()
         glm::vec3 bitangent = glm::cross(normal, tangent);
 
         // Check and fix handedness
-        float handedness    = (glm::dot(glm::cross(normal, tangent), glm::vec3(vertex.bitangent)) < 0.0f) ? -1.0f : 1.0f;
+        float handedness    = (glm::dot(glm::cross(normal, tangent), sum.bitangent) < 0.0f) ? -1.0f : 1.0f;
         vertex.tangent      = glm::vec4(tangent, handedness);
         vertex.bitangent    = glm::vec4(bitangent, 0.0f);
-    }
+    };
+
+    accumulateOnVertices<TangentSum>(indices(), ranges, vertices.size(), triangleTangents, vertexTangents);
 }
 
 void Mesh::cube(float size)
@@ -328,6 +522,8 @@ void Mesh::copy(const Mesh &rhs)
 {
     vertexData  = rhs.vertexData;
     indicesData = rhs.indicesData;
+    lodData     = rhs.lodData;
+    boundingBox = rhs.boundingBox;
 }
 
 glm::vec3 Box::center() const
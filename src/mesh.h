@@ -26,6 +26,38 @@ public:
     glm::vec2 padding;
 };
 
+// Quantized vertex as stored in vertex buffers, 24 instead of 80 bytes: the position, an octahedral encoded normal,
+// the tangent with its handedness in w from which the shader derives the bitangent, and half float uvs.
+class PackedVertex
+{
+public:
+    glm::vec3       position;
+    glm::i16vec2    normal;
+    glm::i8vec4     tangent;
+    glm::u16vec2    uv;
+
+    static PackedVertex pack(const Vertex& vertex);
+};
+
+// A simplified version of a mesh that uses the same vertices. The error is the largest distance to the original
+// surface in model units.
+class MeshLod
+{
+public:
+    std::vector<glm::u32vec3>   indices;
+    float                       error = 0.0f;
+};
+
+// A part of a mesh, for example a glTF primitive, whose triangles only use vertices of the part
+class MeshRange
+{
+public:
+    size_t firstVertex      = 0;
+    size_t vertexCount      = 0;
+    size_t firstTriangle    = 0;
+    size_t triangleCount    = 0;
+};
+
 class Mesh
 {
 public:
@@ -40,11 +72,19 @@ public:
     std::vector<Vertex>&         vertices() const;
     std::vector<glm::u32vec3>&   indices() const;
 
+    // Levels of detail after the full mesh, each with about half the triangles of the previous one
+    std::vector<MeshLod>&        lods() const;
+
     Box boundingBox;
 
+    // Area weighted vertex normals and per vertex tangents, for the whole mesh or only the given ranges. The ranges
+    // are split in chunks that run on the shared thread pool, the results don't depend on the number of threads.
     void generateNormals();
+    void generateNormals(const std::vector<MeshRange>& ranges);
     void generateBoundingBox();
     void generateTangentVectors();
+    void generateTangentVectors(const std::vector<MeshRange>& ranges);
+    void generateLods(int maxLevels = 3);
 
     void cube       (float size);
     void noisySphere(float radius, int rings, int sectors, float noiseAmplitude);
@@ -55,6 +95,7 @@ public:
 private:
     std::shared_ptr<std::vector<Vertex>>        vertexData  = std::make_shared<std::vector<Vertex>>();
     std::shared_ptr<std::vector<glm::u32vec3>>  indicesData = std::make_shared<std::vector<glm::u32vec3>>();
+    std::shared_ptr<std::vector<MeshLod>>       lodData     = std::make_shared<std::vector<MeshLod>>();
 
     void copy(const Mesh& rhs);
 
@@ -0,0 +1,624 @@
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+
+using namespace glm;
+
+MeshStatistics getMeshStatistics(const Mesh& mesh, int cacheSize)
+{
+    MeshStatistics result;
+    result.vertices     = mesh.vertices().size();
+    result.triangles    = mesh.indices().size();
+    result.vertexBytes  = result.vertices * sizeof(Vertex);
+
+    size_t indexSize    = result.vertices <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+    result.indexBytes   = (result.triangles * 3 * indexSize + 3) & ~size_t(3);
+
+    if (result.triangles == 0) return result;
+
+    // A vertex is in the cache when fewer than cacheSize vertices were added after it
+    std::vector<uint32_t>   addedAt(result.vertices, 0);
+    uint32_t                time    = cacheSize + 1;
+    size_t                  misses  = 0;
+    for (const u32vec3& triangle: mesh.indices())
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (time - addedAt[triangle[i]] > uint32_t(cacheSize))
+            {
+                addedAt[triangle[i]] = time++;
+                misses++;
+            }
+        }
+    }
+    result.acmr = float(misses) / float(result.triangles);
+    return result;
+}
+
+// FNV-1a over the bits of the attributes of a vertex
+template <size_t N>
+struct BitsHash
+{
+    size_t operator()(const std::array<uint32_t, N>& key) const
+    {
+        size_t hash = 14695981039346656037ull;
+        for (uint32_t value: key)
+            hash = (hash ^ value) * 1099511628211ull;
+        return hash;
+    }
+};
+
+void weldVertices(Mesh& mesh)
+{
+    using Key = std::array<uint32_t, 18>;
+
+    std::vector<Vertex>&                            vertices = mesh.vertices();
+    std::unordered_map<Key, uint32_t, BitsHash<18>> unique;
+    std::vector<uint32_t>                       remap(vertices.size());
+    std::vector<Vertex>                         welded;
+
+    unique.reserve(vertices.size());
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        // Only the attributes take part, the padding may hold anything
+        const Vertex& vertex = vertices[i];
+        Key key;
+        std::memcpy(&key[0],  &vertex.position,    sizeof(vec4));
+        std::memcpy(&key[4],  &vertex.normal,      sizeof(vec4));
+        std::memcpy(&key[8],  &vertex.tangent,     sizeof(vec4));
+        std::memcpy(&key[12], &vertex.bitangent,   sizeof(vec4));
+        std::memcpy(&key[16], &vertex.uv,          sizeof(vec2));
+
+        auto [found, inserted] = unique.emplace(key, uint32_t(welded.size()));
+        if (inserted)
+            welded.push_back(vertex);
+        remap[i] = found->second;
+    }
+
+    for (u32vec3& triangle: mesh.indices())
+        triangle = u32vec3(remap[triangle.x], remap[triangle.y], remap[triangle.z]);
+
+    vertices = std::move(welded);
+}
+
+const int   forsythCacheSize        = 32;
+const float forsythLastTriangle     = 0.75f;
+const float forsythCacheDecay       = 1.5f;
+const float forsythValenceScale     = 2.0f;
+const float forsythValencePower     = 0.5f;
+
+float forsythScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // The vertices of the last triangle get a fixed score, so the next triangle doesn't just reuse its edge
+        if (cachePosition < 3)
+            score = forsythLastTriangle;
+        else
+            score = std::pow(1.0f - float(cachePosition - 3) / float(forsythCacheSize - 3), forsythCacheDecay);
+    }
+
+    // Vertices with few triangles left are preferred, so they are finished and leave the cache
+    return score + forsythValenceScale * std::pow(float(remainingTriangles), -forsythValencePower);
+}
+
+void optimizeVertexCache(Mesh& mesh)
+{
+    optimizeVertexCache(mesh.indices(), mesh.vertices().size());
+}
+
+void optimizeVertexCache(std::vector<u32vec3>& triangles, size_t nrVertices)
+{
+    size_t                  nrTriangles     = triangles.size();
+    if (nrTriangles == 0) return;
+
+    // Triangles of each vertex, the ones not yet emitted are kept at the front
+    std::vector<uint32_t> remaining(nrVertices, 0);
+    for (const u32vec3& triangle: triangles)
+        for (int i = 0; i < 3; i++)
+            remaining[triangle[i]]++;
+
+    std::vector<uint32_t> offsets(nrVertices + 1, 0);
+    for (size_t v = 0; v < nrVertices; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<uint32_t> vertexTriangles(offsets.back());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < nrTriangles; t++)
+        for (int i = 0; i < 3; i++)
+            vertexTriangles[filled[triangles[t][i]]++] = t;
+
+    std::vector<int>    cachePositions  (nrVertices, -1);
+    std::vector<float>  vertexScores    (nrVertices);
+    std::vector<float>  triangleScores  (nrTriangles, 0.0f);
+    std::vector<bool>   emitted         (nrTriangles, false);
+
+    for (size_t v = 0; v < nrVertices; v++)
+        vertexScores[v] = forsythScore(-1, remaining[v]);
+    for (uint32_t t = 0; t < nrTriangles; t++)
+        triangleScores[t] = vertexScores[triangles[t].x] + vertexScores[triangles[t].y] + vertexScores[triangles[t].z];
+
+    std::vector<u32vec3>    result;
+    std::vector<uint32_t>   cache;
+    std::vector<uint32_t>   newCache;
+    result.reserve(nrTriangles);
+
+    uint32_t    best        = uint32_t(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+    uint32_t    nextInOrder = 0;
+
+    while (result.size() < nrTriangles)
+    {
+        const u32vec3 triangle = triangles[best];
+        emitted[best] = true;
+        result.push_back(triangle);
+
+        // Remove the triangle from the live triangles of its vertices
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t    v       = triangle[i];
+            uint32_t*   begin   = &vertexTriangles[offsets[v]];
+            uint32_t*   end     = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            remaining[v]--;
+        }
+
+        // The triangle's vertices move to the front of the cache
+        newCache.assign({ triangle.x, triangle.y, triangle.z });
+        for (uint32_t v: cache)
+            if (v != triangle.x && v != triangle.y && v != triangle.z)
+                newCache.push_back(v);
+
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            uint32_t v = newCache[i];
+            cachePositions[v] = i < size_t(forsythCacheSize) ? int(i) : -1;
+            vertexScores[v]   = forsythScore(cachePositions[v], remaining[v]);
+        }
+        if (newCache.size() > size_t(forsythCacheSize))
+            newCache.resize(forsythCacheSize);
+        std::swap(cache, newCache);
+
+        // Only triangles of vertices in the cache changed their score
+        float bestScore = -1.0f;
+        for (uint32_t v: cache)
+        {
+            for (uint32_t i = 0; i < remaining[v]; i++)
+            {
+                uint32_t t  = vertexTriangles[offsets[v] + i];
+                triangleScores[t] = vertexScores[triangles[t].x] + vertexScores[triangles[t].y] + vertexScores[triangles[t].z];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore   = triangleScores[t];
+                    best        = t;
+                }
+            }
+        }
+
+        // Nothing left around the cache, continue with the first triangle that wasn't emitted
+        if (bestScore < 0.0f && result.size() < nrTriangles)
+        {
+            while (emitted[nextInOrder])
+                nextInOrder++;
+            best = nextInOrder;
+        }
+    }
+
+    triangles = std::move(result);
+}
+
+void optimizeOverdraw(Mesh& mesh, float threshold)
+{
+    std::vector<u32vec3>&       triangles   = mesh.indices();
+    const std::vector<Vertex>&  vertices    = mesh.vertices();
+    if (triangles.size() < 2) return;
+
+    float originalAcmr = getMeshStatistics(mesh).acmr;
+
+    // Clusters start where the cache misses all vertices of a triangle, or where the cluster so far is more cache
+    // efficient than the mesh even though it started with an empty cache. Either way they can move without costing
+    // much, the margin leaves room for the misses at the cluster starts.
+    const uint32_t          cacheSize   = 16;
+    const float             targetAcmr  = originalAcmr / threshold;
+    std::vector<size_t>     clusterStarts;
+    std::vector<uint32_t>   addedAt(vertices.size(), 0);
+    uint32_t                time                = cacheSize + 1;
+    size_t                  clusterTriangles    = 0;
+    size_t                  clusterMisses       = 0;
+    for (size_t t = 0; t < triangles.size(); t++)
+    {
+        if (t == 0 || float(clusterMisses) <= targetAcmr * float(clusterTriangles))
+        {
+            clusterStarts.push_back(t);
+            clusterTriangles    = 0;
+            clusterMisses       = 0;
+            time               += cacheSize + 1;
+        }
+
+        int misses = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            if (time - addedAt[triangles[t][i]] > cacheSize)
+            {
+                addedAt[triangles[t][i]] = time++;
+                misses++;
+            }
+        }
+
+        if (misses == 3 && clusterTriangles > 0)
+        {
+            clusterStarts.push_back(t);
+            clusterTriangles    = 0;
+            clusterMisses       = 0;
+        }
+        clusterTriangles++;
+        clusterMisses += misses;
+    }
+    clusterStarts.push_back(triangles.size());
+
+    size_t nrClusters = clusterStarts.size() - 1;
+    if (nrClusters < 2) return;
+
+    vec3 meshCenter(0.0f);
+    for (const Vertex& vertex: vertices)
+        meshCenter += vec3(vertex.position);
+    meshCenter /= float(vertices.size());
+
+    // Clusters facing away from the center are likely in front of the others, drawing them first lets the
+    // depth test reject more of the hidden fragments
+    std::vector<float> sortKeys(nrClusters);
+    for (size_t c = 0; c < nrClusters; c++)
+    {
+        vec3    center(0.0f);
+        vec3    normal(0.0f);
+        float   area = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            vec3 p0 = vec3(vertices[triangles[t].x].position);
+            vec3 p1 = vec3(vertices[triangles[t].y].position);
+            vec3 p2 = vec3(vertices[triangles[t].z].position);
+
+            vec3  areaNormal    = cross(p1 - p0, p2 - p0);
+            float triangleArea  = length(areaNormal);
+
+            center  += (p0 + p1 + p2) / 3.0f * triangleArea;
+            normal  += areaNormal;
+            area    += triangleArea;
+        }
+        center = area > 0.0f ? center / area : vec3(vertices[triangles[clusterStarts[c]].x].position);
+        float normalLength = length(normal);
+        sortKeys[c] = normalLength > 0.0f ? dot(center - meshCenter, normal / normalLength) : 0.0f;
+    }
+
+    std::vector<size_t> order(nrClusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<u32vec3> sorted;
+    sorted.reserve(triangles.size());
+    for (size_t c: order)
+        sorted.insert(sorted.end(), triangles.begin() + clusterStarts[c], triangles.begin() + clusterStarts[c + 1]);
+
+    std::swap(triangles, sorted);
+    if (getMeshStatistics(mesh).acmr > originalAcmr * threshold)
+        std::swap(triangles, sorted);
+}
+
+void optimizeVertexFetch(Mesh& mesh)
+{
+    std::vector<Vertex>&    vertices = mesh.vertices();
+    std::vector<uint32_t>   remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex>     ordered;
+    ordered.reserve(vertices.size());
+
+    for (u32vec3& triangle: mesh.indices())
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t& index = triangle[i];
+            if (remap[index] == UINT32_MAX)
+            {
+                remap[index] = uint32_t(ordered.size());
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+    }
+
+    vertices = std::move(ordered);
+}
+
+// Symmetric 4x4 matrix of the summed squared distances to a set of planes, weighted by the area of their triangles
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0  = 0.0, b1  = 0.0, b2  = 0.0;
+    double c   = 0.0;
+    double weight = 0.0;
+
+    static Quadric plane(const dvec3& normal, double distance, double weight)
+    {
+        Quadric q;
+        q.a00 = weight * normal.x * normal.x; q.a01 = weight * normal.x * normal.y; q.a02 = weight * normal.x * normal.z;
+        q.a11 = weight * normal.y * normal.y; q.a12 = weight * normal.y * normal.z; q.a22 = weight * normal.z * normal.z;
+        q.b0  = weight * normal.x * distance; q.b1  = weight * normal.y * distance; q.b2  = weight * normal.z * distance;
+        q.c   = weight * distance * distance;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& rhs)
+    {
+        a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02; a11 += rhs.a11; a12 += rhs.a12; a22 += rhs.a22;
+        b0  += rhs.b0;  b1  += rhs.b1;  b2  += rhs.b2;
+        c   += rhs.c;
+        weight += rhs.weight;
+        return *this;
+    }
+
+    double error(const dvec3& p) const
+    {
+        double result = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                      + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                      + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z)
+                      + c;
+        return std::max(result, 0.0);
+    }
+};
+
+enum class VertexKind : uint8_t
+{
+    Interior,
+    Border,     // On an open edge, only collapses along the border
+    Locked      // Shares its position with other vertices or is on a non-manifold edge
+};
+
+struct Collapse
+{
+    uint32_t    from;
+    uint32_t    to;
+    double      cost;
+    float       error;
+};
+
+std::vector<MeshLod> simplifyMesh(const Mesh& mesh, const std::vector<size_t>& targetTriangleCounts)
+{
+    const std::vector<Vertex>&  vertices    = mesh.vertices();
+    std::vector<u32vec3>        triangles   = mesh.indices();
+    size_t                      nrVertices  = vertices.size();
+
+    std::vector<MeshLod> result;
+    if (targetTriangleCounts.empty() || triangles.empty()) return result;
+
+    std::vector<dvec3> positions(nrVertices);
+    for (size_t v = 0; v < nrVertices; v++)
+        positions[v] = dvec3(vec3(vertices[v].position));
+
+    // Vertices that only differ in their other attributes share a position id
+    std::unordered_map<std::array<uint32_t, 3>, uint32_t, BitsHash<3>>  positionIds;
+    std::vector<uint32_t>                                               positionOf(nrVertices);
+    std::vector<uint32_t>                                               verticesAtPosition;
+    for (size_t v = 0; v < nrVertices; v++)
+    {
+        std::array<uint32_t, 3> key;
+        std::memcpy(key.data(), &vertices[v].position, sizeof(key));
+
+        auto [found, inserted] = positionIds.emplace(key, uint32_t(verticesAtPosition.size()));
+        if (inserted)
+            verticesAtPosition.push_back(0);
+        positionOf[v] = found->second;
+        verticesAtPosition[found->second]++;
+    }
+
+    auto edgeKey = [&](uint32_t a, uint32_t b)
+    {
+        uint64_t pa = positionOf[a];
+        uint64_t pb = positionOf[b];
+        return pa < pb ? (pa << 32) | pb : (pb << 32) | pa;
+    };
+
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (const u32vec3& triangle: triangles)
+        for (int e = 0; e < 3; e++)
+            edgeUses[edgeKey(triangle[e], triangle[(e + 1) % 3])]++;
+
+    auto isBorderEdge = [&](uint32_t a, uint32_t b)
+    {
+        auto found = edgeUses.find(edgeKey(a, b));
+        return found != edgeUses.end() && found->second == 1;
+    };
+
+    std::vector<VertexKind> kinds(nrVertices, VertexKind::Interior);
+    std::vector<Quadric>    quadrics(nrVertices);
+    for (const u32vec3& triangle: triangles)
+    {
+        dvec3   p0          = positions[triangle.x];
+        dvec3   normal      = cross(positions[triangle.y] - p0, positions[triangle.z] - p0);
+        double  doubleArea  = length(normal);
+        if (doubleArea <= 0.0) continue;
+
+        normal /= doubleArea;
+        Quadric q = Quadric::plane(normal, -dot(normal, p0), doubleArea * 0.5);
+        for (int i = 0; i < 3; i++)
+            quadrics[triangle[i]] += q;
+
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a      = triangle[e];
+            uint32_t b      = triangle[(e + 1) % 3];
+            uint32_t uses   = edgeUses[edgeKey(a, b)];
+            if (uses > 2)
+            {
+                kinds[a] = kinds[b] = VertexKind::Locked;
+            }
+            else if (uses == 1)
+            {
+                // Keeps the border in place with a plane through the edge, perpendicular to the triangle
+                dvec3   edge        = positions[b] - positions[a];
+                dvec3   edgeNormal  = cross(edge, normal);
+                double  edgeLength  = length(edgeNormal);
+                if (edgeLength > 0.0)
+                {
+                    edgeNormal /= edgeLength;
+                    Quadric border = Quadric::plane(edgeNormal, -dot(edgeNormal, positions[a]), dot(edge, edge) * 10.0);
+                    border.weight  = 0.0;
+                    quadrics[a] += border;
+                    quadrics[b] += border;
+                }
+                for (uint32_t v: { a, b })
+                    if (kinds[v] == VertexKind::Interior) kinds[v] = VertexKind::Border;
+            }
+        }
+    }
+    for (size_t v = 0; v < nrVertices; v++)
+        if (verticesAtPosition[positionOf[v]] > 1) kinds[v] = VertexKind::Locked;
+
+    auto flips = [&](const std::vector<uint32_t>& adjacency, uint32_t first, uint32_t count, uint32_t from, uint32_t to)
+    {
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            const u32vec3& triangle = triangles[adjacency[i]];
+            if (triangle.x == to || triangle.y == to || triangle.z == to) continue; // Collapses, nothing to flip
+
+            dvec3 p[3]      = { positions[triangle.x], positions[triangle.y], positions[triangle.z] };
+            dvec3 before    = cross(p[1] - p[0], p[2] - p[0]);
+            for (dvec3& position: p)
+                if (position == positions[from]) position = positions[to];
+            dvec3 after     = cross(p[1] - p[0], p[2] - p[0]);
+
+            if (dot(before, after) <= 0.0) return true;
+        }
+        return false;
+    };
+
+    std::vector<uint32_t>   offsets(nrVertices + 1);
+    std::vector<uint32_t>   adjacency;
+    std::vector<uint32_t>   remap(nrVertices);
+    std::vector<uint8_t>    touched(nrVertices);
+    std::vector<Collapse>   collapses;
+    float                   maxError    = 0.0f;
+    size_t                  level       = 0;
+
+    while (level < targetTriangleCounts.size())
+    {
+        if (triangles.size() <= targetTriangleCounts[level])
+        {
+            result.push_back(MeshLod { .indices = triangles, .error = maxError });
+            level++;
+            continue;
+        }
+
+        // Triangles around each vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (const u32vec3& triangle: triangles)
+            for (int i = 0; i < 3; i++)
+                offsets[triangle[i] + 1]++;
+        for (size_t v = 0; v < nrVertices; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(offsets.back());
+        std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+        for (uint32_t t = 0; t < triangles.size(); t++)
+            for (int i = 0; i < 3; i++)
+                adjacency[filled[triangles[t][i]]++] = t;
+
+        collapses.clear();
+        for (const u32vec3& triangle: triangles)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                uint32_t a = triangle[e];
+                uint32_t b = triangle[(e + 1) % 3];
+                for (auto [from, to]: { std::pair(a, b), std::pair(b, a) })
+                {
+                    if (kinds[from] == VertexKind::Locked) continue;
+                    if (kinds[from] == VertexKind::Border && !isBorderEdge(from, to)) continue;
+
+                    Quadric q = quadrics[from];
+                    q += quadrics[to];
+                    double cost = q.error(positions[to]);
+                    float error = float(std::sqrt(q.weight > 0.0 ? cost / q.weight : cost));
+                    collapses.push_back(Collapse { .from = from, .to = to, .cost = cost, .error = error });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        // Each collapse removes about two triangles. Collapses within a pass don't share triangles, so their flip
+        // tests stay valid.
+        size_t goal     = (triangles.size() - targetTriangleCounts[level]) / 2 + 1;
+        size_t accepted = 0;
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), 0);
+        for (const Collapse& collapse: collapses)
+        {
+            if (accepted >= goal) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            uint32_t first = offsets[collapse.from];
+            uint32_t count = offsets[collapse.from + 1] - first;
+            if (flips(adjacency, first, count, collapse.from, collapse.to)) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxError = std::max(maxError, collapse.error);
+
+            for (uint32_t i = first; i < first + count; i++)
+                for (int j = 0; j < 3; j++)
+                    touched[triangles[adjacency[i]][j]] = 1;
+            touched[collapse.to] = 1;
+            accepted++;
+        }
+        if (accepted == 0) break;
+
+        size_t kept = 0;
+        for (const u32vec3& triangle: triangles)
+        {
+            u32vec3 collapsed(remap[triangle.x], remap[triangle.y], remap[triangle.z]);
+            if (collapsed.x != collapsed.y && collapsed.y != collapsed.z && collapsed.z != collapsed.x)
+                triangles[kept++] = collapsed;
+        }
+        triangles.resize(kept);
+    }
+
+    // Locked vertices can keep a target out of reach, what was simplified until then may still be worth a level
+    size_t previousCount = result.empty() ? mesh.indices().size() : result.back().indices.size();
+    if (level < targetTriangleCounts.size() && triangles.size() < previousCount)
+        result.push_back(MeshLod { .indices = std::move(triangles), .error = maxError });
+
+    return result;
+}
+
+void printStatistics(const std::string& name, const std::string& stage, const MeshStatistics& statistics)
+{
+    std::cout << "Mesh " << name << " " << stage << ": " << statistics.vertices << " vertices, " << statistics.triangles << " triangles, ACMR "
+              << statistics.acmr << ", " << statistics.vertexBytes << " vertex bytes, " << statistics.indexBytes << " index bytes" << std::endl;
+}
+
+void optimizeMesh(Mesh& mesh, const std::string& name)
+{
+    if (mesh.vertices().empty() || mesh.indices().empty()) return;
+
+    printStatistics(name, "original",       getMeshStatistics(mesh));
+
+    weldVertices(mesh);
+    printStatistics(name, "welded",         getMeshStatistics(mesh));
+
+    optimizeVertexCache(mesh);
+    printStatistics(name, "vertex cache",   getMeshStatistics(mesh));
+
+    optimizeOverdraw(mesh);
+    printStatistics(name, "overdraw",       getMeshStatistics(mesh));
+
+    optimizeVertexFetch(mesh);
+    printStatistics(name, "vertex fetch",   getMeshStatistics(mesh));
+}
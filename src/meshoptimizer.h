@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "mesh.h"
+
+// Post-processing of loaded meshes for rendering efficiency. Each stage keeps the triangles and their
+// winding, only the sharing and the order of vertices and triangles change.
+
+struct MeshStatistics
+{
+    size_t  vertices        = 0;
+    size_t  triangles       = 0;
+    float   acmr            = 0.0f;     // Average cache miss ratio, transformed vertices per triangle
+    size_t  vertexBytes     = 0;
+    size_t  indexBytes      = 0;        // With 16-bit indices when the vertices allow it
+};
+
+// Simulates a FIFO post-transform cache of cacheSize vertices
+MeshStatistics getMeshStatistics(const Mesh& mesh, int cacheSize = 16);
+
+// Merges vertices with identical attributes
+void weldVertices(Mesh& mesh);
+
+// Orders triangles to reuse recently transformed vertices (Forsyth's linear-speed vertex cache optimization)
+void optimizeVertexCache(Mesh& mesh);
+void optimizeVertexCache(std::vector<glm::u32vec3>& triangles, size_t vertexCount);
+
+// Orders clusters of cache optimized triangles front to back from the outside in, unless that costs more than
+// threshold times the cache miss ratio.
+void optimizeOverdraw(Mesh& mesh, float threshold = 1.05f);
+
+// Orders vertices by their first use in the triangles and drops unused ones
+void optimizeVertexFetch(Mesh& mesh);
+
+// Runs all of the above and reports the statistics after each stage
+void optimizeMesh(Mesh& mesh, const std::string& name);
+
+// Simplifies the mesh by collapsing edges in the order of their quadric error, without adding vertices. Returns one
+// level for every target triangle count that was reached, in the order of the targets, which must be descending.
+// Vertices on uv or normal seams stay in place and vertices on open borders only move along the border.
+std::vector<MeshLod> simplifyMesh(const Mesh& mesh, const std::vector<size_t>& targetTriangleCounts);
@@ -1,10 +1,16 @@
 #include "object.h"
 #include <glm/gtc/matrix_transform.hpp> 
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 using namespace glm;
 
+uint64_t objectChangeCount = 0;
+
 Object::Object()
 {
 }
@@ -66,8 +72,26 @@ Space Object::getParentSpace() const
     return parent->getSpace();
 }
 
+const Object* Object::getParent() const
+{
+    return parent;
+}
+
+uint64_t Object::changeCount()
+{
+    return objectChangeCount;
+}
+
+uint64_t Object::transformVersion() const
+{
+    return version;
+}
+
 void Object::updateTransforms() const
 {
+    objectChangeCount++;
+    version = objectChangeCount;
+
     if (parent == nullptr)
     {
         space.toRoot      = toParent;
@@ -147,17 +171,122 @@ const Space CameraObject::getProjectionSpace(float aspectRatio) const
     return projectionSpace;
 }
 
-LightObject::LightObject(const Object& parent)
-    : Object(parent)
+float CameraObject::getFov() const
+{
+    return fov;
+}
+
+float CameraObject::getNear() const
 {
+    return near;
 }
 
-glm::mat4 LightObject::getProjection() const
+float CameraObject::getFar() const
+{
+    return far;
+}
+
+LightObject::LightObject(const Object& parent)
+    : Object(parent)
 {
-    return perspective<float>(radians(100.0f),1.0f , 1.0f, 1500.0f);
 }
 
 glm::mat4 LightObject::getView() const
 {
     return getSpace().fromRoot;
 }
+
+std::vector<ShadowCascade> LightObject::getCascades(const CameraObject& camera, float aspectRatio, const Box& bounds, int nrCascades, int resolution) const
+{
+    #ifdef GLM_FORCE_LEFT_HANDED
+        const float forward = 1.0f;     // Views look along +z
+    #else
+        const float forward = -1.0f;
+    #endif
+    #ifdef GLM_FORCE_DEPTH_ZERO_TO_ONE
+        const float ndcNear = 0.0f;
+    #else
+        const float ndcNear = -1.0f;
+    #endif
+
+    const mat4  view            = getView();
+    const mat4  cameraView      = camera.getSpace().fromRoot;
+    const mat4  cameraProjection = perspective(camera.getFov(), aspectRatio, camera.getNear(), camera.getFar());
+    const bool  hasBounds       = all(lessThanEqual(bounds.min, bounds.max));
+
+    // The cascades cover the part of the view frustum with geometry in it, w is the distance along the view direction
+    // of the camera and has its extremes in corners of the bounds
+    float minZ          = std::numeric_limits<float>::max();
+    float maxZ          = -std::numeric_limits<float>::max();
+    float minDistance   = hasBounds ? camera.getFar() : camera.getNear();
+    float maxDistance   = hasBounds ? camera.getNear() : camera.getFar();
+    for (int corner = 0; hasBounds && corner < 8; corner++)
+    {
+        vec4  position(corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y, corner & 4 ? bounds.max.z : bounds.min.z, 1.0f);
+        float distance = (cameraProjection * cameraView * position).w;
+        minDistance = std::min(minDistance, distance);
+        maxDistance = std::max(maxDistance, distance);
+
+        float z = forward * (view * position).z;
+        minZ    = std::min(minZ, z);
+        maxZ    = std::max(maxZ, z);
+    }
+
+    float nearDistance  = std::clamp(minDistance, camera.getNear(), camera.getFar());
+    float farDistance   = std::clamp(maxDistance, nearDistance * 1.01f, camera.getFar());
+
+    std::vector<ShadowCascade> cascades;
+    float sliceNear = nearDistance;
+    for (int i = 0; i < nrCascades; i++)
+    {
+        // Mostly logarithmic, so every cascade has about the same texels per pixel
+        const float lambda      = 0.75f;
+        float       fraction    = float(i + 1) / float(nrCascades);
+        float       logSplit    = nearDistance * std::pow(farDistance / nearDistance, fraction);
+        float       linearSplit = nearDistance + (farDistance - nearDistance) * fraction;
+        float       sliceFar    = lambda * logSplit + (1.0f - lambda) * linearSplit;
+
+        // The corners of the slice in light space
+        mat4 toWorld = inverse(perspective(camera.getFov(), aspectRatio, sliceNear, sliceFar) * cameraView);
+        std::array<vec3, 8> corners;
+        vec3 center = vec3(0.0f);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            vec4 position = toWorld * vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : ndcNear, 1.0f);
+            corners[corner] = vec3(view * (position / position.w));
+            center += corners[corner] / 8.0f;
+        }
+
+        // A bounding sphere keeps the size of the projection when the camera rotates, rounded so it doesn't change
+        // by rounding errors either
+        float radius = 0.0f;
+        for (const vec3& corner : corners)
+            radius = std::max(radius, length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // Moving the projection by whole texels keeps the texels of static casters where they are, they don't shimmer
+        float texelSize = 2.0f * radius / float(resolution);
+        center.x = std::floor(center.x / texelSize) * texelSize;
+        center.y = std::floor(center.y / texelSize) * texelSize;
+
+        float near = forward * center.z - radius;
+        float far  = forward * center.z + radius;
+        if (hasBounds)
+        {
+            near = std::min(near, minZ);
+            far  = std::min(far, maxZ);
+        }
+        far = std::max(far, near + 0.001f);
+
+        ShadowCascade cascade;
+        cascade.view            = view;
+        cascade.projection      = ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius, near, far);
+        cascade.splitDistance   = sliceFar;
+        cascade.texelSize       = texelSize;
+        cascade.depthRange      = far - near;
+        cascades.push_back(cascade);
+
+        sliceNear = sliceFar;
+    }
+    return cascades;
+}
@@ -4,6 +4,8 @@
 #include <map>
 #include <glm/glm.hpp>
 
+#include "mesh.h"
+
 class Space
 {
 public:
@@ -41,6 +43,14 @@ public:
     Space getSpace() const;
     Space getParentSpace() const;
 
+    const Object* getParent() const;
+
+    // Increases whenever the transform or parent of any object changes, tells viewports they have to render again.
+    static uint64_t changeCount();
+
+    // The changeCount() of the last change to the transform of this object or one of its parents
+    uint64_t transformVersion() const;
+
 protected:
     virtual void updateTransforms() const;
 
@@ -49,6 +59,7 @@ private:
     
     mutable Space   space;
     glm::mat4       toParent    = glm::mat4(1.0);
+    mutable uint64_t version    = 0;
 
     mutable std::vector<const Object*> children;
 
@@ -59,13 +70,29 @@ private:
 
 };
 
+class CameraObject;
+
+// Orthographic projection of a directional light that covers a slice of the camera frustum
+struct ShadowCascade
+{
+    glm::mat4   view;
+    glm::mat4   projection;
+    float       splitDistance;  // Distance along the view direction of the camera where the slice ends
+    float       texelSize;      // Size of a shadow map texel in world units
+    float       depthRange;     // Distance in world units between the near and far plane of the projection
+};
+
 class LightObject: public Object
 {
 public:
     explicit LightObject(const Object& parent);
 
-    glm::mat4 getProjection()   const;
     glm::mat4 getView()         const;
+
+    // Fits nrCascades projections along the view direction of the light to slices of the camera frustum, with
+    // split distances between logarithmic and uniform. The slices end at the far plane or at the far side of
+    // bounds, the world space box of the shadow casters, which also sets the depth range of the projections.
+    std::vector<ShadowCascade> getCascades(const CameraObject& camera, float aspectRatio, const Box& bounds, int nrCascades, int resolution) const;
 };
 
 class CameraObject: public Object
@@ -77,6 +104,10 @@ public:
 
     const Space getProjectionSpace(float aspectRatio) const;
 
+    float getFov()  const;
+    float getNear() const;
+    float getFar()  const;
+
 private:
     float fov;
     float near; 
@@ -2,6 +2,13 @@
 
 using namespace glm;
 
+Scene::~Scene()
+{
+    // Children are created after their parents, destroying them first keeps them from detaching from a destroyed parent
+    while (!renderables.empty())
+        renderables.pop_back();
+}
+
 RenderableObject& Scene::newObject(const Object& parent)
 {
     return *renderables.emplace_back(std::make_unique<RenderableObject>(parent));
@@ -23,6 +23,7 @@ class Scene
 {
 
 public:
+    ~Scene();
 
     RenderableObject& newObject(const Object& parent);
     const std::vector<std::unique_ptr<RenderableObject>>& all() const;
@@ -31,6 +32,9 @@ public:
 
     Cubemap* m_environmentMap = nullptr;
 
+    // Environment map that was loaded along with the scene, m_environmentMap points to it
+    std::unique_ptr<Cubemap> m_ownedEnvironmentMap;
+
 private:
     std::vector<std::unique_ptr<RenderableObject>> renderables;
 };
\ No newline at end of file
@@ -24,15 +24,43 @@ Scheduler::~Scheduler()
 
 bool shouldClose = false;
 
+// Waits for the next event when nothing is changing, so an idle viewer doesn't use any CPU or GPU time.
+bool Scheduler::nextEvent(SDL_Event& event)
+{
+    #ifndef __EMSCRIPTEN__
+    if (!busy)
+    {
+        busy = true;
+        return SDL_WaitEventTimeout(&event, 250) != 0;
+    }
+    #endif // __EMSCRIPTEN__
+
+    return SDL_PollEvent(&event) != 0;
+}
+
 void Scheduler::tick()
 {
+    // Mouse motion is coalesced, only the last position before another event or the end of the tick is handled
+    bool    hasMotion = false;
+    vec3    motion;
+    auto flushMotion = [&]()
+    {
+        if (!hasMotion) return;
+        for(auto viewport: viewports)
+            viewport->mouseMove(motion);
+        hasMotion = false;
+    };
+
     SDL_Event event;
-    while (SDL_PollEvent(&event))
+    while (nextEvent(event))
     {
         int mouseX = event.motion.x;
         int mouseY = event.motion.y;
         vec3 pos(double(mouseX), double(mouseY), 0.0);
 
+        if (event.type != SDL_MOUSEMOTION)
+            flushMotion();
+
         switch (event.type)
         {
         case SDL_QUIT:
@@ -41,15 +69,25 @@ void Scheduler::tick()
             emscripten_cancel_main_loop();
             #endif
             break;
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+            {
+                for (auto viewport: viewports)
+                    viewport->resize();
+            }
+            else if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+            {
+                for (auto viewport: viewports)
+                    viewport->invalidate();
+            }
+            break;
         case SDL_MOUSEWHEEL:
             for(auto viewport: viewports)
                 viewport->mouseWheel(event.wheel.y);
             break;
         case SDL_MOUSEMOTION:
-            {
-                for(auto viewport: viewports)
-                    viewport->mouseMove(pos);
-            }
+            hasMotion   = true;
+            motion      = pos;
             break;
             case SDL_MOUSEBUTTONDOWN:
             {
@@ -74,9 +112,14 @@ void Scheduler::tick()
             break;
         }
     }
+    flushMotion();
 
+    busy = false;
     for (Animator* animator: animators)
+    {
         animator->animate();
+        busy |= animator->running();
+    }
 
     auto time   = std::chrono::steady_clock::now() - startTime;
     auto milli  = std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
@@ -85,18 +128,33 @@ void Scheduler::tick()
         for (Input* input: viewport->m_inputs)
             input->animateTick(milli / 1000.0);
 
+        // Only viewports of which something changed since the last frame are rendered
+        if (!viewport->needsRender()) continue;
+
         viewport->render();
+        busy = true;
+        nrFrames++;
     }
 
-    nrFrames++;
-
-    if (milli >= 2000 )
+    if (milli >= 2000 && nrFrames > 0)
     {
         float fps = (float) nrFrames / (milli / 1000.0f);
         std::cout << fps << "fps" << std::endl;
+
+        for (Viewport* viewport: viewports)
+        {
+            Culler::Stats stats         = viewport->getCullStats();
+            Culler::Stats shadowStats   = viewport->getShadowCullStats();
+            std::cout << "visible: " << stats.visible << " culled: " << stats.culled
+                      << ", shadow casters visible: " << shadowStats.visible << " culled: " << shadowStats.culled << std::endl;
+        }
         nrFrames = 0;
         startTime = std::chrono::steady_clock::now();
     }
+    else if (milli >= 2000)
+    {
+        startTime = std::chrono::steady_clock::now();
+    }
 }
 
 void Scheduler::run()
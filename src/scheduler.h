@@ -5,6 +5,7 @@
 
 class Viewport;
 class Animator;
+union SDL_Event;
 
 class Scheduler
 {
@@ -26,6 +27,11 @@ private:
     std::chrono::time_point<std::chrono::steady_clock> startTime;
     int nrFrames = 0;
 
+    // Whether the last tick rendered or animated something, otherwise the next tick waits for events
+    bool busy = true;
+
+    bool nextEvent(SDL_Event& event);
+
     Scheduler (const Scheduler&)              = delete;
     Scheduler& operator= (const Scheduler&)   = delete;
 
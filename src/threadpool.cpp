@@ -0,0 +1,56 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t nrThreads)
+{
+    for (size_t i = 0; i < nrThreads; i++)
+        m_workers.emplace_back([this]() { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& worker: m_workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    #ifdef __EMSCRIPTEN__
+    static ThreadPool pool(0);
+    #else
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    #endif // __EMSCRIPTEN__
+
+    return pool;
+}
+
+size_t ThreadPool::size() const
+{
+    return m_workers.size();
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+
+            // Remaining jobs are still executed, their futures may be waited on
+            if (m_jobs.empty()) return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+        job();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed set of worker threads executing submitted jobs in order of submission. Without
+// worker threads, for example on the web, jobs are executed immediately on the calling thread.
+class ThreadPool
+{
+public:
+    ThreadPool(size_t nrThreads);
+    ~ThreadPool();
+
+    // Pool shared by the loaders, with a worker per hardware thread
+    static ThreadPool& shared();
+
+    size_t size() const;
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& job)
+    {
+        using Result = std::invoke_result_t<F>;
+
+        auto task   = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        auto future = task->get_future();
+
+        if (m_workers.empty())
+        {
+            (*task)();
+            return future;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.emplace([task]() { (*task)(); });
+        }
+        m_condition.notify_one();
+
+        return future;
+    }
+
+    // Calls function(begin, end) for consecutive chunks of grainSize items out of count, on the workers and the
+    // calling thread, and returns when all chunks are done. The calling thread keeps taking chunks itself, so this
+    // can be used from within a job without waiting for workers that are busy.
+    template <typename F>
+    void parallelFor(size_t count, size_t grainSize, F&& function)
+    {
+        size_t nrChunks = (count + grainSize - 1) / grainSize;
+        if (nrChunks <= 1 || m_workers.empty())
+        {
+            if (count > 0) function(size_t(0), count);
+            return;
+        }
+
+        struct State
+        {
+            std::atomic<size_t>     next        = 0;
+            std::atomic<size_t>     done        = 0;
+            std::mutex              mutex;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<State>();
+
+        // Helpers that only start after all chunks were taken return without touching function
+        auto run = [state, nrChunks, count, grainSize, &function]()
+        {
+            for (size_t chunk = state->next++; chunk < nrChunks; chunk = state->next++)
+            {
+                function(chunk * grainSize, std::min(count, (chunk + 1) * grainSize));
+                if (++state->done == nrChunks)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        for (size_t i = 1; i < std::min(nrChunks, m_workers.size() + 1); i++)
+            submit(run);
+        run();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state, nrChunks]() { return state->done == nrChunks; });
+    }
+
+private:
+    std::vector<std::thread>            m_workers;
+    std::queue<std::function<void()>>   m_jobs;
+    std::mutex                          m_mutex;
+    std::condition_variable             m_condition;
+    bool                                m_stopping = false;
+
+    void work();
+
+    ThreadPool (const ThreadPool&)              = delete;
+    ThreadPool& operator= (const ThreadPool&)   = delete;
+};
@@ -24,19 +24,41 @@ void Viewport::render()
 {
     if (m_camera == nullptr || m_light == nullptr) return; // Nothing to render without a camera
 
+    m_invalidated       = false;
+    m_renderedChanges   = Object::changeCount();
+
     m_gpu.beginRenderJob();
 
     vec2 size               = m_renderTarget.getSize();
     Space projectionSpace   = m_camera->getProjectionSpace(size.x / size.y);
 
+    m_culler.update(m_renderables);
+
+    std::vector<ShadowCascade> cascades = m_light->getCascades(*m_camera, size.x / size.y, m_culler.bounds(), maxShadowCascades, int(m_depthTarget.getSize().x));
+
+    // Every cascade draws the casters in its own projection
+    m_shadowCasters.resize(cascades.size());
+    m_shadowCullStats = Culler::Stats();
+    for (size_t i = 0; i < cascades.size(); i++)
+    {
+        m_shadowCasters[i].clear();
+        Culler::Stats stats = m_culler.cull(Frustum(cascades[i].projection * cascades[i].view), m_shadowCasters[i], true);
+        m_shadowCullStats.visible += stats.visible;
+        m_shadowCullStats.culled  += stats.culled;
+    }
+
+    m_visibleRenderables.clear();
+    m_cullStats = m_culler.cull(Frustum(projectionSpace.fromRoot), m_visibleRenderables);
+
     m_renderTarget.beginRender();
     m_depthTarget.beginRender();
     ShadowPass::RenderParams shadowParams { 
-        .view       = m_light->getView(),
-        .projection = m_light->getProjection()
+        .cascades   = cascades,
+        .filter     = m_shadowFilter,
+        .useRenderBundles = m_useRenderBundles
     };
     m_shadowPass.renderPre  (shadowParams);
-    m_shadowPass.render     (m_renderables);
+    m_shadowPass.render     (m_shadowCasters);
 
     vec4 lightpos = vec4(m_light->getSpace().pos(vec3(0.0), Space()), 1.0);
     
@@ -44,12 +66,16 @@ void Viewport::render()
         .lightPosWorld  = lightpos,
         .projection     = m_camera->getSpace().to(projectionSpace),
         .view           = m_camera->getSpace().fromRoot,
-        .shadowViewProjection = m_light->getProjection() * m_light->getView(),
-        .environmentMap = m_scene.m_environmentMap
+        .shadowCascades = cascades,
+        .environmentMap = m_scene.m_environmentMap,
+        .useRenderBundles = m_useRenderBundles,
+        .depthPrepass   = m_depthPrepass,
+        .shadowSamples  = m_shadowSamples,
+        .shadowFilter   = m_shadowFilter
     };
 
     m_renderPass.renderPre(params);
-    m_renderPass.render   (m_renderables);
+    m_renderPass.render   (m_visibleRenderables);
 
     m_gpu.submitRenderJob();
 
@@ -57,19 +83,64 @@ void Viewport::render()
     m_depthTarget.endRender();
 }
 
+void Viewport::invalidate()
+{
+    m_invalidated = true;
+}
+
+bool Viewport::needsRender() const
+{
+    // Streamed textures get finer levels and new meshes appear over several frames
+    bool streaming = m_gpu.getResourcePool().getTextureStreamer().isStreaming() || m_gpu.getUploadManager().hasDeferred();
+    return m_invalidated || streaming || m_renderedChanges != Object::changeCount();
+}
+
+void Viewport::setUseRenderBundles(bool useRenderBundles)
+{
+    m_useRenderBundles = useRenderBundles;
+}
+
+void Viewport::setDepthPrepass(bool depthPrepass)
+{
+    m_depthPrepass = depthPrepass;
+}
+
+void Viewport::setShadowSamples(int shadowSamples)
+{
+    m_shadowSamples = shadowSamples;
+}
+
+void Viewport::setShadowFilter(ShadowFilter shadowFilter)
+{
+    m_shadowFilter = shadowFilter;
+}
+
+Culler::Stats Viewport::getCullStats() const
+{
+    return m_cullStats;
+}
+
+Culler::Stats Viewport::getShadowCullStats() const
+{
+    return m_shadowCullStats;
+}
+
 void Viewport::attachCamera(const CameraObject& camera_)
 {
     m_camera = &camera_;
+    invalidate();
 }
 
 void Viewport::attachRenderable(const Renderable& renderable)
 {
     m_renderables.emplace_back(&renderable);
+    invalidate();
 }
 
 void Viewport::attachLight(const LightObject &light_)
 {
     m_light = &light_;
+    invalidate();
 }
 
 void Viewport::mouseDown(MouseButton button, const glm::vec3& position)
@@ -90,12 +161,11 @@ void Viewport::mouseDown(MouseButton button, const glm::vec3& position)
             m_activeInput->begin(position);
         }
     }
+    invalidate();
 }
 
 void Viewport::mouseMove(const glm::vec3 &position)
 {
-    std::cout << "mouseMove" << std::endl;
-
     if (m_activeInput == nullptr)
     {
         for(auto input: m_inputs)
@@ -107,6 +177,7 @@ void Viewport::mouseMove(const glm::vec3 &position)
     else 
     {
         m_activeInput->move(position);
+        invalidate();
     }
 }
 
@@ -120,6 +191,7 @@ void Viewport::mouseUp(MouseButton button, const glm::vec3& position)
         m_activeInput->end(position);
         m_activeInput = nullptr;
     }
+    invalidate();
 }
 
 void Viewport::mouseWheel(int direction)
@@ -128,4 +200,11 @@ void Viewport::mouseWheel(int direction)
     {
         input->mouseWheel(direction);
     }
+    invalidate();
+}
+
+void Viewport::resize()
+{
+    m_renderTarget.resize();
+    invalidate();
 }
@@ -7,6 +7,7 @@
 #include "renderable.h"
 #include "input.h"
 #include "scene.h"
+#include "culling.h"
 
 // The viewport renders to a render target (either a window or a canvas).
 // It handles mouse events and connects the graphics layer. 
@@ -25,11 +26,33 @@ public:
 
     void render();
 
+    // Makes the scheduler render the viewport again, for changes it can't detect itself.
+    void invalidate();
+    bool needsRender() const;
+
+    // Records the draw calls of static scenes once and replays them every frame.
+    void setUseRenderBundles(bool useRenderBundles);
+
+    // Draws the depth of the visible renderables before they are shaded, for scenes with a lot of overdraw.
+    void setDepthPrepass(bool depthPrepass);
+
+    // Filter samples of fragments in the penumbra of a shadow, up to 32. Fully lit or shadowed fragments take four.
+    void setShadowSamples(int shadowSamples);
+
+    // Percentage closer filtering of the shadow map, or prefiltered exponential variance shadow maps
+    void setShadowFilter(ShadowFilter shadowFilter);
+
+    // Number of renderables that passed or failed frustum culling in the last rendered frame, summed over the
+    // shadow cascades for the shadow casters.
+    Culler::Stats getCullStats()        const;
+    Culler::Stats getShadowCullStats()  const;
+
 protected:
     void mouseDown  (MouseButton button, const glm::vec3& position);
     void mouseMove  (const glm::vec3& position);
     void mouseUp    (MouseButton button, const glm::vec3& position);
     void mouseWheel (int direction);
+    void resize     ();
 
 private:
     Scheduler&      m_scheduler;
@@ -41,10 +64,24 @@ private:
     const LightObject*      m_light   = nullptr;
     
     std::vector<const Renderable*>  m_renderables;
+    std::vector<const Renderable*>  m_visibleRenderables;
+    std::vector<std::vector<const Renderable*>> m_shadowCasters;    // Per shadow cascade
     std::vector<Input*>             m_inputs;
     Input*                          m_activeInput = nullptr;
     MouseButton                     m_pressedButtons      = MouseButton::None;
 
+    bool            m_useRenderBundles = true;
+    bool            m_depthPrepass     = false;
+    int             m_shadowSamples    = 16;
+    ShadowFilter    m_shadowFilter     = ShadowFilter::Pcf;
+
+    bool            m_invalidated       = true;
+    uint64_t        m_renderedChanges   = 0;
+
+    Culler          m_culler;
+    Culler::Stats   m_cullStats;
+    Culler::Stats   m_shadowCullStats;
+
     DepthTarget m_depthTarget;
     ShadowPass  m_shadowPass;
     RenderPass  m_renderPass;
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "object.h"
+#include "scene.h"
+#include "cubemap.h"
+#include "threadpool.h"
+#include "io/loader.h"
+#include "io/scenepack.h"
+
+// Loads a glTF model, and optionally an environment cubemap, once and writes them as a scene pack
+// that the viewer maps at startup: AssetCompiler [--fast-compression | --no-compression] <model.glb> <output.pack> [cubemap directory]
+int main(int argc, char** argv)
+{
+    // Images are compressed with BC7 unless an option asks for the faster BC1 and BC3, or for none
+    TextureCompression compression = TextureCompression::Quality;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--fast-compression")
+            compression = TextureCompression::Fast;
+        else if (argument == "--no-compression")
+            compression = TextureCompression::None;
+        else
+            arguments.push_back(argument);
+    }
+
+    if (arguments.size() < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " [--fast-compression | --no-compression] <model.glb> <output.pack> [cubemap directory]" << std::endl;
+        return 1;
+    }
+
+    std::string modelPath   = arguments[0];
+    std::string packPath    = arguments[1];
+
+    Object root;
+    std::unique_ptr<Scene> scene = loadModelObjects(modelPath, root);
+    if (scene->all().empty())
+    {
+        std::cerr << "No objects loaded from " << modelPath << std::endl;
+        return 1;
+    }
+
+    Cubemap environmentMap;
+    bool    hasEnvironmentMap = arguments.size() > 2;
+    if (hasEnvironmentMap)
+    {
+        std::string directory   = arguments[2] + "/";
+        const char* faces[]     = { "px.png", "nx.png", "py.png", "ny.png", "pz.png", "nz.png" };
+
+        std::vector<std::future<Image>> images;
+        for (const char* face: faces)
+            images.emplace_back(ThreadPool::shared().submit([path = directory + face]() { return loadImage(path); }));
+
+        environmentMap = Cubemap(images[0].get(), images[1].get(), images[2].get(), images[3].get(), images[4].get(), images[5].get());
+    }
+
+    return saveScenePack(packPath, *scene, root, hasEnvironmentMap ? &environmentMap : nullptr, compression) ? 0 : 1;
+}